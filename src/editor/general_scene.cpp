@@ -44,7 +44,7 @@ void GeneralScene::GenerateTrees() {
 }
 
 void GeneralScene::GenerateGrass() {
-    auto shaderTexDiscard = ShaderManager::Get().Create("$shader/vertex_old.mat", "$shader/fragment_tex_discard.mat");
+    auto shaderTexDiscard = ShaderManager::Get().Create("$shader/vertex_instanced.mat", "$shader/fragment_tex_discard.mat");
     auto materialGrass0 = MaterialManager::Builder(shaderTexDiscard).BaseTexture(0, "$tex/grass0.png").Build();
     auto materialGrass1 = MaterialManager::Builder(shaderTexDiscard).BaseTexture(0, "$tex/grass1.png").Build();
     auto materialFlower0 = MaterialManager::Builder(shaderTexDiscard).BaseTexture(0, "$tex/flower0.png").Build();
@@ -90,10 +90,10 @@ void GeneralScene::Create() {
     m_controller.AttachCamera(camera);
 
     auto& shMng = ShaderManager::Get();
-    m_shaderTex = shMng.Create("$shader/vertex_old.mat", "$shader/fragment_tex.mat");
-    m_shaderClr = shMng.Create("$shader/vertex_old.mat", "$shader/fragment_clr.mat");
-    m_shaderTexLight = shMng.Create("$shader/vertex_old.mat", "$shader/fragment_tex_light.mat");
-    m_shaderClrLight = shMng.Create("$shader/vertex_old.mat", "$shader/fragment_clr_light.mat");
+    m_shaderTex = shMng.Create("$shader/vertex_instanced.mat", "$shader/fragment_tex.mat");
+    m_shaderClr = shMng.Create("$shader/vertex_instanced.mat", "$shader/fragment_clr.mat");
+    m_shaderTexLight = shMng.Create("$shader/vertex_instanced.mat", "$shader/fragment_tex_light.mat");
+    m_shaderClrLight = shMng.Create("$shader/vertex_instanced.mat", "$shader/fragment_clr_light.mat");
 
     GenerateGround();
     GenerateTrees();
@@ -103,8 +103,12 @@ void GeneralScene::Create() {
 void GeneralScene::Update(float deltaTime) {
     WindowInput& wio = m_engine.GetWindow().GetIO();
 
-    m_scene.Update();
+    uint32_t width, height;
+    wio.GetFramebufferSize(width, height);
+    m_scene.SetViewportSize(width, height);
+    // the camera is moved before the scene is culled by its frustum, so the visible set matches the drawn view
     m_controller.Update(wio, deltaTime);
+    m_scene.Update(deltaTime);
 }
 
 void GeneralScene::Draw() {
@@ -3,6 +3,7 @@
 #include <imgui.h>
 #include <filesystem>
 
+#include "engine/api/gl_state.h"
 #include "engine/gui/widgets.h"
 #include "engine/camera/camera.h"
 #include "engine/common/exception.h"
@@ -70,10 +71,12 @@ void UIInterface::DrawInfoBar(math::Rectf rect, const std::shared_ptr<Camera>& c
     if (BeginWindow("infobar", rect)) {
         ImGui::PushFont(m_fontMono);
         auto pos = camera->GetPosition();
-        auto text = fmt::format("FPS = {:.1f} TPF = {:.2f}M Pos = {:.1f}:{:.1f}:{:.1f}",
+        const auto& glState = GLState::Get();
+        auto text = fmt::format("FPS = {:.1f} TPF = {:.2f}M Pos = {:.1f}:{:.1f}:{:.1f} GL = {} (elided {})",
             m_engine.GetFps(),
             static_cast<double>(tpf) / 1000.0 / 1000.0,
-            pos.x, pos.y, pos.z);
+            pos.x, pos.y, pos.z,
+            glState.GetIssuedCalls(), glState.GetElidedCalls());
         ImGui::TextColored(ImColor(0xFF, 0xDA, 0x00), "%s", text.c_str());
         ImGui::PopFont();
 
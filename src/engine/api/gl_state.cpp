@@ -0,0 +1,163 @@
+#include "engine/api/gl_state.h"
+
+
+void GLState::UseProgram(GLuint program) {
+    if (Elide(m_program == program)) {
+        return;
+    }
+    m_program = program;
+    glUseProgram(program);
+}
+
+void GLState::BindVertexArray(GLuint vao) {
+    if (Elide(m_vao == vao)) {
+        return;
+    }
+    m_vao = vao;
+    glBindVertexArray(vao);
+    // the element array buffer binding is a part of the VAO state
+    m_buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer) {
+    const auto it = m_buffers.find(target);
+    if (Elide((it != m_buffers.cend()) && (it->second == buffer))) {
+        return;
+    }
+    m_buffers[target] = buffer;
+    glBindBuffer(target, buffer);
+}
+
+void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    const uint64_t key = (static_cast<uint64_t>(target) << 32) | index;
+    const auto it = m_indexedBuffers.find(key);
+    if (Elide((it != m_indexedBuffers.cend()) && (it->second == buffer))) {
+        return;
+    }
+    m_indexedBuffers[key] = buffer;
+    // also binds the buffer to the generic binding point of the target
+    m_buffers[target] = buffer;
+    glBindBufferBase(target, index, buffer);
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+    // the unit is activated even if the bind is dropped, the following glTex* calls apply to the active unit
+    ActiveTexture(unit);
+    const bool isShadowed = (target == GL_TEXTURE_2D) && (unit < MaxTextureUnits);
+    if (Elide(isShadowed && (m_textures2D[unit] == texture))) {
+        return;
+    }
+    if (isShadowed) {
+        m_textures2D[unit] = texture;
+    }
+    glBindTexture(target, texture);
+}
+
+void GLState::SetEnabled(GLenum cap, bool enabled) {
+    const auto it = m_capabilities.find(cap);
+    if (Elide((it != m_capabilities.cend()) && (it->second == enabled))) {
+        return;
+    }
+    m_capabilities[cap] = enabled;
+    if (enabled) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+}
+
+void GLState::BlendFunc(GLenum srcFactor, GLenum dstFactor) {
+    if (Elide((m_blendSrcFactor == srcFactor) && (m_blendDstFactor == dstFactor))) {
+        return;
+    }
+    m_blendSrcFactor = srcFactor;
+    m_blendDstFactor = dstFactor;
+    glBlendFunc(srcFactor, dstFactor);
+}
+
+void GLState::CullFace(GLenum mode) {
+    if (Elide(m_cullFace == mode)) {
+        return;
+    }
+    m_cullFace = mode;
+    glCullFace(mode);
+}
+
+void GLState::FrontFace(GLenum mode) {
+    if (Elide(m_frontFace == mode)) {
+        return;
+    }
+    m_frontFace = mode;
+    glFrontFace(mode);
+}
+
+void GLState::PolygonMode(GLenum mode) {
+    if (Elide(m_polygonMode == mode)) {
+        return;
+    }
+    m_polygonMode = mode;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLState::DeleteProgram(GLuint program) {
+    if (m_program == program) {
+        m_program = Unknown;
+    }
+    glDeleteProgram(program);
+}
+
+void GLState::DeleteVertexArray(GLuint vao) {
+    if (m_vao == vao) {
+        m_vao = Unknown;
+        m_buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+    }
+    glDeleteVertexArrays(1, &vao);
+}
+
+void GLState::DeleteBuffer(GLuint buffer) {
+    for (auto& [_, value]: m_buffers) {
+        if (value == buffer) {
+            value = Unknown;
+        }
+    }
+    for (auto& [_, value]: m_indexedBuffers) {
+        if (value == buffer) {
+            value = Unknown;
+        }
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void GLState::DeleteTexture(GLuint texture) {
+    for (auto& value: m_textures2D) {
+        if (value == texture) {
+            value = Unknown;
+        }
+    }
+    glDeleteTextures(1, &texture);
+}
+
+void GLState::EndFrame() noexcept {
+    m_lastElidedCalls = m_elidedCalls;
+    m_lastIssuedCalls = m_issuedCalls;
+    m_elidedCalls = 0;
+    m_issuedCalls = 0;
+}
+
+bool GLState::Elide(bool isSame) noexcept {
+    if (isSame) {
+        ++m_elidedCalls;
+    } else {
+        ++m_issuedCalls;
+    }
+
+    return isSame;
+}
+
+void GLState::ActiveTexture(GLuint unit) {
+    if (Elide(m_activeTexture == unit)) {
+        return;
+    }
+    m_activeTexture = unit;
+    glActiveTexture(GL_TEXTURE0 + unit);
+}
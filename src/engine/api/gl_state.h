@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <unordered_map>
+#include "engine/api/gl.h"
+#include "engine/common/noncopyable.h"
+
+
+// Shadow of the GL state changed by the engine: the current program, VAO, buffer bindings per target,
+// 2D texture per unit, enabled capabilities, blend function, face culling and polygon mode.
+// The calls that do not change the shadowed state are dropped and counted.
+//
+// All binds of the engine must go through GLState, otherwise the shadow becomes stale.
+// The ImGui backend saves and restores the state it changes, so it does not break the shadow.
+// The buffers are edited through EditTarget (GL_COPY_WRITE_BUFFER), which is not a part of the VAO state,
+// the textures are edited on EditTextureUnit.
+class GLState : Noncopyable {
+public:
+    static GLState& Get() noexcept {
+        static GLState instance;
+        return instance;
+    }
+
+    static constexpr GLenum EditTarget = GL_COPY_WRITE_BUFFER;
+    static constexpr GLuint EditTextureUnit = 0;
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vao);
+    void BindBuffer(GLenum target, GLuint buffer);
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    // makes the unit active even if the texture is already bound to it
+    void BindTexture(GLuint unit, GLenum target, GLuint texture);
+    void SetEnabled(GLenum cap, bool enabled);
+    void BlendFunc(GLenum srcFactor, GLenum dstFactor);
+    void CullFace(GLenum mode);
+    void FrontFace(GLenum mode);
+    // for GL_FRONT_AND_BACK
+    void PolygonMode(GLenum mode);
+
+    // GL can reuse the names of the deleted objects, so their bindings are forgotten
+    void DeleteProgram(GLuint program);
+    void DeleteVertexArray(GLuint vao);
+    void DeleteBuffer(GLuint buffer);
+    void DeleteTexture(GLuint texture);
+
+    // Moves the counters of the current frame to the counters of the last frame, called by Engine
+    void EndFrame() noexcept;
+
+    // the number of the dropped calls in the last frame
+    uint32_t GetElidedCalls() const noexcept {
+        return m_lastElidedCalls;
+    }
+
+    // the number of the calls passed to GL in the last frame
+    uint32_t GetIssuedCalls() const noexcept {
+        return m_lastIssuedCalls;
+    }
+
+private:
+    GLState() = default;
+    ~GLState() = default;
+
+    // the state is not known until the first call
+    static constexpr GLuint Unknown = std::numeric_limits<GLuint>::max();
+    static constexpr size_t MaxTextureUnits = 32;
+
+    bool Elide(bool isSame) noexcept;
+    void ActiveTexture(GLuint unit);
+
+private:
+    GLuint m_program = Unknown;
+    GLuint m_vao = Unknown;
+    std::unordered_map<GLenum, GLuint> m_buffers;
+    // key - (target << 32) | index
+    std::unordered_map<uint64_t, GLuint> m_indexedBuffers;
+    GLuint m_activeTexture = Unknown;
+    std::array<GLuint, MaxTextureUnits> m_textures2D = [] {
+        std::array<GLuint, MaxTextureUnits> result{};
+        result.fill(Unknown);
+        return result;
+    }();
+    std::unordered_map<GLenum, bool> m_capabilities;
+    GLenum m_blendSrcFactor = Unknown;
+    GLenum m_blendDstFactor = Unknown;
+    GLenum m_cullFace = Unknown;
+    GLenum m_frontFace = Unknown;
+    GLenum m_polygonMode = Unknown;
+
+    uint32_t m_elidedCalls = 0;
+    uint32_t m_issuedCalls = 0;
+    uint32_t m_lastElidedCalls = 0;
+    uint32_t m_lastIssuedCalls = 0;
+};
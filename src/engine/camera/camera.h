@@ -2,6 +2,7 @@
 
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/constants.hpp>
+#include "engine/common/bounds.h"
 #include "engine/common/noncopyable.h"
 
 
@@ -51,6 +52,11 @@ public:
 		return m_matView;
 	}
 
+	// The planes of the view frustum in the world coordinates
+	math::Frustum GetFrustum() const noexcept {
+		return math::Frustum(m_matProj * m_matView);
+	}
+
 	glm::vec3 HomogeneousPositionToRay(const glm::vec2& pos) const noexcept;
 private:
 	void calcViewMatrix(const glm::vec3& direction);
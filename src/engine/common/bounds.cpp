@@ -0,0 +1,94 @@
+#include "engine/common/bounds.h"
+
+#include <limits>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+
+namespace math {
+
+AABB::AABB() noexcept
+    : min(glm::vec3(std::numeric_limits<float>::max()))
+    , max(glm::vec3(std::numeric_limits<float>::lowest())) {
+
+}
+
+void AABB::Add(const glm::vec3& point) noexcept {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+bool AABB::IsEmpty() const noexcept {
+    return (min.x > max.x) || (min.y > max.y) || (min.z > max.z);
+}
+
+AABB AABB::Transform(const glm::mat4& matrix) const noexcept {
+    if (IsEmpty()) {
+        return *this;
+    }
+
+    // see: J. Arvo, "Transforming Axis-Aligned Bounding Boxes"
+    const glm::vec3 center(matrix * glm::vec4(Center(), 1.0f));
+    const glm::vec3 extent = Extent();
+    glm::vec3 resultExtent(0);
+    for (glm::length_t i=0; i!=3; ++i) {
+        for (glm::length_t j=0; j!=3; ++j) {
+            resultExtent[i] += glm::abs(matrix[j][i]) * extent[j];
+        }
+    }
+
+    return AABB(center - resultExtent, center + resultExtent);
+}
+
+BoundingSphere::BoundingSphere(const AABB& box) noexcept
+    : center(box.Center())
+    , radius(box.IsEmpty() ? 0 : glm::length(box.Extent())) {
+
+}
+
+BoundingSphere BoundingSphere::Transform(const glm::mat4& matrix) const noexcept {
+    const float scale = glm::max(glm::length(glm::vec3(matrix[0])), glm::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+    return BoundingSphere(glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * scale);
+}
+
+Frustum::Frustum(const glm::mat4& matViewProj) noexcept {
+    // see: G. Gribb, K. Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+    const auto row = [&matViewProj](glm::length_t i) {
+        return glm::vec4(matViewProj[0][i], matViewProj[1][i], matViewProj[2][i], matViewProj[3][i]);
+    };
+    m_planes[0] = row(3) + row(0); // left
+    m_planes[1] = row(3) - row(0); // right
+    m_planes[2] = row(3) + row(1); // bottom
+    m_planes[3] = row(3) - row(1); // top
+    m_planes[4] = row(3) + row(2); // near
+    m_planes[5] = row(3) - row(2); // far
+    for (auto& plane: m_planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::IsVisible(const BoundingSphere& sphere) const noexcept {
+    for (const auto& plane: m_planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Frustum::IsVisible(const AABB& box) const noexcept {
+    const glm::vec3 center = box.Center();
+    const glm::vec3 extent = box.Extent();
+    for (const auto& plane: m_planes) {
+        // the distance to the vertex of the box that is the farthest along the normal
+        const glm::vec3 normal(plane);
+        if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + plane.w < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+
+namespace math {
+
+// Axis-aligned bounding box, empty (min > max) after the construction
+struct AABB {
+    AABB() noexcept;
+    AABB(const glm::vec3& min, const glm::vec3& max) noexcept : min(min), max(max) {}
+
+    void Add(const glm::vec3& point) noexcept;
+    bool IsEmpty() const noexcept;
+
+    glm::vec3 Center() const noexcept { return (min + max) * 0.5f; }
+    // half of the size
+    glm::vec3 Extent() const noexcept { return (max - min) * 0.5f; }
+
+    // the box that contains the transformed box
+    AABB Transform(const glm::mat4& matrix) const noexcept;
+
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct BoundingSphere {
+    BoundingSphere() = default;
+    BoundingSphere(const glm::vec3& center, float radius) noexcept : center(center), radius(radius) {}
+    // the sphere around the box
+    explicit BoundingSphere(const AABB& box) noexcept;
+
+    // the sphere that contains the transformed sphere
+    BoundingSphere Transform(const glm::mat4& matrix) const noexcept;
+
+    glm::vec3 center = glm::vec3(0);
+    float radius = 0;
+};
+
+// The six planes of the view frustum, the normals are directed inside
+class Frustum {
+public:
+    Frustum() = delete;
+    // matViewProj - projection * view matrix, see Camera::GetFrustum
+    explicit Frustum(const glm::mat4& matViewProj) noexcept;
+
+    // false if the volume is outside the frustum, may return true for some volumes near the corners of the frustum
+    bool IsVisible(const BoundingSphere& sphere) const noexcept;
+    bool IsVisible(const AABB& box) const noexcept;
+
+private:
+    // xyz - normal, w - distance, the point is inside if dot(normal, point) + distance >= 0
+    std::array<glm::vec4, 6> m_planes;
+};
+
+}
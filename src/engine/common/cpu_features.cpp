@@ -0,0 +1,20 @@
+#include "engine/common/cpu_features.h"
+
+
+static SimdLevel DetectSimdLevel() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SimdLevel::SSE41;
+    }
+#endif
+    return SimdLevel::None;
+}
+
+SimdLevel GetSimdLevel() noexcept {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
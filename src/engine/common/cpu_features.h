@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+
+enum class SimdLevel : uint8_t {
+    None = 0,
+    SSE41,
+    AVX2,
+};
+
+// Detected once, the SIMD code paths are compiled only for x86
+SimdLevel GetSimdLevel() noexcept;
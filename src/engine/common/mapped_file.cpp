@@ -0,0 +1,195 @@
+#include "engine/common/mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "engine/common/exception.h"
+
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw EngineError("couldn't open file '{}', error: {}", path.string(), GetLastError());
+    }
+
+    LARGE_INTEGER info;
+    if (GetFileSizeEx(file, &info) == 0) {
+        const DWORD error = GetLastError();
+        CloseHandle(file);
+        throw EngineError("couldn't get size of file '{}', error: {}", path.string(), error);
+    }
+
+    m_size = static_cast<size_t>(info.QuadPart);
+    if (m_size != 0) {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* data = (mapping != nullptr) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (data == nullptr) {
+            const DWORD error = GetLastError();
+            if (mapping != nullptr) {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            throw EngineError("couldn't map file '{}', error: {}", path.string(), error);
+        }
+        m_data = static_cast<const uint8_t*>(data);
+        // the view is kept after the mapping handle is closed
+        CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    m_size = 0;
+}
+
+MappedOutputFile::MappedOutputFile(const std::filesystem::path& path, size_t size)
+    : m_path(path) {
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw EngineError("couldn't create file '{}', error: {}", path.string(), GetLastError());
+    }
+
+    if (size != 0) {
+        // the mapping of the given size extends the file
+        const uint64_t size64 = static_cast<uint64_t>(size);
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE,
+            static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), nullptr);
+        void* data = (mapping != nullptr) ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size) : nullptr;
+        if (data == nullptr) {
+            const DWORD error = GetLastError();
+            if (mapping != nullptr) {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            throw EngineError("couldn't map file '{}' of size {}, error: {}", path.string(), size, error);
+        }
+        m_data = static_cast<uint8_t*>(data);
+        m_size = size;
+        // the view is kept after the mapping handle is closed
+        CloseHandle(mapping);
+    }
+
+    m_file = file;
+}
+
+MappedOutputFile::~MappedOutputFile() {
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_file != nullptr) {
+        CloseHandle(m_file);
+        m_file = nullptr;
+    }
+    m_size = 0;
+}
+
+void MappedOutputFile::Flush() {
+    if (m_data == nullptr) {
+        return;
+    }
+    if ((FlushViewOfFile(m_data, 0) == 0) || (FlushFileBuffers(m_file) == 0)) {
+        throw EngineError("couldn't write file '{}', error: {}", m_path.string(), GetLastError());
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw EngineError("couldn't open file '{}', error: {}", path.c_str(), strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        const int error = errno;
+        close(fd);
+        throw EngineError("couldn't get size of file '{}', error: {}", path.c_str(), strerror(error));
+    }
+
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size != 0) {
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw EngineError("couldn't map file '{}', error: {}", path.c_str(), strerror(error));
+        }
+        m_data = static_cast<const uint8_t*>(data);
+    }
+
+    // the mapping is kept after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+        m_data = nullptr;
+    }
+    m_size = 0;
+}
+
+MappedOutputFile::MappedOutputFile(const std::filesystem::path& path, size_t size)
+    : m_path(path) {
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw EngineError("couldn't create file '{}', error: {}", path.c_str(), strerror(errno));
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        const int error = errno;
+        close(fd);
+        throw EngineError("couldn't set size {} of file '{}', error: {}", size, path.c_str(), strerror(error));
+    }
+
+    if (size != 0) {
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw EngineError("couldn't map file '{}', error: {}", path.c_str(), strerror(error));
+        }
+        m_data = static_cast<uint8_t*>(data);
+        m_size = size;
+    }
+
+    // the mapping is kept after the descriptor is closed
+    close(fd);
+}
+
+MappedOutputFile::~MappedOutputFile() {
+    if (m_data != nullptr) {
+        munmap(m_data, m_size);
+        m_data = nullptr;
+    }
+    m_size = 0;
+}
+
+void MappedOutputFile::Flush() {
+    if ((m_data != nullptr) && (msync(m_data, m_size, MS_SYNC) != 0)) {
+        throw EngineError("couldn't write file '{}', error: {}", m_path.c_str(), strerror(errno));
+    }
+}
+
+#endif
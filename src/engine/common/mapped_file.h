@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "engine/common/noncopyable.h"
+
+
+// Read-only mapping of the whole file into the memory
+class MappedFile : Noncopyable {
+public:
+    MappedFile() = delete;
+    // Throws EngineError if the file can not be opened or mapped
+    MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    const uint8_t* GetData() const noexcept { return m_data; }
+    size_t GetSize() const noexcept { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// Read-write mapping of the new file of the given size, the changes are written to the file by the OS,
+// so the size of the file is not limited by the memory
+class MappedOutputFile : Noncopyable {
+public:
+    MappedOutputFile() = delete;
+    // The file is created or truncated
+    // Throws EngineError if the file can not be created or mapped
+    MappedOutputFile(const std::filesystem::path& path, size_t size);
+    ~MappedOutputFile();
+
+    uint8_t* GetData() noexcept { return m_data; }
+    size_t GetSize() const noexcept { return m_size; }
+
+    // Waits until the changes are written to the file
+    // Throws EngineError
+    void Flush();
+
+private:
+    std::filesystem::path m_path;
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    // HANDLE of the file, kept open for Flush
+    void* m_file = nullptr;
+#endif
+};
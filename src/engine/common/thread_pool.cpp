@@ -0,0 +1,121 @@
+#include "engine/common/thread_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    m_threads.reserve(threadCount);
+    for (uint32_t i=0; i!=threadCount; ++i) {
+        m_threads.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& thread: m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+void ThreadPool::Submit(Task&& task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::ParallelFor(uint32_t begin, uint32_t end, uint32_t chunkSize, uint32_t workerCount, const RangeTask& fn) {
+    if (begin >= end) {
+        return;
+    }
+
+    chunkSize = std::max(chunkSize, 1u);
+    const uint32_t chunkCount = (end - begin - 1) / chunkSize + 1;
+    if ((workerCount == 0) || (workerCount > GetThreadCount())) {
+        workerCount = GetThreadCount();
+    }
+    const uint32_t helperCount = std::min(workerCount, chunkCount) - 1;
+
+    if (helperCount == 0) {
+        fn(begin, end);
+        return;
+    }
+
+    struct State {
+        std::atomic<uint32_t> nextChunk = 0;
+        std::atomic<uint32_t> doneChunks = 0;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::exception_ptr error = nullptr;
+    };
+
+    // helpers can start after ParallelFor returns, at that moment there is no chunks left
+    // and they exit without touching fn
+    auto state = std::make_shared<State>();
+    auto run = [state, begin, end, chunkSize, chunkCount, &fn]() {
+        for (;;) {
+            const uint32_t chunk = state->nextChunk.fetch_add(1);
+            if (chunk >= chunkCount) {
+                return;
+            }
+
+            const uint32_t chunkBegin = begin + chunk * chunkSize;
+            const uint32_t chunkEnd = std::min(chunkBegin + chunkSize, end);
+            try {
+                fn(chunkBegin, chunkEnd);
+            } catch(...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+
+            if (state->doneChunks.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->condition.notify_all();
+            }
+        }
+    };
+
+    for (uint32_t i=0; i!=helperCount; ++i) {
+        Submit(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&state, chunkCount]() { return state->doneChunks.load() == chunkCount; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
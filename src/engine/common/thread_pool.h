@@ -0,0 +1,47 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "engine/common/noncopyable.h"
+
+
+class ThreadPool : Noncopyable {
+public:
+    using Task = std::function<void ()>;
+    // [begin, end)
+    using RangeTask = std::function<void (uint32_t /* begin */, uint32_t /* end */)>;
+
+    // threadCount == 0 - use std::thread::hardware_concurrency()
+    ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    static ThreadPool& Get() noexcept {
+        static ThreadPool instance;
+        return instance;
+    }
+
+    uint32_t GetThreadCount() const noexcept { return static_cast<uint32_t>(m_threads.size()); }
+
+    void Submit(Task&& task);
+
+    // Splits [begin, end) into chunks of chunkSize elements and runs fn for them on at most workerCount threads,
+    // the calling thread takes part in the work, so it is safe to call from a pool thread.
+    // workerCount == 0 - use all pool threads.
+    // The first exception thrown by fn is rethrown in the calling thread after all chunks are finished.
+    void ParallelFor(uint32_t begin, uint32_t end, uint32_t chunkSize, uint32_t workerCount, const RangeTask& fn);
+
+private:
+    void WorkerLoop();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_tasks;
+    std::vector<std::thread> m_threads;
+    bool m_stop = false;
+};
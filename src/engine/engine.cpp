@@ -1,7 +1,9 @@
 #include "engine/engine.h"
 
 #include <chrono>
+#include <spdlog/spdlog.h>
 #include "engine/api/gl.h"
+#include "engine/api/gl_state.h"
 
 
 void Engine::Create(bool isFullscreen, float windowMultiplier) {
@@ -12,14 +14,15 @@ void Engine::Create(bool isFullscreen, float windowMultiplier) {
     m_gui.Create();
     m_physics.Create();
 
-    glEnable(GL_DEPTH_TEST);
+    auto& state = GLState::Get();
+    state.SetEnabled(GL_DEPTH_TEST, true);
 
-    // glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glFrontFace(GL_CCW);
+    // state.SetEnabled(GL_CULL_FACE, true);
+    state.CullFace(GL_BACK);
+    state.FrontFace(GL_CCW);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.SetEnabled(GL_BLEND, true);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     glLineWidth(2.0f);
     SetFillPoligone(m_fillPoligone);
@@ -27,6 +30,8 @@ void Engine::Create(bool isFullscreen, float windowMultiplier) {
 
 void Engine::Run(const std::function<void (float /* deltaTime */)>& updateCallback, const std::function<void ()>& drawCallback) {
     auto timeLast = std::chrono::steady_clock::now();
+    // the GL state counters are reported once per second
+    auto timeReport = timeLast;
 
     uint32_t width, height;
     auto& wio = m_window.GetIO();
@@ -49,6 +54,12 @@ void Engine::Run(const std::function<void (float /* deltaTime */)>& updateCallba
         m_physics.Update(m_deltaTime);
         updateCallback(m_deltaTime);
         drawCallback();
+        GLState::Get().EndFrame();
+        if ((now - timeReport) >= std::chrono::seconds(1)) {
+            timeReport = now;
+            spdlog::debug("GL state: elided calls {}, issued calls {} in the last frame",
+                GLState::Get().GetElidedCalls(), GLState::Get().GetIssuedCalls());
+        }
 
         m_window.EndFrame();
     }
@@ -56,5 +67,5 @@ void Engine::Run(const std::function<void (float /* deltaTime */)>& updateCallba
 
 void Engine::SetFillPoligone(bool value) noexcept {
     m_fillPoligone = value;
-    glPolygonMode(GL_FRONT_AND_BACK, m_fillPoligone ? GL_FILL : GL_LINE);
+    GLState::Get().PolygonMode(m_fillPoligone ? GL_FILL : GL_LINE);
 }
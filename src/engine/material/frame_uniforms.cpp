@@ -0,0 +1,46 @@
+#include "engine/material/frame_uniforms.h"
+
+#include "engine/camera/camera.h"
+
+
+FrameUniforms::FrameUniforms()
+    : m_buffer(GetDecl().GetSize()) {
+
+}
+
+const UniformBufferDecl& FrameUniforms::GetDecl() {
+    static const UniformBufferDecl decl(BindingPoint, 160, {
+        {"uProjMatrix", 0},
+        {"uViewMatrix", 64},
+        {"uToEyeDirection", 128},
+        {"uTime", 140},
+        {"uViewportSize", 144},
+    });
+
+    return decl;
+}
+
+bool FrameUniforms::IsCompatible(const UniformBufferDecl& decl) noexcept {
+    const auto& expected = GetDecl();
+    for (const char* name: {"uProjMatrix", "uViewMatrix", "uToEyeDirection", "uTime", "uViewportSize"}) {
+        if (decl.GetOffset(name) != expected.GetOffset(name)) {
+            return false;
+        }
+    }
+
+    return (decl.GetSize() <= expected.GetSize());
+}
+
+void FrameUniforms::Update(const std::shared_ptr<Camera>& camera, float time, const glm::vec2& viewportSize) {
+    const auto& decl = GetDecl();
+    m_buffer.setUniform(decl.GetOffset("uProjMatrix"), camera->GetProjMatrix());
+    m_buffer.setUniform(decl.GetOffset("uViewMatrix"), camera->GetViewMatrix());
+    m_buffer.setUniform(decl.GetOffset("uToEyeDirection"), camera->GetToEyeDirection());
+    m_buffer.setUniform(decl.GetOffset("uTime"), time);
+    m_buffer.setUniform(decl.GetOffset("uViewportSize"), viewportSize);
+    m_buffer.Sync();
+}
+
+void FrameUniforms::Bind() const {
+    m_buffer.Bind(BindingPoint);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <glm/vec2.hpp>
+#include "engine/common/noncopyable.h"
+#include "engine/material/uniform_buffer.h"
+
+
+// The std140 uniform block "FrameData" shared by all shaders, it is filled once per frame:
+// layout (std140) uniform FrameData {
+//     mat4 uProjMatrix;
+//     mat4 uViewMatrix;
+//     vec3 uToEyeDirection;
+//     float uTime;
+//     vec2 uViewportSize;
+// };
+// ShaderManager binds the block of every program to BindingPoint.
+class Camera;
+class FrameUniforms : Noncopyable {
+public:
+    FrameUniforms();
+    ~FrameUniforms() = default;
+
+    static constexpr uint BindingPoint = 0;
+    static constexpr const char* BlockName = "FrameData";
+
+    // std140 offsets of the members of the block
+    static const UniformBufferDecl& GetDecl();
+    // the offsets of the block of the shader are the same as in GetDecl
+    static bool IsCompatible(const UniformBufferDecl& decl) noexcept;
+
+    void Update(const std::shared_ptr<Camera>& camera, float time, const glm::vec2& viewportSize);
+    void Bind() const;
+
+private:
+    UniformBuffer m_buffer;
+};
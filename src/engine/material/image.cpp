@@ -1,7 +1,6 @@
 #include "engine/material/image.h"
 
 #include <fmt/format.h>
-#include "engine/api/gl.h"
 
 
 std::string ToStr(PixelFormat value) {
@@ -49,42 +48,6 @@ bool ImageHeader::operator!=(const ImageHeader& other) const noexcept {
     return !operator==(other);
 }
 
-bool ImageHeader::GetOpenGLFormat(uint& internalFormat, uint& inFormat, uint& type) const noexcept {
-    static constexpr const uint UNKNOWN = std::numeric_limits<uint>::max();
-    internalFormat = UNKNOWN;
-    inFormat = UNKNOWN;
-    type = UNKNOWN;
-    switch (format) {
-        case PixelFormat::R8: internalFormat = GL_R8; inFormat = GL_RED; type = GL_UNSIGNED_BYTE; break;
-        case PixelFormat::R16: internalFormat = GL_R16; inFormat = GL_RED; type = GL_UNSIGNED_SHORT; break;
-        case PixelFormat::R32: internalFormat = GL_R32F; inFormat = GL_RED; type = GL_FLOAT; break;
-
-        case PixelFormat::R8G8: internalFormat = GL_RG8; inFormat = GL_RG; type = GL_UNSIGNED_BYTE; break;          // NONE
-        case PixelFormat::R16G16: internalFormat = GL_RG16; inFormat = GL_RG; type = GL_UNSIGNED_SHORT; break;      // NONE
-        case PixelFormat::R32G32: internalFormat = GL_RG32F; inFormat = GL_RG; type = GL_FLOAT; break;              // NONE
-
-        case PixelFormat::R5G6B5: internalFormat = GL_RGB565; inFormat = GL_RGB; type = GL_UNSIGNED_SHORT_5_6_5; break;
-        case PixelFormat::R8G8B8: internalFormat = GL_RGB8; inFormat = GL_RGB; type = GL_UNSIGNED_BYTE; break;      // NONE
-        case PixelFormat::R16G16B16: internalFormat = GL_RGB16; inFormat = GL_RGB; type = GL_UNSIGNED_SHORT; break; // NONE
-        case PixelFormat::R32G32B32: internalFormat = GL_RGB32F; inFormat = GL_RGB; type = GL_FLOAT; break;         // NONE
-
-        case PixelFormat::R4G4B4A4: internalFormat = GL_RGBA4; inFormat = GL_RGBA; type = GL_UNSIGNED_SHORT_4_4_4_4; break;   // GL_UNSIGNED_INT_8_8_8_8_REV
-        case PixelFormat::R5G5B5A1: internalFormat = GL_RGB5_A1; inFormat = GL_RGBA; type = GL_UNSIGNED_SHORT_5_5_5_1; break; // GL_UNSIGNED_SHORT_1_5_5_5_REV
-        case PixelFormat::R8G8B8A8: internalFormat = GL_RGBA8; inFormat = GL_RGBA; type = GL_UNSIGNED_BYTE; break;            // GL_UNSIGNED_INT_8_8_8_8_REV
-        case PixelFormat::R16G16B16A16: internalFormat = GL_RGBA16; inFormat = GL_RGBA; type = GL_UNSIGNED_SHORT; break;
-        case PixelFormat::R32G32B32A32: internalFormat = GL_RGBA32F; inFormat = GL_RGBA; type = GL_FLOAT; break;
-
-        case PixelFormat::DXT1_RGB: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
-        case PixelFormat::DXT1_RGBA: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
-        case PixelFormat::DXT3_RGBA: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
-        case PixelFormat::DXT5_RGBA: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
-
-        default: return false;
-    }
-
-    return true;
-}
-
 size_t ImageHeader::GetSize() const noexcept {
     size_t bpp = 0; // Bits per pixel
     switch (format) {
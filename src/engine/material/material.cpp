@@ -1,6 +1,5 @@
 #include "engine/material/material.h"
 
-#include "engine/camera/camera.h"
 #include "engine/material/shader.h"
 #include "engine/material/texture.h"
 #include "engine/common/hash_combine.h"
@@ -29,29 +28,39 @@ bool Material::Desc::operator==(const Material::Desc& other) const {
 Material::Material(uint32_t id, const Material::Desc& desc)
     : m_id(id)
     , m_desc(desc) {
+
+    const auto& shader = m_desc.m_shader;
+    m_uniforms.baseTexture = shader->GetUniform<int>("uBaseTexture");
+    m_uniforms.baseColor = shader->GetUniform<math::Color3f>("uBaseColor");
+    m_uniforms.modelMatrix = shader->GetUniform<glm::mat4>("uModelMatrix");
+    m_uniforms.normalMatrix = shader->GetUniform<glm::mat3>("uNormalMatrix");
 }
 
 uint32_t Material::GetShaderId() const noexcept {
     return m_desc.m_shader->GetId();
 }
 
+bool Material::IsInstanced() const noexcept {
+    return m_desc.m_shader->IsInstanced();
+}
+
 void Material::BindShader() const {
     m_desc.m_shader->Bind();
 }
 
-void Material::BindUniforms(const std::shared_ptr<Camera>& camera, const glm::mat4& matModel, const glm::mat3& matNormal) const {
+void Material::BindUniforms() const {
     if (m_desc.m_baseTexture) {
         m_desc.m_baseTexture->Bind(m_desc.m_baseTextureUnit);
-        m_desc.m_shader->SetInt("uBaseTexture", int(m_desc.m_baseTextureUnit));
+        m_desc.m_shader->Set(m_uniforms.baseTexture, int(m_desc.m_baseTextureUnit));
     }
-    m_desc.m_shader->SetColor3("uBaseColor", m_desc.m_baseColor.ToColor3f());
+    m_desc.m_shader->Set(m_uniforms.baseColor, m_desc.m_baseColor.ToColor3f());
+}
 
-    m_desc.m_shader->SetMat4("uProjMatrix", camera->GetProjMatrix());
-    m_desc.m_shader->SetMat4("uViewMatrix", camera->GetViewMatrix());
-    m_desc.m_shader->SetVec3("uToEyeDirection", camera->GetToEyeDirection());
+void Material::BindUniforms(const glm::mat4& matModel, const glm::mat3& matNormal) const {
+    BindUniforms();
 
-    m_desc.m_shader->SetMat4("uModelMatrix", matModel);
-    m_desc.m_shader->SetMat3("uNormalMatrix", matNormal);
+    m_desc.m_shader->Set(m_uniforms.modelMatrix, matModel);
+    m_desc.m_shader->Set(m_uniforms.normalMatrix, matNormal);
 }
 
 void Material::Unbind() const {
@@ -4,10 +4,9 @@
 #include <glm/mat4x4.hpp>
 #include "engine/common/math.h"
 #include "engine/common/noncopyable.h"
+#include "engine/material/shader.h"
 
 
-class Shader;
-class Camera;
 class Texture;
 class Material : Noncopyable {
     friend class MaterialManager;
@@ -30,12 +29,25 @@ public:
 public:
     uint32_t GetId() const noexcept { return m_id; }
     uint32_t GetShaderId() const noexcept;
+    bool IsInstanced() const noexcept;
 
     void BindShader() const;
-    void BindUniforms(const std::shared_ptr<Camera>& camera, const glm::mat4& matModel, const glm::mat3& matNormal) const;
+    // binds the uniforms of the instanced shader, the model and normal matrices are per-instance attributes,
+    // the camera uniforms are in the FrameData block (see FrameUniforms)
+    void BindUniforms() const;
+    void BindUniforms(const glm::mat4& matModel, const glm::mat3& matNormal) const;
     void Unbind() const;
 
 private:
+    // resolved once in the constructor
+    struct Uniforms {
+        UniformHandle<int> baseTexture;
+        UniformHandle<math::Color3f> baseColor;
+        UniformHandle<glm::mat4> modelMatrix;
+        UniformHandle<glm::mat3> normalMatrix;
+    };
+
     const uint32_t m_id = 0;
     const Desc m_desc;
+    Uniforms m_uniforms;
 };
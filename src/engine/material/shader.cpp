@@ -1,13 +1,36 @@
 #include "engine/material/shader.h"
 
+#include <type_traits>
 #include <glm/gtc/type_ptr.hpp>
 #include "engine/api/gl.h"
+#include "engine/api/gl_state.h"
+#include "engine/common/exception.h"
 #include "engine/material/uniform_buffer.h"
 
 
-Shader::Shader(const PrivateArg&, uint32_t id, uint handle)
+namespace {
+
+template <typename T> struct UniformType;
+template <> struct UniformType<bool> { static constexpr GLenum value = GL_BOOL; };
+template <> struct UniformType<int> { static constexpr GLenum value = GL_INT; };
+template <> struct UniformType<float> { static constexpr GLenum value = GL_FLOAT; };
+template <> struct UniformType<glm::vec2> { static constexpr GLenum value = GL_FLOAT_VEC2; };
+template <> struct UniformType<glm::vec3> { static constexpr GLenum value = GL_FLOAT_VEC3; };
+template <> struct UniformType<glm::vec4> { static constexpr GLenum value = GL_FLOAT_VEC4; };
+template <> struct UniformType<glm::mat2> { static constexpr GLenum value = GL_FLOAT_MAT2; };
+template <> struct UniformType<glm::mat3> { static constexpr GLenum value = GL_FLOAT_MAT3; };
+template <> struct UniformType<glm::mat4> { static constexpr GLenum value = GL_FLOAT_MAT4; };
+template <> struct UniformType<math::Color3f> { static constexpr GLenum value = GL_FLOAT_VEC3; };
+template <> struct UniformType<math::Color4f> { static constexpr GLenum value = GL_FLOAT_VEC4; };
+
+}
+
+
+Shader::Shader(const PrivateArg&, uint32_t id, uint handle, ShaderReflection&& reflection)
     : m_id(id)
-    , m_handle(handle) {
+    , m_handle(handle)
+    , m_isInstanced(glGetAttribLocation(handle, "iModelMatrix") != -1)
+    , m_reflection(std::move(reflection)) {
 
 }
 
@@ -16,21 +39,21 @@ Shader::~Shader() {
 }
 
 void Shader::Bind() const {
-    glUseProgram(m_handle);
+    GLState::Get().UseProgram(m_handle);
 }
 
 void Shader::Unbind() const {
-    glUseProgram(0);
+    GLState::Get().UseProgram(0);
 }
 
 std::shared_ptr<UniformBufferDecl> Shader::GetUBDecl(const char* name) {
-    GLuint ubIndex = glGetUniformBlockIndex(m_handle, name);
-    if (ubIndex == GL_INVALID_INDEX) {
+    const auto it = m_reflection.blocks.find(name);
+    if (it == m_reflection.blocks.cend()) {
         return nullptr;
     }
 
-    int ubSize, ubVarCountI;
-    glGetActiveUniformBlockiv(m_handle, ubIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &ubSize);
+    GLuint ubIndex = it->second.index;
+    int ubVarCountI;
     glGetActiveUniformBlockiv(m_handle, ubIndex, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &ubVarCountI);
 
     auto ubVarCount = static_cast<size_t>(ubVarCountI);
@@ -52,67 +75,169 @@ std::shared_ptr<UniformBufferDecl> Shader::GetUBDecl(const char* name) {
         offsetMap[std::string(nameBuf, nameBuf + nameLen)] = static_cast<size_t>(offsets[i]);
     }
 
-    return std::make_shared<UniformBufferDecl>(ubIndex, static_cast<size_t>(ubSize), std::move(offsetMap));
+    return std::make_shared<UniformBufferDecl>(ubIndex, it->second.size, std::move(offsetMap));
+}
+
+template <typename T> UniformHandle<T> Shader::GetUniform(const char* name) const {
+    const auto it = m_reflection.uniforms.find(name);
+    if (it == m_reflection.uniforms.cend()) {
+        return UniformHandle<T>();
+    }
+
+    const auto& uniform = it->second;
+    const bool isSamplerUnit = (std::is_same<T, int>::value && uniform.isSampler);
+    if ((uniform.type != UniformType<T>::value) && !isSamplerUnit) {
+        throw EngineError("uniform '{}' of the shader {} has the type {:#x}, expected {:#x}", name, m_id, uniform.type, UniformType<T>::value);
+    }
+
+    return UniformHandle<T>(uniform.location);
+}
+
+template UniformHandle<bool> Shader::GetUniform<bool>(const char* name) const;
+template UniformHandle<int> Shader::GetUniform<int>(const char* name) const;
+template UniformHandle<float> Shader::GetUniform<float>(const char* name) const;
+template UniformHandle<glm::vec2> Shader::GetUniform<glm::vec2>(const char* name) const;
+template UniformHandle<glm::vec3> Shader::GetUniform<glm::vec3>(const char* name) const;
+template UniformHandle<glm::vec4> Shader::GetUniform<glm::vec4>(const char* name) const;
+template UniformHandle<glm::mat2> Shader::GetUniform<glm::mat2>(const char* name) const;
+template UniformHandle<glm::mat3> Shader::GetUniform<glm::mat3>(const char* name) const;
+template UniformHandle<glm::mat4> Shader::GetUniform<glm::mat4>(const char* name) const;
+template UniformHandle<math::Color3f> Shader::GetUniform<math::Color3f>(const char* name) const;
+template UniformHandle<math::Color4f> Shader::GetUniform<math::Color4f>(const char* name) const;
+
+void Shader::Set(UniformHandle<bool> handle, bool value) const {
+    if (handle.IsValid()) {
+        glUniform1i(handle.m_location, static_cast<int>(value));
+    }
+}
+
+void Shader::Set(UniformHandle<int> handle, int value) const {
+    if (handle.IsValid()) {
+        glUniform1i(handle.m_location, value);
+    }
+}
+
+void Shader::Set(UniformHandle<float> handle, float value) const {
+    if (handle.IsValid()) {
+        glUniform1f(handle.m_location, value);
+    }
+}
+
+void Shader::Set(UniformHandle<glm::vec2> handle, const glm::vec2& vec) const {
+    if (handle.IsValid()) {
+        glUniform2fv(handle.m_location, 1, glm::value_ptr(vec));
+    }
+}
+
+void Shader::Set(UniformHandle<glm::vec3> handle, const glm::vec3& vec) const {
+    if (handle.IsValid()) {
+        glUniform3fv(handle.m_location, 1, glm::value_ptr(vec));
+    }
+}
+
+void Shader::Set(UniformHandle<glm::vec4> handle, const glm::vec4& vec) const {
+    if (handle.IsValid()) {
+        glUniform4fv(handle.m_location, 1, glm::value_ptr(vec));
+    }
+}
+
+void Shader::Set(UniformHandle<glm::mat2> handle, const glm::mat2& mat) const {
+    if (handle.IsValid()) {
+        glUniformMatrix2fv(handle.m_location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+}
+
+void Shader::Set(UniformHandle<glm::mat3> handle, const glm::mat3& mat) const {
+    if (handle.IsValid()) {
+        glUniformMatrix3fv(handle.m_location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+}
+
+void Shader::Set(UniformHandle<glm::mat4> handle, const glm::mat4& mat) const {
+    if (handle.IsValid()) {
+        glUniformMatrix4fv(handle.m_location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+}
+
+void Shader::Set(UniformHandle<math::Color3f> handle, math::Color3f value) const {
+    if (handle.IsValid()) {
+        glUniform3fv(handle.m_location, 1, value.value);
+    }
+}
+
+void Shader::Set(UniformHandle<math::Color4f> handle, math::Color4f value) const {
+    if (handle.IsValid()) {
+        glUniform4fv(handle.m_location, 1, value.value);
+    }
 }
 
 void Shader::SetBool(const char* name, bool value) const {
-    glUniform1i(glGetUniformLocation(m_handle, name), static_cast<int>(value));
+    glUniform1i(GetLocation(name), static_cast<int>(value));
 }
 
 void Shader::SetInt(const char* name, int value) const {
-    glUniform1i(glGetUniformLocation(m_handle, name), value);
+    glUniform1i(GetLocation(name), value);
 }
 
 void Shader::SetFloat(const char* name, float value) const {
-    glUniform1f(glGetUniformLocation(m_handle, name), value);
+    glUniform1f(GetLocation(name), value);
 }
 
 void Shader::SetVec2(const char* name, const glm::vec2& vec) const {
-    glUniform2fv(glGetUniformLocation(m_handle, name), 1, glm::value_ptr(vec));
+    glUniform2fv(GetLocation(name), 1, glm::value_ptr(vec));
 }
 
 void Shader::SetVec2(const char* name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(m_handle, name), x, y);
+    glUniform2f(GetLocation(name), x, y);
 }
 
 void Shader::SetVec3(const char* name, const glm::vec3& vec) const {
-    glUniform3fv(glGetUniformLocation(m_handle, name), 1, glm::value_ptr(vec));
+    glUniform3fv(GetLocation(name), 1, glm::value_ptr(vec));
 }
 
 void Shader::SetVec3(const char* name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(m_handle, name), x, y, z);
+    glUniform3f(GetLocation(name), x, y, z);
 }
 
 void Shader::SetVec4(const char* name, const glm::vec4& vec) const {
-    glUniform4fv(glGetUniformLocation(m_handle, name), 1, glm::value_ptr(vec));
+    glUniform4fv(GetLocation(name), 1, glm::value_ptr(vec));
 }
 
 void Shader::SetVec4(const char* name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(m_handle, name), x, y, z, w);
+    glUniform4f(GetLocation(name), x, y, z, w);
 }
 
 void Shader::SetMat2(const char* name, const glm::mat2& mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(m_handle, name), 1, GL_FALSE, glm::value_ptr(mat));
+    glUniformMatrix2fv(GetLocation(name), 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 void Shader::SetMat3(const char* name, const glm::mat3& mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(m_handle, name), 1, GL_FALSE, glm::value_ptr(mat));
+    glUniformMatrix3fv(GetLocation(name), 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 void Shader::SetMat4(const char* name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(m_handle, name), 1, GL_FALSE, glm::value_ptr(mat));
+    glUniformMatrix4fv(GetLocation(name), 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 void Shader::SetColor3(const char* name, math::Color3f value) const {
-    glUniform3fv(glGetUniformLocation(m_handle, name), 1, value.value);
+    glUniform3fv(GetLocation(name), 1, value.value);
 }
 
 void Shader::SetColor4(const char* name, math::Color4f value) const {
-    glUniform4fv(glGetUniformLocation(m_handle, name), 1, value.value);
+    glUniform4fv(GetLocation(name), 1, value.value);
+}
+
+int Shader::GetLocation(const char* name) const {
+    const auto it = m_reflection.uniforms.find(name);
+    if (it == m_reflection.uniforms.cend()) {
+        return -1;
+    }
+
+    return it->second.location;
 }
 
 void Shader::Destroy() {
     if (m_handle != 0) {
-        glDeleteProgram(m_handle);
+        GLState::Get().DeleteProgram(m_handle);
     }
 }
@@ -1,11 +1,49 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <glm/mat4x4.hpp>
 #include "engine/common/math.h"
 #include "engine/common/noncopyable.h"
 
 
+// Active uniforms and uniform blocks of the linked program, filled once by ShaderManager
+struct ShaderReflection {
+    struct Uniform {
+        int location = -1;
+        // GL type of the uniform, for example GL_FLOAT_MAT4 or GL_SAMPLER_2D
+        uint type = 0;
+        // number of the elements of the array, 1 for not arrays
+        int count = 1;
+        bool isSampler = false;
+    };
+
+    struct Block {
+        uint index = 0;
+        size_t size = 0;
+    };
+
+    // the uniforms of the default block, the names of the arrays are without "[0]"
+    std::unordered_map<std::string, Uniform> uniforms;
+    std::unordered_map<std::string, Block> blocks;
+};
+
+// Pre-resolved location of the uniform with the value type T, see Shader::GetUniform.
+// The invalid handle (the uniform is not active in the shader) is ignored by Shader::Set.
+template <typename T> class UniformHandle {
+    friend class Shader;
+public:
+    UniformHandle() = default;
+
+    bool IsValid() const noexcept { return m_location != -1; }
+
+private:
+    explicit UniformHandle(int location) noexcept : m_location(location) {}
+
+    int m_location = -1;
+};
+
 class UniformBufferDecl;
 class Shader : Noncopyable {
     struct PrivateArg{};
@@ -13,15 +51,37 @@ class Shader : Noncopyable {
 
 public:
     Shader() = delete;
-    Shader(const PrivateArg&, uint32_t id, uint handle);
+    Shader(const PrivateArg&, uint32_t id, uint handle, ShaderReflection&& reflection);
     ~Shader();
 
     void Bind() const;
     void Unbind() const;
 
     uint32_t GetId() const noexcept { return m_id; }
+    // the vertex shader reads the model and normal matrices from the per-instance attributes (see InstanceData)
+    bool IsInstanced() const noexcept { return m_isInstanced; }
     std::shared_ptr<UniformBufferDecl> GetUBDecl(const char* name);
+    const ShaderReflection& GetReflection() const noexcept { return m_reflection; }
+
+    // Resolves the uniform once, throws EngineError if the type of the active uniform does not match T
+    // (int is accepted for the samplers). Returns the invalid handle if the uniform is not active.
+    // T: bool, int, float, glm::vec2, glm::vec3, glm::vec4, glm::mat2, glm::mat3, glm::mat4, math::Color3f, math::Color4f
+    template <typename T> UniformHandle<T> GetUniform(const char* name) const;
+
+    // the per-draw setters, without the GL queries and the string lookups
+    void Set(UniformHandle<bool> handle, bool value) const;
+    void Set(UniformHandle<int> handle, int value) const;
+    void Set(UniformHandle<float> handle, float value) const;
+    void Set(UniformHandle<glm::vec2> handle, const glm::vec2& vec) const;
+    void Set(UniformHandle<glm::vec3> handle, const glm::vec3& vec) const;
+    void Set(UniformHandle<glm::vec4> handle, const glm::vec4& vec) const;
+    void Set(UniformHandle<glm::mat2> handle, const glm::mat2& mat) const;
+    void Set(UniformHandle<glm::mat3> handle, const glm::mat3& mat) const;
+    void Set(UniformHandle<glm::mat4> handle, const glm::mat4& mat) const;
+    void Set(UniformHandle<math::Color3f> handle, math::Color3f value) const;
+    void Set(UniformHandle<math::Color4f> handle, math::Color4f value) const;
 
+    // the setters by name look up the location in the reflection table
     void SetBool(const char* name, bool value) const;
     void SetInt(const char* name, int value) const;
     void SetFloat(const char* name, float value) const;
@@ -38,9 +98,12 @@ public:
     void SetColor4(const char* name, math::Color4f value) const;
 
 private:
+    int GetLocation(const char* name) const;
     void Destroy();
 
 private:
     const uint32_t m_id = 0;
     const uint m_handle = 0;
+    const bool m_isInstanced = false;
+    const ShaderReflection m_reflection;
 };
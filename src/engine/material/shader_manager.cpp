@@ -6,6 +6,7 @@
 #include "engine/common/path.h"
 #include "engine/material/shader.h"
 #include "engine/common/exception.h"
+#include "engine/material/frame_uniforms.h"
 #include "engine/common/hash_combine.h"
 
 
@@ -33,7 +34,8 @@ std::shared_ptr<Shader> ShaderManager::Create(const std::filesystem::path& verte
             vertexShaderPath.c_str(), fragmentShaderPath.c_str(), infoLog);
     }
 
-    auto result = std::make_shared<Shader>(Shader::PrivateArg{}, ++m_lastId, shaderProgram);
+    auto result = std::make_shared<Shader>(Shader::PrivateArg{}, ++m_lastId, shaderProgram, Reflect(shaderProgram));
+    BindFrameUniforms(*result);
     m_programCache[key] = result;
     return result;
 }
@@ -65,7 +67,8 @@ std::shared_ptr<Shader> ShaderManager::Create(const std::filesystem::path& verte
             vertexShaderPath.c_str(), geometryShaderPath.c_str(), fragmentShaderPath.c_str(), infoLog);
     }
 
-    auto result = std::make_shared<Shader>(Shader::PrivateArg{}, ++m_lastId, shaderProgram);
+    auto result = std::make_shared<Shader>(Shader::PrivateArg{}, ++m_lastId, shaderProgram, Reflect(shaderProgram));
+    BindFrameUniforms(*result);
     m_programCache[key] = result;
     return result;
 }
@@ -143,6 +146,80 @@ uint ShaderManager::LoadShader(const std::filesystem::path& path, ShaderType sha
     }
 }
 
+ShaderReflection ShaderManager::Reflect(uint program) {
+    ShaderReflection result;
+    char nameBuf[256];
+
+    GLint uniformCount = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    for (GLint i=0; i!=uniformCount; ++i) {
+        GLsizei nameLen = 0;
+        GLint count = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(i), sizeof(nameBuf), &nameLen, &count, &type, nameBuf);
+        std::string name(nameBuf, nameBuf + nameLen);
+
+        // the members of the uniform blocks have no location
+        const GLint location = glGetUniformLocation(program, name.c_str());
+        if (location == -1) {
+            continue;
+        }
+
+        if (const auto pos = name.rfind("[0]"); (pos != std::string::npos) && (pos + 3 == name.size())) {
+            name.resize(pos);
+        }
+
+        ShaderReflection::Uniform uniform;
+        uniform.location = location;
+        uniform.type = type;
+        uniform.count = count;
+        switch (type) {
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_1D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+            uniform.isSampler = true;
+            break;
+        default:
+            break;
+        }
+        result.uniforms[name] = uniform;
+    }
+
+    GLint blockCount = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    for (GLint i=0; i!=blockCount; ++i) {
+        const auto index = static_cast<GLuint>(i);
+        GLsizei nameLen = 0;
+        glGetActiveUniformBlockName(program, index, sizeof(nameBuf), &nameLen, nameBuf);
+
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        result.blocks[std::string(nameBuf, nameBuf + nameLen)] = ShaderReflection::Block{index, static_cast<size_t>(size)};
+    }
+
+    return result;
+}
+
+void ShaderManager::BindFrameUniforms(Shader& shader) {
+    auto decl = shader.GetUBDecl(FrameUniforms::BlockName);
+    if (!decl) {
+        return;
+    }
+
+    if (!FrameUniforms::IsCompatible(*decl)) {
+        throw EngineError("the uniform block '{}' of the shader program {} does not match the layout of FrameUniforms",
+            FrameUniforms::BlockName, shader.GetId());
+    }
+    glUniformBlockBinding(shader.m_handle, decl->GetIndex(), FrameUniforms::BindingPoint);
+}
 
 std::size_t ShaderManager::ShaderCacheKey::operator()(const ShaderManager::ShaderCacheKey& value) const {
     std::size_t h = 0;
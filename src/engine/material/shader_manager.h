@@ -12,6 +12,7 @@ enum class ShaderType : uint8_t {
 };
 
 class Shader;
+struct ShaderReflection;
 class ShaderManager : Noncopyable {
 public:
     ShaderManager() = default;
@@ -34,6 +35,10 @@ private:
     std::string ParseMaterial(const std::string& data);
     uint CreateShader(const std::string& data, ShaderType shaderType);
     uint LoadShader(const std::filesystem::path& path, ShaderType shaderType);
+    // enumerates the active uniforms, samplers and uniform blocks of the linked program
+    static ShaderReflection Reflect(uint program);
+    // binds the "FrameData" block of the shader to FrameUniforms::BindingPoint
+    static void BindFrameUniforms(Shader& shader);
 
 private:
     struct ShaderCacheKey {
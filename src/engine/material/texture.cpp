@@ -1,9 +1,47 @@
 #include "engine/material/texture.h"
 
+#include <limits>
 #include "engine/api/gl.h"
+#include "engine/api/gl_state.h"
 #include "engine/common/exception.h"
 
 
+bool ImageHeader::GetOpenGLFormat(uint& internalFormat, uint& inFormat, uint& type) const noexcept {
+    static constexpr const uint UNKNOWN = std::numeric_limits<uint>::max();
+    internalFormat = UNKNOWN;
+    inFormat = UNKNOWN;
+    type = UNKNOWN;
+    switch (format) {
+        case PixelFormat::R8: internalFormat = GL_R8; inFormat = GL_RED; type = GL_UNSIGNED_BYTE; break;
+        case PixelFormat::R16: internalFormat = GL_R16; inFormat = GL_RED; type = GL_UNSIGNED_SHORT; break;
+        case PixelFormat::R32: internalFormat = GL_R32F; inFormat = GL_RED; type = GL_FLOAT; break;
+
+        case PixelFormat::R8G8: internalFormat = GL_RG8; inFormat = GL_RG; type = GL_UNSIGNED_BYTE; break;          // NONE
+        case PixelFormat::R16G16: internalFormat = GL_RG16; inFormat = GL_RG; type = GL_UNSIGNED_SHORT; break;      // NONE
+        case PixelFormat::R32G32: internalFormat = GL_RG32F; inFormat = GL_RG; type = GL_FLOAT; break;              // NONE
+
+        case PixelFormat::R5G6B5: internalFormat = GL_RGB565; inFormat = GL_RGB; type = GL_UNSIGNED_SHORT_5_6_5; break;
+        case PixelFormat::R8G8B8: internalFormat = GL_RGB8; inFormat = GL_RGB; type = GL_UNSIGNED_BYTE; break;      // NONE
+        case PixelFormat::R16G16B16: internalFormat = GL_RGB16; inFormat = GL_RGB; type = GL_UNSIGNED_SHORT; break; // NONE
+        case PixelFormat::R32G32B32: internalFormat = GL_RGB32F; inFormat = GL_RGB; type = GL_FLOAT; break;         // NONE
+
+        case PixelFormat::R4G4B4A4: internalFormat = GL_RGBA4; inFormat = GL_RGBA; type = GL_UNSIGNED_SHORT_4_4_4_4; break;   // GL_UNSIGNED_INT_8_8_8_8_REV
+        case PixelFormat::R5G5B5A1: internalFormat = GL_RGB5_A1; inFormat = GL_RGBA; type = GL_UNSIGNED_SHORT_5_5_5_1; break; // GL_UNSIGNED_SHORT_1_5_5_5_REV
+        case PixelFormat::R8G8B8A8: internalFormat = GL_RGBA8; inFormat = GL_RGBA; type = GL_UNSIGNED_BYTE; break;            // GL_UNSIGNED_INT_8_8_8_8_REV
+        case PixelFormat::R16G16B16A16: internalFormat = GL_RGBA16; inFormat = GL_RGBA; type = GL_UNSIGNED_SHORT; break;
+        case PixelFormat::R32G32B32A32: internalFormat = GL_RGBA32F; inFormat = GL_RGBA; type = GL_FLOAT; break;
+
+        case PixelFormat::DXT1_RGB: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+        case PixelFormat::DXT1_RGBA: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+        case PixelFormat::DXT3_RGBA: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+        case PixelFormat::DXT5_RGBA: if (GLApi::IsDXTSupported) internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+
+        default: return false;
+    }
+
+    return true;
+}
+
 Texture::Texture(uint32_t id, const ImageView& image, bool generateMipLevelsIfNeed, const PrivateArg&)
     : m_id(id)
     , m_header(image.header) {
@@ -30,7 +68,8 @@ void Texture::Update(const ImageView& image, bool generateMipLevels) {
         throw EngineError("unsupported texture format: {}", ToStr(image.header.format));
     }
 
-    glBindTexture(GL_TEXTURE_2D, m_handle);
+    // the texture is edited on the active unit, so the unit is selected explicitly, the texture stays bound to it
+    GLState::Get().BindTexture(GLState::EditTextureUnit, GL_TEXTURE_2D, m_handle);
 
     const GLint level = 0;
     const GLint xoffset = 0;
@@ -49,18 +88,14 @@ void Texture::Update(const ImageView& image, bool generateMipLevels) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, isOneLevel ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::Bind(uint unit) const noexcept {
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, m_handle);
+    GLState::Get().BindTexture(unit, GL_TEXTURE_2D, m_handle);
 }
 
 void Texture::Unbind(uint unit) const noexcept {
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::Get().BindTexture(unit, GL_TEXTURE_2D, 0);
 }
 
 void Texture::Create(const ImageView& image, bool generateMipLevelsIfNeed) {
@@ -79,7 +114,8 @@ void Texture::Create(const ImageView& image, bool generateMipLevelsIfNeed) {
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    glBindTexture(GL_TEXTURE_2D, m_handle);
+    // the texture is edited on the active unit, see Update
+    GLState::Get().BindTexture(GLState::EditTextureUnit, GL_TEXTURE_2D, m_handle);
 
     GLint level=0;
     auto mipImage = image;
@@ -107,13 +143,11 @@ void Texture::Create(const ImageView& image, bool generateMipLevelsIfNeed) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, isOneLevel ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::Destroy() noexcept {
     if (m_handle != 0) {
-        glDeleteTextures(1, &m_handle);
+        GLState::Get().DeleteTexture(m_handle);
         m_handle = 0;
     }
 }
@@ -3,6 +3,7 @@
 #include <cstring>
 #include <algorithm>
 #include "engine/api/gl.h"
+#include "engine/api/gl_state.h"
 
 
 UniformBuffer::UniformBuffer(size_t size)
@@ -14,7 +15,7 @@ UniformBuffer::UniformBuffer(size_t size)
 
 UniformBuffer::~UniformBuffer() {
     if (m_handle != 0) {
-        glDeleteBuffers(1, &m_handle);
+        GLState::Get().DeleteBuffer(m_handle);
         m_handle = 0;
     }
 
@@ -27,13 +28,12 @@ UniformBuffer::~UniformBuffer() {
 }
 
 void UniformBuffer::Sync() {
-    glBindBuffer(GL_UNIFORM_BUFFER, m_handle);
-    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(m_size), m_buffer, GL_STREAM_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::Get().BindBuffer(GLState::EditTarget, m_handle);
+    glBufferData(GLState::EditTarget, static_cast<GLsizeiptr>(m_size), m_buffer, GL_STREAM_DRAW);
 }
 
 void UniformBuffer::Bind(uint index) const {
-    glBindBufferBase(GL_UNIFORM_BUFFER, index, m_handle);
+    GLState::Get().BindBufferBase(GL_UNIFORM_BUFFER, index, m_handle);
 }
 
 const size_t UniformBufferDecl::InvalidOffset = std::numeric_limits<size_t>::max();
@@ -1,6 +1,7 @@
 #include "engine/scene/geometry_node.h"
 
 #include "engine/api/gl.h"
+#include "engine/api/gl_state.h"
 #include "engine/common/exception.h"
 
 
@@ -15,8 +16,21 @@ const VertexDecl VertexPNTC::vDecl = {
     {3, glm::vec2::length()}, // layout (location = 3) in vec2 vTexCoord;
 };
 
+const VertexDecl InstanceData::vDecl({
+    {4, glm::vec4::length()}, // layout (location = 4) in mat4 iModelMatrix;
+    {5, glm::vec4::length()},
+    {6, glm::vec4::length()},
+    {7, glm::vec4::length()},
+    {8, glm::vec3::length()}, // layout (location = 8) in mat3 iNormalMatrix;
+    {9, glm::vec3::length()},
+    {10, glm::vec3::length()},
+}, 1);
+
+static_assert(sizeof(InstanceData) == 25 * sizeof(float), "InstanceData must be tightly packed");
+
 // see: glGetAttribLocation
-VertexDecl::VertexDecl(const std::initializer_list<Layout>& layouts) {
+VertexDecl::VertexDecl(const std::initializer_list<Layout>& layouts, uint divisor)
+    : m_divisor(divisor) {
     if (layouts.size() >= 16) {
         throw EngineError("Number of available layers exceeded");
     }
@@ -40,107 +54,118 @@ void VertexDecl::Bind() const {
 
         glVertexAttribPointer(index, static_cast<GLint>(elementCnt), type, normalized, stride, pointer);
         glEnableVertexAttribArray(index);
+        if (m_divisor != 0) {
+            glVertexAttribDivisor(index, static_cast<GLuint>(m_divisor));
+        }
         pointer += (elementCnt * sizeof(GLfloat));
     }
 }
 
-DataBuffer::DataBuffer(uint target, size_t size)
+DataBuffer::DataBuffer(size_t size)
     : m_size(size) {
     glGenBuffers(1, &m_handle);
-    glBindBuffer(static_cast<GLenum>(target), m_handle);
-    glBufferData(static_cast<GLenum>(target), static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
-    glBindBuffer(static_cast<GLenum>(target), 0);
+    GLState::Get().BindBuffer(GLState::EditTarget, m_handle);
+    glBufferData(GLState::EditTarget, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
 }
 
-DataBuffer::DataBuffer(uint target, const void* data, size_t size)
+DataBuffer::DataBuffer(const void* data, size_t size)
     : m_size(size) {
     glGenBuffers(1, &m_handle);
-    glBindBuffer(static_cast<GLenum>(target), m_handle);
-    glBufferData(static_cast<GLenum>(target), static_cast<GLsizeiptr>(size), static_cast<const GLvoid *>(data), GL_STATIC_DRAW);
-    glBindBuffer(static_cast<GLenum>(target), 0);
+    GLState::Get().BindBuffer(GLState::EditTarget, m_handle);
+    glBufferData(GLState::EditTarget, static_cast<GLsizeiptr>(size), static_cast<const GLvoid *>(data), GL_STATIC_DRAW);
 }
 
-void* DataBuffer::Lock(uint target) const noexcept {
-    glBindBuffer(static_cast<GLenum>(target), m_handle);
-    return glMapBuffer(static_cast<GLenum>(target), GL_WRITE_ONLY);
+void* DataBuffer::Lock() const noexcept {
+    GLState::Get().BindBuffer(GLState::EditTarget, m_handle);
+    return glMapBuffer(GLState::EditTarget, GL_WRITE_ONLY);
 }
 
-bool DataBuffer::Unlock(uint target) const noexcept {
-    bool result = glUnmapBuffer(static_cast<GLenum>(target)) == GL_TRUE;
-    glBindBuffer(static_cast<GLenum>(target), 0);
+bool DataBuffer::Unlock() const noexcept {
+    GLState::Get().BindBuffer(GLState::EditTarget, m_handle);
+    return glUnmapBuffer(GLState::EditTarget) == GL_TRUE;
+}
 
-    return result;
+void DataBuffer::SetData(const void* data, size_t size) {
+    GLState::Get().BindBuffer(GLState::EditTarget, m_handle);
+    glBufferData(GLState::EditTarget, static_cast<GLsizeiptr>(size), static_cast<const GLvoid *>(data), GL_STREAM_DRAW);
+    m_size = size;
 }
 
 void DataBuffer::Destroy() {
     if (m_handle != 0) {
-        glDeleteBuffers(1, &m_handle);
+        GLState::Get().DeleteBuffer(m_handle);
         m_handle = 0;
     }
 }
 
 VertexBuffer::VertexBuffer(size_t size)
-    : DataBuffer(GL_ARRAY_BUFFER, size) {
+    : DataBuffer(size) {
 
 }
 
 VertexBuffer::VertexBuffer(const void* data, size_t size)
-    : DataBuffer(GL_ARRAY_BUFFER, data, size) {
+    : DataBuffer(data, size) {
 
 }
 
 void VertexBuffer::Bind() const {
-    glBindBuffer(GL_ARRAY_BUFFER, m_handle);
+    GLState::Get().BindBuffer(GL_ARRAY_BUFFER, m_handle);
 }
 
 void VertexBuffer::Unbind() const {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::Get().BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void* VertexBuffer::Lock() const noexcept {
-    return DataBuffer::Lock(GL_ARRAY_BUFFER);
+    return DataBuffer::Lock();
 }
 
 bool VertexBuffer::Unlock() const noexcept {
-    return DataBuffer::Unlock(GL_ARRAY_BUFFER);
+    return DataBuffer::Unlock();
+}
+
+void VertexBuffer::SetData(const void* data, size_t size) {
+    DataBuffer::SetData(data, size);
 }
 
 IndexBuffer::IndexBuffer(const uint16_t* data, size_t size)
-    : DataBuffer(GL_ELEMENT_ARRAY_BUFFER, data, size)
+    : DataBuffer(data, size)
     , m_type(GL_UNSIGNED_SHORT)
     , m_count(static_cast<uint>(size/sizeof(*data))) {
 
 }
 
 IndexBuffer::IndexBuffer(const uint32_t* data, size_t size)
-    : DataBuffer(GL_ELEMENT_ARRAY_BUFFER, data, size)
+    : DataBuffer(data, size)
     , m_type(GL_UNSIGNED_INT)
     , m_count(static_cast<uint>(size/sizeof(*data))) {
 
 }
 
 void IndexBuffer::Bind() const {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_handle);
+    GLState::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_handle);
 }
 
 void IndexBuffer::Unbind() const {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    GLState::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void* IndexBuffer::Lock() const noexcept {
-    return DataBuffer::Lock(GL_ELEMENT_ARRAY_BUFFER);
+    return DataBuffer::Lock();
 }
 
 bool IndexBuffer::Unlock() const noexcept {
-    return DataBuffer::Unlock(GL_ELEMENT_ARRAY_BUFFER);
+    return DataBuffer::Unlock();
 }
 
 uint32_t Counter::m_lastId = 0;
 
-GeometryNode::GeometryNode(const VertexDecl& vDecl, const VertexBuffer& vertexBuffer, const IndexBuffer& indexBuffer)
+GeometryNode::GeometryNode(const VertexDecl& vDecl, const VertexBuffer& vertexBuffer, const IndexBuffer& indexBuffer, const math::AABB& box)
     : m_vDecl(vDecl)
     , m_vertexBuffer(vertexBuffer)
-    , m_indexBuffer(indexBuffer) {
+    , m_indexBuffer(indexBuffer)
+    , m_box(box)
+    , m_sphere(box) {
 
     glGenVertexArrays(1, &m_handle);
 
@@ -149,9 +174,6 @@ GeometryNode::GeometryNode(const VertexDecl& vDecl, const VertexBuffer& vertexBu
     m_vDecl.Bind();
     m_indexBuffer.Bind();
     Unbind();
-
-    m_vertexBuffer.Unbind();
-    m_indexBuffer.Unbind();
 }
 
 GeometryNode::~GeometryNode() {
@@ -159,11 +181,11 @@ GeometryNode::~GeometryNode() {
 }
 
 void GeometryNode::Bind() const {
-    glBindVertexArray(m_handle);
+    GLState::Get().BindVertexArray(m_handle);
 }
 
 void GeometryNode::Unbind() const {
-    glBindVertexArray(0);
+    GLState::Get().BindVertexArray(0);
 }
 
 uint32_t GeometryNode::Draw() const {
@@ -171,9 +193,14 @@ uint32_t GeometryNode::Draw() const {
     return m_indexBuffer.Count() / 3;
 }
 
+uint32_t GeometryNode::DrawInstanced(uint32_t instanceCount) const {
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(m_indexBuffer.Count()), static_cast<GLenum>(m_indexBuffer.Type()), 0, static_cast<GLsizei>(instanceCount));
+    return (m_indexBuffer.Count() / 3) * instanceCount;
+}
+
 void GeometryNode::Destroy() {
     if (m_handle != 0) {
-        glDeleteVertexArrays(1, &m_handle);
+        GLState::Get().DeleteVertexArray(m_handle);
         m_handle = 0;
     }
 
@@ -192,8 +219,6 @@ Lines::Lines(const VertexDecl& vDecl, const VertexBuffer& vertexBuffer)
     m_vertexBuffer.Bind();
     m_vDecl.Bind();
     Unbind();
-
-    m_vertexBuffer.Unbind();
 }
 
 Lines::~Lines() {
@@ -201,11 +226,11 @@ Lines::~Lines() {
 }
 
 void Lines::Bind() const {
-    glBindVertexArray(m_handle);
+    GLState::Get().BindVertexArray(m_handle);
 }
 
 void Lines::Unbind() const {
-    glBindVertexArray(0);
+    GLState::Get().BindVertexArray(0);
 }
 
 uint32_t Lines::Draw() const {
@@ -215,7 +240,7 @@ uint32_t Lines::Draw() const {
 
 void Lines::Destroy() {
     if (m_handle != 0) {
-        glDeleteVertexArrays(1, &m_handle);
+        GLState::Get().DeleteVertexArray(m_handle);
         m_handle = 0;
     }
 
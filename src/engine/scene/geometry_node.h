@@ -3,6 +3,9 @@
 #include <string>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include "engine/common/bounds.h"
 #include "engine/common/noncopyable.h"
 
 
@@ -14,7 +17,8 @@ public:
     };
 
     VertexDecl() = delete;
-    VertexDecl(const std::initializer_list<Layout>& layouts);
+    // divisor - 0 for the per-vertex attributes, 1 for the per-instance attributes, see glVertexAttribDivisor
+    VertexDecl(const std::initializer_list<Layout>& layouts, uint divisor = 0);
     ~VertexDecl() = default;
 
 public:
@@ -27,6 +31,7 @@ public:
 private:
     uint8_t m_layoutsCount = 0;
     uint8_t m_vertexCount = 0;
+    uint m_divisor = 0;
     Layout m_layouts[16];
 };
 
@@ -46,11 +51,19 @@ struct VertexPNTC {
     static const VertexDecl vDecl;
 };
 
+// per-instance attributes of the instanced vertex materials (see vertex_instanced.mat)
+struct InstanceData {
+    glm::mat4 ModelMatrix;
+    glm::mat3 NormalMatrix;
+
+    static const VertexDecl vDecl;
+};
+
 class DataBuffer {
 protected:
     DataBuffer() = delete;
-    DataBuffer(uint target, size_t size);
-    DataBuffer(uint target, const void* data, size_t size);
+    DataBuffer(size_t size);
+    DataBuffer(const void* data, size_t size);
 
 public:
     ~DataBuffer() = default;
@@ -62,8 +75,10 @@ public:
     void Destroy();
 
 protected:
-    void* Lock(uint target) const noexcept;
-    bool Unlock(uint target) const noexcept;
+    // the buffer is edited through GLState::EditTarget, the bindings of the other targets are not changed
+    void* Lock() const noexcept;
+    bool Unlock() const noexcept;
+    void SetData(const void* data, size_t size);
 
 protected:
     size_t m_size;
@@ -81,6 +96,8 @@ public:
 
     void* Lock() const noexcept;
     bool Unlock() const noexcept;
+    // replaces the whole content of the buffer, the size of the buffer is changed to size
+    void SetData(const void* data, size_t size);
 };
 
 class IndexBuffer : public DataBuffer {
@@ -124,13 +141,19 @@ private:
 class GeometryNode : public Counter, Noncopyable {
 public:
     GeometryNode() = delete;
-    GeometryNode(const VertexDecl& vDecl, const VertexBuffer& vertexBuffer, const IndexBuffer& indexBuffer);
+    // box - the bounds of the positions of the vertices
+    GeometryNode(const VertexDecl& vDecl, const VertexBuffer& vertexBuffer, const IndexBuffer& indexBuffer, const math::AABB& box);
     ~GeometryNode();
 
 public:
+    // the local bounds, in the coordinates of the vertices
+    const math::AABB& GetBoundingBox() const noexcept { return m_box; }
+    const math::BoundingSphere& GetBoundingSphere() const noexcept { return m_sphere; }
+
     void Bind() const;
     void Unbind() const;
     uint32_t Draw() const;
+    uint32_t DrawInstanced(uint32_t instanceCount) const;
 
 private:
     void Destroy();
@@ -140,6 +163,8 @@ private:
     VertexDecl m_vDecl;
     VertexBuffer m_vertexBuffer;
     IndexBuffer m_indexBuffer;
+    math::AABB m_box;
+    math::BoundingSphere m_sphere;
 };
 
 class Lines : public Counter, Noncopyable {
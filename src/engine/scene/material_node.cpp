@@ -2,6 +2,9 @@
 
 #include <tuple>
 
+#include "engine/scene/geometry_node.h"
+#include "engine/scene/transform_graph.h"
+
 
 IndexKey::IndexKey(uint32_t shaderId, uint32_t geometryId, uint32_t materialId)
     : m_shaderId(shaderId)
@@ -57,6 +60,34 @@ MaterialNode::MaterialNode(const PrivateArg&, const std::shared_ptr<GeometryNode
     , m_material(material) {
 }
 
+MaterialNode::~MaterialNode() {
+    if (m_instanceBuffer) {
+        m_instanceBuffer->Destroy();
+    }
+}
+
 void MaterialNode::AttachTransformNode(const std::shared_ptr<TransformNode>& node) {
     m_transformNodes.insert(node);
 }
+
+uint32_t MaterialNode::DrawInstanced() {
+    m_instances.clear();
+    m_instances.reserve(m_transformNodes.size());
+    for (const auto& transformNode: m_transformNodes) {
+        m_instances.push_back(InstanceData{transformNode->GetTotalTransform(), transformNode->GetTotalNormalMatrix()});
+    }
+
+    const size_t size = m_instances.size() * sizeof(InstanceData);
+    if (!m_instanceBuffer) {
+        m_instanceBuffer = std::make_unique<VertexBuffer>(m_instances.data(), size);
+    } else {
+        m_instanceBuffer->SetData(m_instances.data(), size);
+    }
+
+    // the vertex array of the geometry can be shared by several material nodes,
+    // so the per-instance attributes are pointed to the own buffer before every draw
+    m_instanceBuffer->Bind();
+    InstanceData::vDecl.Bind();
+
+    return m_geometry->DrawInstanced(static_cast<uint32_t>(m_instances.size()));
+}
@@ -2,6 +2,7 @@
 
 #include <set>
 #include <memory>
+#include <vector>
 
 #include "engine/common/noncopyable.h"
 
@@ -34,17 +35,30 @@ private:
 class GeometryNode;
 class Material;
 class TransformNode;
+class VertexBuffer;
+struct InstanceData;
 class MaterialNode : Noncopyable {
     struct PrivateArg{};
     friend class Scene;
 public:
     MaterialNode() = delete;
     MaterialNode(const PrivateArg&, const std::shared_ptr<GeometryNode>& geometry, const std::shared_ptr<Material>& material);
+    ~MaterialNode();
+
+    const std::shared_ptr<GeometryNode>& GetGeometry() const noexcept { return m_geometry; }
 
     void AttachTransformNode(const std::shared_ptr<TransformNode>& node);
 
+private:
+    // packs the transforms into the instance buffer and draws all of them with one call,
+    // the geometry and the shader must be bound
+    uint32_t DrawInstanced();
+
 private:
     std::shared_ptr<GeometryNode> m_geometry = nullptr;
     std::shared_ptr<Material> m_material = nullptr;
     std::set<std::shared_ptr<TransformNode>> m_transformNodes;
+    // rebuilt every frame by DrawInstanced, the buffer is created on the first instanced draw
+    std::vector<InstanceData> m_instances;
+    std::unique_ptr<VertexBuffer> m_instanceBuffer;
 };
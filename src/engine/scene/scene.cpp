@@ -4,6 +4,7 @@
 
 #include "engine/camera/camera.h"
 #include "engine/material/material.h"
+#include "engine/material/frame_uniforms.h"
 #include "engine/scene/geometry_node.h"
 
 
@@ -11,6 +12,8 @@ Scene::Scene() {
     m_camera = std::make_shared<Camera>(glm::quarter_pi<float>(), 0.1f, 100.0);
 }
 
+Scene::~Scene() = default;
+
 std::shared_ptr<MaterialNode> Scene::CreateMaterialNode(const std::shared_ptr<Material>& material, const std::shared_ptr<GeometryNode>& geometry) {
     IndexKey key(material->GetShaderId(), geometry->GetId(), material->GetId());
     if (auto it = m_index.find(key); it != m_index.cend()) {
@@ -22,15 +25,25 @@ std::shared_ptr<MaterialNode> Scene::CreateMaterialNode(const std::shared_ptr<Ma
     return result;
 }
 
-void Scene::Update() {
+void Scene::SetViewportSize(uint32_t width, uint32_t height) noexcept {
+    m_viewportSize = glm::vec2(width, height);
+}
+
+void Scene::Update(float deltaTime) {
+    m_time += deltaTime;
     m_countTriangles = 0;
     for(const auto& [_, value]: m_index) {
         value->m_transformNodes.clear();
     }
-    UpdateGraph();
+
+    // only the nodes inside the view frustum are drawn
+    const auto frustum = m_camera->GetFrustum();
+    UpdateGraph(&frustum);
 }
 
 void Scene::Draw() {
+    BindFrameUniforms();
+
     uint32_t lastShaderId = 0;
     uint32_t lastGeometryId = 0;
     for(const auto& [key, value]: m_index) {
@@ -42,21 +55,48 @@ void Scene::Draw() {
             value->m_geometry->Bind();
             lastGeometryId = key.m_geometryId;
         }
+        if (value->m_transformNodes.empty()) {
+            continue;
+        }
+        if (value->m_material->IsInstanced()) {
+            value->m_material->BindUniforms();
+            m_countTriangles += value->DrawInstanced();
+            continue;
+        }
         for (const auto& transformNode: value->m_transformNodes) {
-            value->m_material->BindUniforms(m_camera, transformNode->GetTotalTransform(), transformNode->GetTotalNormalMatrix());
+            value->m_material->BindUniforms(transformNode->GetTotalTransform(), transformNode->GetTotalNormalMatrix());
             m_countTriangles += value->m_geometry->Draw();
         }
     }
 }
 
 void Scene::DrawWithMaterial(const std::shared_ptr<Material>& material) {
+    BindFrameUniforms();
+
     material->BindShader();
+    if (material->IsInstanced()) {
+        material->BindUniforms();
+    }
     for(const auto& [key, value]: m_index) {
+        if (value->m_transformNodes.empty()) {
+            continue;
+        }
+        value->m_geometry->Bind();
+        if (material->IsInstanced()) {
+            m_countTriangles += value->DrawInstanced();
+            continue;
+        }
         for (const auto& transformNode: value->m_transformNodes) {
-            material->BindUniforms(m_camera, transformNode->GetTotalTransform(), transformNode->GetTotalNormalMatrix());
-            value->m_geometry->Bind();
+            material->BindUniforms(transformNode->GetTotalTransform(), transformNode->GetTotalNormalMatrix());
             m_countTriangles += value->m_geometry->Draw();
-            value->m_geometry->Unbind();
         }
     }
 }
+
+void Scene::BindFrameUniforms() {
+    if (!m_frameUniforms) {
+        m_frameUniforms = std::make_unique<FrameUniforms>();
+    }
+    m_frameUniforms->Update(m_camera, m_time, m_viewportSize);
+    m_frameUniforms->Bind();
+}
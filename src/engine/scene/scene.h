@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <glm/vec2.hpp>
 #include "engine/scene/material_node.h"
 #include "engine/scene/transform_graph.h"
 
@@ -8,14 +9,17 @@
 class Camera;
 class Material;
 class GeometryNode;
+class FrameUniforms;
 class Scene : Noncopyable, public TransformGraph {
 public:
     Scene();
-    ~Scene() = default;
+    ~Scene();
 
     std::shared_ptr<MaterialNode> CreateMaterialNode(const std::shared_ptr<Material>& material, const std::shared_ptr<GeometryNode>& geometry);
 
-    void Update();
+    // the size of the framebuffer for the FrameData block, in pixels
+    void SetViewportSize(uint32_t width, uint32_t height) noexcept;
+    void Update(float deltaTime);
     void Draw();
     void DrawWithMaterial(const std::shared_ptr<Material>& material);
 
@@ -25,8 +29,16 @@ public:
     std::shared_ptr<Camera> GetCamera() const noexcept {
         return m_camera;
     }
+private:
+    void BindFrameUniforms();
+
 private:
     uint32_t m_countTriangles = 0;
+    // the time from the first update, in seconds
+    float m_time = 0;
+    glm::vec2 m_viewportSize = glm::vec2(0);
     std::shared_ptr<Camera> m_camera;
+    // created on the first draw, when the GL context exists
+    std::unique_ptr<FrameUniforms> m_frameUniforms;
     std::map<IndexKey, std::shared_ptr<MaterialNode>> m_index;
 };
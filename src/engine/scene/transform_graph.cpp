@@ -3,6 +3,7 @@
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include "engine/scene/material_node.h"
+#include "engine/scene/geometry_node.h"
 // #include "engine/physics/physical_node.h"
 
 TransformNode::TransformNode(const glm::mat4& transform)
@@ -69,26 +70,41 @@ void TransformNode::SetTransform(const glm::mat4& transform) {
     m_baseTransform = transform;
 }
 
-void TransformNode::Update() {
-    if (m_isDirty) {
+void TransformNode::Update(const math::Frustum* frustum, bool isParentChanged) {
+    auto matNode = m_materialNode.lock();
+    const bool isChanged = (m_isDirty || isParentChanged);
+    if (isChanged) {
+        // the node without a parent (the root of the graph) has the identity parent transform
         if (auto parent = m_parent.lock()) {
             m_totalTransform = parent->m_totalTransform * m_baseTransform;
-            m_totalNormalMatrix = glm::inverseTranspose(glm::mat3(m_totalTransform));
-            m_isDirty = false;
+        } else {
+            m_totalTransform = m_baseTransform;
+        }
+        m_totalNormalMatrix = glm::inverseTranspose(glm::mat3(m_totalTransform));
+        m_isDirty = false;
+
+        if (matNode) {
+            const auto& geometry = matNode->GetGeometry();
+            m_worldBox = geometry->GetBoundingBox().Transform(m_totalTransform);
+            m_worldSphere = geometry->GetBoundingSphere().Transform(m_totalTransform);
         }
     }
 
-    if (auto matNode = m_materialNode.lock()) {
-        matNode->AttachTransformNode(shared_from_this());
+    if (matNode) {
+        // the sphere test is cheaper and rejects most of the invisible nodes
+        const bool isVisible = (frustum == nullptr) || (frustum->IsVisible(m_worldSphere) && frustum->IsVisible(m_worldBox));
+        if (isVisible) {
+            matNode->AttachTransformNode(shared_from_this());
+        }
     }
 
     for (auto& node : m_children) {
-        node->Update();
+        node->Update(frustum, isChanged);
     }
 }
 
 TransformGraph::TransformGraph()
-    : m_root(std::make_shared<TransformNode>(glm::mat4(1), std::make_shared<TransformNode>())) {
+    : m_root(std::make_shared<TransformNode>(glm::mat4(1))) {
 
 }
 
@@ -104,6 +120,6 @@ void TransformGraph::AddChild(const std::shared_ptr<TransformNode>& node) {
     m_root->AddChild(node);
 }
 
-void TransformGraph::UpdateGraph() {
-    m_root->Update();
+void TransformGraph::UpdateGraph(const math::Frustum* frustum) {
+    m_root->Update(frustum, false);
 }
@@ -4,6 +4,7 @@
 #include <vector>
 #include <glm/mat4x4.hpp>
 
+#include "engine/common/bounds.h"
 #include "engine/common/noncopyable.h"
 
 
@@ -28,8 +29,13 @@ public:
     const glm::mat4& GetBaseTransform() const noexcept { return m_baseTransform; }
     const glm::mat4& GetTotalTransform() const noexcept { return m_totalTransform; }
     const glm::mat3& GetTotalNormalMatrix() const noexcept { return m_totalNormalMatrix; }
+    // The bounds of the geometry of the material node in the world coordinates, empty without the material node
+    const math::AABB& GetWorldBoundingBox() const noexcept { return m_worldBox; }
+    const math::BoundingSphere& GetWorldBoundingSphere() const noexcept { return m_worldSphere; }
 
-    void Update();
+    // frustum - if not null, the node is attached to the material node only if its bounds are inside the frustum
+    // isParentChanged - the total transform of the parent is changed since the last update
+    void Update(const math::Frustum* frustum, bool isParentChanged);
 
 private:
     std::weak_ptr<TransformNode> m_parent;
@@ -39,6 +45,8 @@ private:
     glm::mat4 m_baseTransform = glm::mat4(1);
     glm::mat4 m_totalTransform = glm::mat4(1);
     glm::mat3 m_totalNormalMatrix = glm::mat3(1);
+    math::AABB m_worldBox;
+    math::BoundingSphere m_worldSphere;
     // std::shared_ptr<PhysicalNode> m_physicalNode = nullptr;
 };
 
@@ -51,7 +59,8 @@ public:
     std::shared_ptr<TransformNode> NewChild(const std::shared_ptr<MaterialNode>& materialNode, const glm::mat4& transform = glm::mat4(1));
     void AddChild(const std::shared_ptr<TransformNode>& node);
 
-    void UpdateGraph();
+    // frustum - if not null, only the visible nodes are attached to the material nodes
+    void UpdateGraph(const math::Frustum* frustum = nullptr);
 private:
     std::shared_ptr<TransformNode> m_root = nullptr;
 };
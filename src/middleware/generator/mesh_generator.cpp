@@ -59,9 +59,9 @@ std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidCube() {
         vb[i+16].Normal = glm::vec3(0.0f, zn,   0.0f);
     }
 
-// 	CAABB box;
+    math::AABB box;
     for(int i=0; i<24; ++i)	{
-// 		box.Add(LockVB[i].Position);
+        box.Add(vb[i].Position);
         vb[i].Tangent = glm::vec3(0.0f,1.0f,0.0f);
     }
     VertexBuffer vertexBuffer(vb, sizeof(vb));
@@ -74,14 +74,14 @@ std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidCube() {
     }
     IndexBuffer indexBuffer(ib, sizeof(ib));
 
-    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer);
+    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer, box);
 }
 
 std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidSphere(uint16_t cntVertexCircle) {
     cntVertexCircle = glm::min(cntVertexCircle, uint16_t(363));
     uint16_t plg = cntVertexCircle/2 - 1;
 
-    // CAABB box;
+    math::AABB box;
     float B = -glm::half_pi<float>();
     float stepB = glm::pi<float>() / float(plg + 1);
     float stepA = glm::two_pi<float>() / float(cntVertexCircle - 1);
@@ -104,7 +104,7 @@ std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidSphere(uint16_t cntVerte
             vb[ind].TexCoord = glm::vec2(A / glm::two_pi<float>(), tv);
             vb[ind].Normal   = glm::normalize(vb[ind].Position);
             vb[ind].Tangent  = glm::vec3(0.0f, 1.0f, 0.0f);
-            // box.Add(vb[ind].Position);
+            box.Add(vb[ind].Position);
             ind++;
             A+=stepA;
         }
@@ -112,8 +112,8 @@ std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidSphere(uint16_t cntVerte
 
     vb[0]			= VertexPNTC{glm::vec3(0.0f,-0.5f,0.0f), glm::vec3(0.0f,-1.0f,0.0f), glm::vec3(0.0f,1.0f,0.0f), glm::vec2(0.5f,1.0f)};
     vb[vertexCnt-1]	= VertexPNTC{glm::vec3(0.0f, 0.5f,0.0f), glm::vec3(0.0f, 1.0f,0.0f), glm::vec3(0.0f,1.0f,0.0f), glm::vec2(0.5f,0.0f)};
-    // box.Add(vb[0].Position);
-    // box.Add(vb[VertexCnt-1].Position);
+    box.Add(vb[0].Position);
+    box.Add(vb[vertexCnt-1].Position);
 
 
     ind=0;
@@ -143,7 +143,7 @@ std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidSphere(uint16_t cntVerte
     IndexBuffer indexBuffer(ib, indexCnt * sizeof(*ib));
     delete []ib;
 
-    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer);
+    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer, box);
 }
 
 std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidCylinder(uint16_t cntVertexCircle) {
@@ -182,10 +182,10 @@ std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidCylinder(uint16_t cntVer
 		vb[i+cntVertexCircle*3].Normal		= glm::vec3(0, 1, 0);
 		vb[i+cntVertexCircle*3].TexCoord	= tex;
 	}
-	// CAABB box;
+	math::AABB box;
 	for(uint32_t i=0; i!=vertexCnt; ++i) {
 		vb[i].Tangent	= glm::vec3(0.0f,1.0f,0.0f);
-		// box.Add(vb[i].Position);
+		box.Add(vb[i].Position);
 	}
 
 	uint32_t num = 0;
@@ -228,12 +228,12 @@ std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidCylinder(uint16_t cntVer
     IndexBuffer indexBuffer(ib, indexCnt * sizeof(*ib));
     delete []ib;
 
-    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer);
+    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer, box);
 }
 
 template<class T>
 std::shared_ptr<GeometryNode> CreateSolidPlane(uint32_t cntXSides, uint32_t cntZSides, float scaleTextureX, float scaleTextureZ) {
-    // CAABB box;
+    math::AABB box;
     uint32_t ind = 0;
     uint32_t vertexCnt = (cntXSides+1)*(cntZSides+1);
     auto* vb = new VertexPNTC[vertexCnt];
@@ -245,7 +245,7 @@ std::shared_ptr<GeometryNode> CreateSolidPlane(uint32_t cntXSides, uint32_t cntZ
             vb[ind].Normal		= glm::vec3(0.0f,    1.0f, 0.0f);
             vb[ind].Tangent		= glm::vec3(0.0f,    1.0f, 0.0f);
             vb[ind].TexCoord	= glm::vec2(scaleTextureX*tu, scaleTextureZ*tv);
-            // box.Add(vb[ind].Position);
+            box.Add(vb[ind].Position);
             ++ind;
         }
     }
@@ -274,7 +274,7 @@ std::shared_ptr<GeometryNode> CreateSolidPlane(uint32_t cntXSides, uint32_t cntZ
     IndexBuffer indexBuffer(ib, indexCnt * sizeof(T));
     delete []ib;
 
-    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer);
+    return std::make_shared<GeometryNode>(VertexPNTC::vDecl, vertexBuffer, indexBuffer, box);
 }
 
 std::shared_ptr<GeometryNode> MeshGenerator::CreateSolidPlane(uint32_t cntXSides, uint32_t cntZSides, float scaleTextureX, float scaleTextureZ) {
@@ -1,5 +1,6 @@
 #include "middleware/node_editor/base_editor_node.h"
 
+#include <unordered_set>
 #include <imgui_node_editor.h>
 #include <imgui_internal.h>
 
@@ -9,6 +10,9 @@
 
 namespace ne = ax::NodeEditor;
 
+// the last generation of the nodes, main thread only
+static uint64_t LastGeneration = 0;
+
 BasePin::BasePin(PinType pinType, uint32_t userIndex, math::Color color)
     : m_pinType(pinType)
     , m_userIndex(userIndex)
@@ -31,7 +35,8 @@ void BasePin::Draw(uint8_t alpha) const {
 }
 
 BaseNode::BaseNode(const std::string& name)
-    : m_name(name) {
+    : m_name(name)
+    , m_generation(++LastGeneration) {
 
 }
 
@@ -53,13 +58,13 @@ BaseNode::~BaseNode() {
 void BaseNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
     dstPin->AddLink();
     m_LinkedSrcNodes.insert(srcNode);
-    CheckIsFull();
+    SetNeedUpdate();
 }
 
 void BaseNode::DelSourceNode(BaseNode* srcNode, BasePin* dstPin) {
     dstPin->DelLink();
     m_LinkedSrcNodes.erase(srcNode);
-    CheckIsFull();
+    SetNeedUpdate();
 }
 
 void BaseNode::AddDestNode(BaseNode* dstNode, BasePin* srcPin) {
@@ -72,6 +77,47 @@ void BaseNode::DelDestNode(BaseNode* dstNode, BasePin* srcPin) {
     m_LinkedDstNodes.erase(dstNode);
 }
 
+bool BaseNode::IsDependOn(const BaseNode* node) const {
+    // depth first, a node shared by several paths is visited once
+    std::unordered_set<const BaseNode*> visited = {this};
+    std::vector<const BaseNode*> stack = {this};
+    while (!stack.empty()) {
+        const auto* current = stack.back();
+        stack.pop_back();
+        if (current == node) {
+            return true;
+        }
+
+        for (const auto* srcNode: current->m_LinkedSrcNodes) {
+            if (visited.insert(srcNode).second) {
+                stack.push_back(srcNode);
+            }
+        }
+    }
+
+    return false;
+}
+
+BasePin* BaseNode::GetInPin(uint32_t userIndex) const noexcept {
+    for (auto* pin: m_inPins) {
+        if (pin->GetUserIndex() == userIndex) {
+            return pin;
+        }
+    }
+
+    return nullptr;
+}
+
+BasePin* BaseNode::GetOutPin(uint32_t userIndex) const noexcept {
+    for (auto* pin: m_outPins) {
+        if (pin->GetUserIndex() == userIndex) {
+            return pin;
+        }
+    }
+
+    return nullptr;
+}
+
 void BaseNode::Draw() {
     auto alpha = static_cast<uint8_t>(ImGui::GetStyle().Alpha * 255.0f);
     ne::NodeId id(this);
@@ -88,11 +134,6 @@ void BaseNode::Draw() {
         }
         ImGui::EndGroup();
 
-        if (m_needUpdate && m_isFull) {
-            Update();
-        }
-        m_needUpdate = false;
-
         ImGui::SameLine();
         ImGui::BeginGroup();
         if (m_isFull) {
@@ -126,46 +167,15 @@ void BaseNode::AddOutPin(BasePin* pin) {
 }
 
 void BaseNode::SetNeedUpdate() noexcept {
-    if (m_needUpdate) {
-        return;
-    }
-    m_needUpdate = true;
-    for (auto& node: m_LinkedDstNodes) {
-        node->SetNeedUpdate();
-    }
+    m_generation = ++LastGeneration;
 }
 
-void BaseNode::CheckIsFull() noexcept {
-    bool isFull = true;
-    for(const auto& pin :m_inPins) {
+bool BaseNode::IsAllInPinsConnected() const noexcept {
+    for (const auto* pin: m_inPins) {
         if (!pin->IsConnected()) {
-            isFull = false;
-            break;
+            return false;
         }
     }
 
-    if (isFull) {
-        for(const auto& node : m_LinkedSrcNodes) {
-            if (!node->GetIsFull()) {
-                isFull = false;
-                break;
-            }
-        }
-    }
-
-    if (isFull) {
-        SetNeedUpdate();
-    }
-
-    SetIsFull(isFull);
-}
-
-void BaseNode::SetIsFull(bool value) noexcept {
-    if (m_isFull == value) {
-        return;
-    }
-    m_isFull = value;
-    for (auto& node: m_LinkedDstNodes) {
-        node->CheckIsFull();
-    }
+    return true;
 }
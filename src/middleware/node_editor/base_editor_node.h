@@ -42,22 +42,55 @@ protected:
     BaseNode* m_node = nullptr;
 };
 
+class NodeScheduler;
+class NodeFactory;
+class GraphFile;
+class ParamsReader;
+class ParamsWriter;
 class BaseNode : Noncopyable {
+    friend class NodeScheduler;
+    // LoadParams is followed by SetNeedUpdate
+    friend class NodeFactory;
+    friend class GraphFile;
 protected:
     BaseNode() = delete;
     BaseNode(const std::string& name);
     virtual ~BaseNode();
 
 public:
+    const std::string& GetName() const noexcept { return m_name; }
+
     // srcNode -> this (dstPin)
     virtual void SetSourceNode(BaseNode* srcNode, BasePin* dstPin);
     // srcNode -> this (dstPin)
-    void DelSourceNode(BaseNode* srcNode, BasePin* dstPin);
+    virtual void DelSourceNode(BaseNode* srcNode, BasePin* dstPin);
     // this (srcPin) -> dstNode
     void AddDestNode(BaseNode* dstNode, BasePin* srcPin);
     // this (srcPin) -> dstNode
     void DelDestNode(BaseNode* dstNode, BasePin* srcPin);
-
+    // Returns true if node is this node or some node linked to the inputs of this node (directly or not)
+    bool IsDependOn(const BaseNode* node) const;
+    // Every change of the parameters of the node gives it a new generation, greater than the generations of all nodes,
+    // see SetNeedUpdate. Should not be called during a change of the node
+    uint64_t GetGeneration() const noexcept { return m_generation; }
+    // Returns nullptr if there is no pin with the user index
+    BasePin* GetInPin(uint32_t userIndex) const noexcept;
+    BasePin* GetOutPin(uint32_t userIndex) const noexcept;
+
+    // Writes all parameters of the node, see NodeEditorStorage::Save
+    virtual void SaveParams(ParamsWriter& /* writer */) const {}
+    // Reads the parameters in the order of SaveParams, throws EngineError if they are wrong
+    virtual void LoadParams(ParamsReader& /* reader */) {}
+
+    // Called after any link of the graph is added or deleted
+    virtual void OnGraphChanged() {}
+    // Called before any link of the graph is added or deleted and before the graph is destroyed:
+    // the background work that reads other nodes should be stopped,
+    // CancelBackgroundWork requests the stop for all nodes first, then WaitBackgroundWork waits for it
+    virtual void CancelBackgroundWork() {}
+    virtual void WaitBackgroundWork() {}
+
+    // Starts the evaluation of the node, called by NodeScheduler
     virtual void Update() = 0;
     void Draw();
 
@@ -65,11 +98,14 @@ protected:
     void AddInPin(BasePin* pin);
     void AddOutPin(BasePin* pin);
 
+    // The node will be evaluated again with all nodes that depend on it, see NodeScheduler
     void SetNeedUpdate() noexcept;
 
-    void CheckIsFull() noexcept;
-    void SetIsFull(bool value) noexcept;
+    // Updated by NodeScheduler: all input pins of the node and of its sources are connected
+    void SetIsFull(bool value) noexcept { m_isFull = value; }
     bool GetIsFull() const noexcept { return m_isFull; }
+    // Returns true if all input pins of the node are connected
+    bool IsAllInPinsConnected() const noexcept;
 
     virtual bool DrawSettings() = 0;
     virtual void DrawPreview() = 0;
@@ -82,7 +118,8 @@ private:
     std::set<BaseNode*> m_LinkedDstNodes;
     // m_LinkedSrcNodes -> this
     std::set<BaseNode*> m_LinkedSrcNodes;
-    bool m_needUpdate = true;
+    // incremented on every change of the node, main thread only
+    uint64_t m_generation = 0;
     bool m_isFull = true;
     bool m_drawSettings = false;
 };
@@ -1,10 +1,39 @@
 #include "middleware/node_editor/noise_3d.h"
 
+#include <cmath>
+#include <algorithm>
+
 #include "engine/gui/widgets.h"
+#include "engine/common/exception.h"
+#include "engine/common/hash_combine.h"
+#include "middleware/node_editor/graph_file.h"
+#include "middleware/node_editor/noise_kernels.h"
 
 
 static const char* QualityItems[] = {"Fast", "Std", "Best"};
 
+static void ReadFractalParams(ParamsReader& reader, noise::NoiseQuality& quality, double& frequency, double& lacunarity, int& octaveCount, int maxOctaveCount) {
+    // the enum is written with its underlying type, int for the unscoped enum of libnoise
+    int qualityValue = 0;
+    reader.Read(qualityValue);
+    reader.Read(frequency);
+    reader.Read(lacunarity);
+    reader.Read(octaveCount);
+    if ((qualityValue < noise::NoiseQuality::QUALITY_FAST) || (qualityValue > noise::NoiseQuality::QUALITY_BEST)) {
+        throw EngineError("wrong noise quality {}", qualityValue);
+    }
+    if ((octaveCount < 1) || (octaveCount > maxOctaveCount)) {
+        throw EngineError("wrong octave count {}, max value is {}", octaveCount, maxOctaveCount);
+    }
+    quality = static_cast<noise::NoiseQuality>(qualityValue);
+}
+
+// Covers the rounding errors of the sums of the octaves
+static NoiseRange Widen(double lower, double upper) {
+    constexpr const double epsilon = 1e-9;
+    return NoiseRange{lower - epsilon * std::max(1.0, std::fabs(lower)), upper + epsilon * std::max(1.0, std::fabs(upper))};
+}
+
 BillowNode::BillowNode()
     : BaseNoise3DNode(this, "Billow") {
 }
@@ -22,10 +51,98 @@ bool BillowNode::OnDrawSettings() {
     return changed;
 }
 
+void BillowNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_noiseQuality);
+    hash_combine(hash, m_frequency);
+    hash_combine(hash, m_lacunarity);
+    hash_combine(hash, m_octaveCount);
+    hash_combine(hash, m_persistence);
+    hash_combine(hash, m_seed);
+}
+
+void BillowNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_noiseQuality);
+    writer.Write(m_frequency);
+    writer.Write(m_lacunarity);
+    writer.Write(m_octaveCount);
+    writer.Write(m_persistence);
+    writer.Write(m_seed);
+}
+
+void BillowNode::LoadParams(ParamsReader& reader) {
+    ReadFractalParams(reader, m_noiseQuality, m_frequency, m_lacunarity, m_octaveCount, noise::module::BILLOW_MAX_OCTAVE);
+    reader.Read(m_persistence);
+    reader.Read(m_seed);
+}
+
+void BillowNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    kernel::FractalParams params;
+    params.frequency = m_frequency;
+    params.lacunarity = m_lacunarity;
+    params.persistence = m_persistence;
+    params.octaveCount = m_octaveCount;
+    params.seed = m_seed;
+    params.quality = m_noiseQuality;
+    kernel::CullOctaves(params, points.spacing);
+    if (kernel::Billow(params, points, out)) {
+        return;
+    }
+
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::module::Billow::GetValue(points.x[i], points.y[i], points.z[i]);
+    }
+}
+
+void BillowNode::OnGetGradients(const NoisePoints& points, const double* const* /* sources */, const NoiseGradients* /* sourceGradients */,
+    double* out, const NoiseGradients& gradients) const {
+    kernel::FractalParams params;
+    params.frequency = m_frequency;
+    params.lacunarity = m_lacunarity;
+    params.persistence = m_persistence;
+    params.octaveCount = m_octaveCount;
+    params.seed = m_seed;
+    params.quality = m_noiseQuality;
+    kernel::CullOctaves(params, points.spacing);
+    kernel::BillowGradients(params, points, out, gradients);
+}
+
+NoiseRange BillowNode::OnGetRange(const NoiseRange* /* sources */) const {
+    // every octave is 2 * |noise| - 1 multiplied by persistence ^ octave, 0.5 is added to the sum
+    const double octaveUpper = 2.0 * kernel::GetGradientNoiseBound() - 1.0;
+    double lower = 0.5;
+    double upper = 0.5;
+    double persistence = 1.0;
+    for (int i=0; i!=m_octaveCount; ++i) {
+        lower += std::min(-persistence, octaveUpper * persistence);
+        upper += std::max(-persistence, octaveUpper * persistence);
+        persistence *= m_persistence;
+    }
+
+    return Widen(lower, upper);
+}
+
+double BillowNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* /* errors */) const {
+    kernel::FractalParams params;
+    params.persistence = m_persistence;
+    params.octaveCount = m_octaveCount;
+    params.quality = m_noiseQuality;
+    return kernel::GetBillowSingleError(params);
+}
+
 CheckerboardNode::CheckerboardNode()
     : BaseNoise3DNode(this, "Checkerboard") {
 }
 
+void CheckerboardNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::module::Checkerboard::GetValue(points.x[i], points.y[i], points.z[i]);
+    }
+}
+
+NoiseRange CheckerboardNode::OnGetRange(const NoiseRange* /* sources */) const {
+    return NoiseRange{-1.0, 1.0};
+}
+
 ConstNode::ConstNode()
     : BaseNoise3DNode(this, "Const") {
 }
@@ -38,6 +155,34 @@ bool ConstNode::OnDrawSettings() {
     return changed;
 }
 
+void ConstNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_constValue);
+}
+
+void ConstNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_constValue);
+}
+
+void ConstNode::LoadParams(ParamsReader& reader) {
+    reader.Read(m_constValue);
+}
+
+void ConstNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    std::fill(out, out + points.count, m_constValue);
+}
+
+void ConstNode::OnGetGradients(const NoisePoints& points, const double* const* /* sources */, const NoiseGradients* /* sourceGradients */,
+    double* out, const NoiseGradients& gradients) const {
+    std::fill(out, out + points.count, m_constValue);
+    std::fill(gradients.x, gradients.x + points.count, 0.0);
+    std::fill(gradients.y, gradients.y + points.count, 0.0);
+    std::fill(gradients.z, gradients.z + points.count, 0.0);
+}
+
+NoiseRange ConstNode::OnGetRange(const NoiseRange* /* sources */) const {
+    return NoiseRange{m_constValue, m_constValue};
+}
+
 CylindersNode::CylindersNode()
     : BaseNoise3DNode(this, "Cylinders") {
 }
@@ -50,6 +195,29 @@ bool CylindersNode::OnDrawSettings() {
     return changed;
 }
 
+void CylindersNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_frequency);
+}
+
+void CylindersNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_frequency);
+}
+
+void CylindersNode::LoadParams(ParamsReader& reader) {
+    reader.Read(m_frequency);
+}
+
+void CylindersNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::module::Cylinders::GetValue(points.x[i], points.y[i], points.z[i]);
+    }
+}
+
+NoiseRange CylindersNode::OnGetRange(const NoiseRange* /* sources */) const {
+    // 1 - 4 * distance to the nearest cylinder, the distance is within [0, 0.5]
+    return NoiseRange{-1.0, 1.0};
+}
+
 PerlinNode::PerlinNode()
     : BaseNoise3DNode(this, "Perlin") {
 }
@@ -67,6 +235,82 @@ bool PerlinNode::OnDrawSettings() {
     return changed;
 }
 
+void PerlinNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_noiseQuality);
+    hash_combine(hash, m_frequency);
+    hash_combine(hash, m_lacunarity);
+    hash_combine(hash, m_octaveCount);
+    hash_combine(hash, m_persistence);
+    hash_combine(hash, m_seed);
+}
+
+void PerlinNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_noiseQuality);
+    writer.Write(m_frequency);
+    writer.Write(m_lacunarity);
+    writer.Write(m_octaveCount);
+    writer.Write(m_persistence);
+    writer.Write(m_seed);
+}
+
+void PerlinNode::LoadParams(ParamsReader& reader) {
+    ReadFractalParams(reader, m_noiseQuality, m_frequency, m_lacunarity, m_octaveCount, noise::module::PERLIN_MAX_OCTAVE);
+    reader.Read(m_persistence);
+    reader.Read(m_seed);
+}
+
+void PerlinNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    kernel::FractalParams params;
+    params.frequency = m_frequency;
+    params.lacunarity = m_lacunarity;
+    params.persistence = m_persistence;
+    params.octaveCount = m_octaveCount;
+    params.seed = m_seed;
+    params.quality = m_noiseQuality;
+    kernel::CullOctaves(params, points.spacing);
+    if (kernel::Perlin(params, points, out)) {
+        return;
+    }
+
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::module::Perlin::GetValue(points.x[i], points.y[i], points.z[i]);
+    }
+}
+
+void PerlinNode::OnGetGradients(const NoisePoints& points, const double* const* /* sources */, const NoiseGradients* /* sourceGradients */,
+    double* out, const NoiseGradients& gradients) const {
+    kernel::FractalParams params;
+    params.frequency = m_frequency;
+    params.lacunarity = m_lacunarity;
+    params.persistence = m_persistence;
+    params.octaveCount = m_octaveCount;
+    params.seed = m_seed;
+    params.quality = m_noiseQuality;
+    kernel::CullOctaves(params, points.spacing);
+    kernel::PerlinGradients(params, points, out, gradients);
+}
+
+NoiseRange PerlinNode::OnGetRange(const NoiseRange* /* sources */) const {
+    // every octave is noise multiplied by persistence ^ octave
+    double sum = 0;
+    double persistence = 1.0;
+    for (int i=0; i!=m_octaveCount; ++i) {
+        sum += std::fabs(persistence);
+        persistence *= m_persistence;
+    }
+    const double bound = kernel::GetGradientNoiseBound() * sum;
+
+    return Widen(-bound, bound);
+}
+
+double PerlinNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* /* errors */) const {
+    kernel::FractalParams params;
+    params.persistence = m_persistence;
+    params.octaveCount = m_octaveCount;
+    params.quality = m_noiseQuality;
+    return kernel::GetPerlinSingleError(params);
+}
+
 RidgedMultiNode::RidgedMultiNode()
     : BaseNoise3DNode(this, "RidgedMulti") {
 }
@@ -86,6 +330,80 @@ bool RidgedMultiNode::OnDrawSettings() {
     return changed;
 }
 
+void RidgedMultiNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_noiseQuality);
+    hash_combine(hash, m_frequency);
+    hash_combine(hash, m_lacunarity);
+    hash_combine(hash, m_octaveCount);
+    hash_combine(hash, m_seed);
+}
+
+void RidgedMultiNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_noiseQuality);
+    writer.Write(m_frequency);
+    writer.Write(m_lacunarity);
+    writer.Write(m_octaveCount);
+    writer.Write(m_seed);
+}
+
+void RidgedMultiNode::LoadParams(ParamsReader& reader) {
+    ReadFractalParams(reader, m_noiseQuality, m_frequency, m_lacunarity, m_octaveCount, noise::module::RIDGED_MAX_OCTAVE);
+    reader.Read(m_seed);
+    // recalculates the spectral weights
+    SetLacunarity(m_lacunarity);
+}
+
+void RidgedMultiNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    kernel::FractalParams params;
+    params.frequency = m_frequency;
+    params.lacunarity = m_lacunarity;
+    params.spectralWeights = m_pSpectralWeights;
+    params.octaveCount = m_octaveCount;
+    params.seed = m_seed;
+    params.quality = m_noiseQuality;
+    kernel::CullOctaves(params, points.spacing);
+    if (kernel::RidgedMulti(params, points, out)) {
+        return;
+    }
+
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::module::RidgedMulti::GetValue(points.x[i], points.y[i], points.z[i]);
+    }
+}
+
+void RidgedMultiNode::OnGetGradients(const NoisePoints& points, const double* const* /* sources */, const NoiseGradients* /* sourceGradients */,
+    double* out, const NoiseGradients& gradients) const {
+    kernel::FractalParams params;
+    params.frequency = m_frequency;
+    params.lacunarity = m_lacunarity;
+    params.spectralWeights = m_pSpectralWeights;
+    params.octaveCount = m_octaveCount;
+    params.seed = m_seed;
+    params.quality = m_noiseQuality;
+    kernel::CullOctaves(params, points.spacing);
+    kernel::RidgedMultiGradients(params, points, out, gradients);
+}
+
+NoiseRange RidgedMultiNode::OnGetRange(const NoiseRange* /* sources */) const {
+    // every octave is (1 - |noise|)^2 multiplied by the weight within [0, 1] and by the spectral weight,
+    // the sum is scaled by 1.25 and biased by -1
+    const double signalBound = std::max(1.0, std::pow(kernel::GetGradientNoiseBound() - 1.0, 2.0));
+    double sum = 0;
+    for (int i=0; i!=m_octaveCount; ++i) {
+        sum += signalBound * m_pSpectralWeights[i];
+    }
+
+    return Widen(-1.0, sum * 1.25 - 1.0);
+}
+
+double RidgedMultiNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* /* errors */) const {
+    kernel::FractalParams params;
+    params.spectralWeights = m_pSpectralWeights;
+    params.octaveCount = m_octaveCount;
+    params.quality = m_noiseQuality;
+    return kernel::GetRidgedMultiSingleError(params);
+}
+
 SpheresNode::SpheresNode()
     : BaseNoise3DNode(this, "Spheres") {
 }
@@ -98,6 +416,29 @@ bool SpheresNode::OnDrawSettings() {
     return changed;
 }
 
+void SpheresNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_frequency);
+}
+
+void SpheresNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_frequency);
+}
+
+void SpheresNode::LoadParams(ParamsReader& reader) {
+    reader.Read(m_frequency);
+}
+
+void SpheresNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::module::Spheres::GetValue(points.x[i], points.y[i], points.z[i]);
+    }
+}
+
+NoiseRange SpheresNode::OnGetRange(const NoiseRange* /* sources */) const {
+    // 1 - 4 * distance to the nearest sphere, the distance is within [0, 0.5]
+    return NoiseRange{-1.0, 1.0};
+}
+
 VoronoiNode::VoronoiNode()
     : BaseNoise3DNode(this, "Voronoi") {
 }
@@ -112,3 +453,51 @@ bool VoronoiNode::OnDrawSettings() {
 
     return changed;
 }
+
+void VoronoiNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_displacement);
+    hash_combine(hash, m_enableDistance);
+    hash_combine(hash, m_frequency);
+    hash_combine(hash, m_seed);
+}
+
+void VoronoiNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_displacement);
+    writer.Write(m_enableDistance);
+    writer.Write(m_frequency);
+    writer.Write(m_seed);
+}
+
+void VoronoiNode::LoadParams(ParamsReader& reader) {
+    // the bool is written as one byte, any other byte than 0 and 1 is not a valid bool
+    static_assert(sizeof(bool) == sizeof(uint8_t), "the bool parameter is written as one byte");
+    uint8_t enableDistance = 0;
+    reader.Read(m_displacement);
+    reader.Read(enableDistance);
+    reader.Read(m_frequency);
+    reader.Read(m_seed);
+    if (enableDistance > 1) {
+        throw EngineError("wrong value {} of the flag of the distance", enableDistance);
+    }
+    m_enableDistance = (enableDistance == 1);
+}
+
+void VoronoiNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    kernel::VoronoiParams params;
+    params.frequency = m_frequency;
+    params.displacement = m_displacement;
+    params.seed = m_seed;
+    params.enableDistance = m_enableDistance;
+    kernel::Voronoi(params, points, out);
+}
+
+NoiseRange VoronoiNode::OnGetRange(const NoiseRange* /* sources */) const {
+    // the distance to the nearest seed is within [0, sqrt(3)], it is scaled by sqrt(3) and biased by -1,
+    // the displacement is multiplied by the value noise within [-1, 1]
+    const double displacement = std::fabs(m_displacement);
+    if (m_enableDistance) {
+        return Widen(-1.0 - displacement, 2.0 + displacement);
+    }
+
+    return Widen(-displacement, displacement);
+}
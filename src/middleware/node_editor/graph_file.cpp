@@ -0,0 +1,290 @@
+#include "middleware/node_editor/graph_file.h"
+
+#include <cerrno>
+#include <fstream>
+#include <typeindex>
+#include <functional>
+#include <unordered_set>
+#include <unordered_map>
+
+#include "engine/common/mapped_file.h"
+#include "middleware/node_editor/noise_2d.h"
+#include "middleware/node_editor/noise_3d.h"
+#include "middleware/node_editor/node_render.h"
+
+
+namespace {
+
+struct NodeTypeInfo {
+    std::type_index typeIndex;
+    std::shared_ptr<BaseNode> (*create)();
+};
+
+template <typename T> NodeTypeInfo MakeInfo() {
+    return NodeTypeInfo{std::type_index(typeid(T)), []() -> std::shared_ptr<BaseNode> { return std::make_shared<T>(); }};
+}
+
+// index - type of the node in the file, new types are only appended
+const std::vector<NodeTypeInfo>& GetTypes() {
+    static const std::vector<NodeTypeInfo> types = {
+        MakeInfo<BillowNode>(),
+        MakeInfo<CheckerboardNode>(),
+        MakeInfo<ConstNode>(),
+        MakeInfo<CylindersNode>(),
+        MakeInfo<PerlinNode>(),
+        MakeInfo<RidgedMultiNode>(),
+        MakeInfo<SpheresNode>(),
+        MakeInfo<VoronoiNode>(),
+        MakeInfo<AbsNode>(),
+        MakeInfo<ClampNode>(),
+        MakeInfo<ExponentNode>(),
+        MakeInfo<InvertNode>(),
+        MakeInfo<ScaleBiasNode>(),
+        MakeInfo<AddNode>(),
+        MakeInfo<MaxNode>(),
+        MakeInfo<MinNode>(),
+        MakeInfo<MultiplyNode>(),
+        MakeInfo<PowerNode>(),
+        MakeInfo<SelectNode>(),
+        MakeInfo<PlaneNode>(),
+        MakeInfo<SphereNode>(),
+        MakeInfo<CylinderNode>(),
+        MakeInfo<RenderNode>(),
+    };
+
+    return types;
+}
+
+}
+
+std::shared_ptr<BaseNode> NodeFactory::Create(uint32_t type) {
+    const auto& types = GetTypes();
+    if (type >= types.size()) {
+        throw EngineError("unknown type {} of the node, max value is {}", type, types.size() - 1);
+    }
+
+    return types[type].create();
+}
+
+uint32_t NodeFactory::GetTypeCount() {
+    return static_cast<uint32_t>(GetTypes().size());
+}
+
+uint32_t NodeFactory::GetType(const BaseNode* node) {
+    static const auto index = []() {
+        std::unordered_map<std::type_index, uint32_t> result;
+        const auto& types = GetTypes();
+        for (size_t i=0; i!=types.size(); ++i) {
+            result.emplace(types[i].typeIndex, static_cast<uint32_t>(i));
+        }
+        return result;
+    }();
+
+    const auto it = index.find(std::type_index(typeid(*node)));
+    if (it == index.cend()) {
+        throw EngineError("the type '{}' of the node is not registered in NodeFactory", typeid(*node).name());
+    }
+
+    return it->second;
+}
+
+std::shared_ptr<BaseNode> NodeFactory::Clone(const BaseNode* node) {
+    auto result = Create(GetType(node));
+
+    ParamsWriter writer;
+    node->SaveParams(writer);
+    ParamsReader reader(writer.GetData().data(), writer.GetData().size());
+    result->LoadParams(reader);
+    reader.CheckEnd();
+    result->SetNeedUpdate();
+
+    return result;
+}
+
+std::shared_ptr<BaseNode> NodeFactory::CloneSubgraph(const BaseNode* root) {
+    auto nodes = std::make_shared<std::vector<std::shared_ptr<BaseNode>>>();
+    std::unordered_map<const BaseNode*, BaseNode*> copies;
+
+    // the sources are copied before the node, a node shared by several paths is copied once
+    std::function<BaseNode* (const BaseNode*)> copy = [&nodes, &copies, &copy](const BaseNode* node) -> BaseNode* {
+        if (const auto it = copies.find(node); it != copies.cend()) {
+            return it->second;
+        }
+
+        // user index of the input pin, source node
+        std::vector<std::pair<uint32_t, const BaseNode*>> sources;
+        if (const auto* noiseNode = dynamic_cast<const BaseNoise3DNode*>(node); noiseNode != nullptr) {
+            for (size_t i=0; i!=noiseNode->GetSourceCount(); ++i) {
+                sources.emplace_back(static_cast<uint32_t>(i), noiseNode->GetSourceNode(i));
+            }
+        } else if (const auto* shapeNode = dynamic_cast<const BaseNoise2DNode*>(node); shapeNode != nullptr) {
+            sources.emplace_back(0, shapeNode->GetSourceNode());
+        } else {
+            throw EngineError("the node '{}' can not be copied with its subgraph", node->GetName());
+        }
+
+        auto result = Clone(node);
+        for (const auto& [pin, srcNode]: sources) {
+            if (srcNode != nullptr) {
+                auto* srcCopy = copy(srcNode);
+                result->SetSourceNode(srcCopy, result->GetInPin(pin));
+                srcCopy->AddDestNode(result.get(), srcCopy->GetOutPin(0));
+            }
+        }
+
+        copies[node] = result.get();
+        nodes->push_back(result);
+        return result.get();
+    };
+
+    auto* rootCopy = copy(root);
+    for (const auto& node: *nodes) {
+        node->OnGraphChanged();
+    }
+
+    return std::shared_ptr<BaseNode>(nodes, rootCopy);
+}
+
+void GraphFile::Write(const std::filesystem::path& path, const GraphData& graph) {
+    std::unordered_map<const BaseNode*, uint32_t> nodeIndex;
+    std::vector<GraphFileNode> nodes;
+    nodes.reserve(graph.nodes.size());
+    ParamsWriter params;
+    for (size_t i=0; i!=graph.nodes.size(); ++i) {
+        const auto* node = graph.nodes[i].get();
+        nodeIndex[node] = static_cast<uint32_t>(i);
+
+        GraphFileNode record;
+        record.type = NodeFactory::GetType(node);
+        record.paramsOffset = static_cast<uint32_t>(params.GetData().size());
+        node->SaveParams(params);
+        record.paramsSize = static_cast<uint32_t>(params.GetData().size()) - record.paramsOffset;
+        if (i < graph.positions.size()) {
+            record.x = graph.positions[i].x;
+            record.y = graph.positions[i].y;
+        }
+        nodes.push_back(record);
+    }
+
+    std::vector<GraphFileLink> links;
+    links.reserve(graph.links.size());
+    for (const auto& [srcPin, dstPin] : graph.links) {
+        links.push_back(GraphFileLink{nodeIndex.at(srcPin->GetNode()), srcPin->GetUserIndex(), nodeIndex.at(dstPin->GetNode()), dstPin->GetUserIndex()});
+    }
+
+    GraphFileHeader header;
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.linkCount = static_cast<uint32_t>(links.size());
+    header.paramsSize = static_cast<uint32_t>(params.GetData().size());
+
+    std::ofstream ofs(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!ofs) {
+        throw EngineError("couldn't open file '{}', error: {}", path.string(), strerror(errno));
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(GraphFileNode)));
+    ofs.write(reinterpret_cast<const char*>(links.data()), static_cast<std::streamsize>(links.size() * sizeof(GraphFileLink)));
+    ofs.write(reinterpret_cast<const char*>(params.GetData().data()), static_cast<std::streamsize>(params.GetData().size()));
+    if (!ofs) {
+        throw EngineError("couldn't write file '{}', error: {}", path.string(), strerror(errno));
+    }
+}
+
+GraphData GraphFile::Read(const std::filesystem::path& path) {
+    MappedFile file(path);
+    const uint8_t* data = file.GetData();
+    const size_t size = file.GetSize();
+
+    GraphFileHeader header;
+    if (size < sizeof(header)) {
+        throw EngineError("the graph file '{}' is too small", path.string());
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != GraphFileHeader::Magic) {
+        throw EngineError("the file '{}' is not a graph file", path.string());
+    }
+    if (header.version != GraphFileHeader::Version) {
+        throw EngineError("unsupported version {} of the graph file '{}', expected version is {}", header.version, path.string(), GraphFileHeader::Version);
+    }
+
+    const size_t nodesOffset = sizeof(header);
+    const size_t linksOffset = nodesOffset + size_t(header.nodeCount) * sizeof(GraphFileNode);
+    const size_t paramsOffset = linksOffset + size_t(header.linkCount) * sizeof(GraphFileLink);
+    if (paramsOffset + header.paramsSize != size) {
+        throw EngineError("wrong size {} of the graph file '{}', expected size is {}", size, path.string(), paramsOffset + header.paramsSize);
+    }
+
+    // the records are copied, the mapped file has no alignment guarantees
+    std::vector<GraphFileNode> records(header.nodeCount);
+    std::memcpy(records.data(), data + nodesOffset, records.size() * sizeof(GraphFileNode));
+    std::vector<GraphFileLink> links(header.linkCount);
+    std::memcpy(links.data(), data + linksOffset, links.size() * sizeof(GraphFileLink));
+
+    std::vector<std::shared_ptr<BaseNode>> nodes;
+    nodes.reserve(records.size());
+    for (const auto& record: records) {
+        if ((record.paramsOffset > header.paramsSize) || (record.paramsSize > header.paramsSize - record.paramsOffset)) {
+            throw EngineError("wrong parameters of the node {} in the graph file '{}'", nodes.size(), path.string());
+        }
+
+        auto node = NodeFactory::Create(record.type);
+        ParamsReader reader(data + paramsOffset + record.paramsOffset, record.paramsSize);
+        node->LoadParams(reader);
+        reader.CheckEnd();
+        node->SetNeedUpdate();
+        nodes.push_back(node);
+    }
+
+    // all links are checked before the graph is changed
+    std::vector<std::pair<BasePin*, BasePin*>> pins;
+    pins.reserve(links.size());
+    std::unordered_set<const BasePin*> linkedPins;
+    std::vector<std::vector<uint32_t>> dstNodes(nodes.size());
+    std::vector<uint32_t> inDegree(nodes.size(), 0);
+    for (const auto& link: links) {
+        if ((link.srcNode >= nodes.size()) || (link.dstNode >= nodes.size()) || (link.srcNode == link.dstNode)) {
+            throw EngineError("wrong link {} -> {} in the graph file '{}'", link.srcNode, link.dstNode, path.string());
+        }
+
+        auto* srcPin = nodes[link.srcNode]->GetOutPin(link.srcPin);
+        auto* dstPin = nodes[link.dstNode]->GetInPin(link.dstPin);
+        if ((srcPin == nullptr) || (dstPin == nullptr) || (srcPin->GetPinType() != dstPin->GetPinType())) {
+            throw EngineError("wrong pins of the link {} -> {} in the graph file '{}'", link.srcNode, link.dstNode, path.string());
+        }
+        if (!linkedPins.insert(dstPin).second) {
+            throw EngineError("the input pin of the node {} is linked twice in the graph file '{}'", link.dstNode, path.string());
+        }
+
+        pins.emplace_back(srcPin, dstPin);
+        dstNodes[link.srcNode].push_back(link.dstNode);
+        inDegree[link.dstNode]++;
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(nodes.size());
+    for (uint32_t i=0; i!=nodes.size(); ++i) {
+        if (inDegree[i] == 0) {
+            order.push_back(i);
+        }
+    }
+    for (size_t i=0; i!=order.size(); ++i) {
+        for (const auto dst: dstNodes[order[i]]) {
+            if (--inDegree[dst] == 0) {
+                order.push_back(dst);
+            }
+        }
+    }
+    if (order.size() != nodes.size()) {
+        throw EngineError("the graph in the file '{}' contains a cycle", path.string());
+    }
+
+    GraphData graph;
+    graph.nodes = std::move(nodes);
+    graph.links = std::move(pins);
+    graph.positions.reserve(records.size());
+    for (const auto& record: records) {
+        graph.positions.emplace_back(record.x, record.y);
+    }
+
+    return graph;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <filesystem>
+#include <type_traits>
+
+#include "engine/common/math.h"
+#include "engine/common/exception.h"
+
+
+// Binary file of the node graph, all values are in the native byte order:
+//   GraphFileHeader
+//   GraphFileNode[nodeCount]
+//   GraphFileLink[linkCount]
+//   paramsSize bytes of the parameters of the nodes
+// The records have the fixed size and are read directly from the mapped file,
+// the links refer to the nodes by the index of the record and to the pins by the user index.
+struct GraphFileHeader {
+    // "RTGG"
+    static constexpr const uint32_t Magic = 0x47475452;
+    // incremented on every incompatible change of the format
+    static constexpr const uint32_t Version = 1;
+
+    uint32_t magic = Magic;
+    uint32_t version = Version;
+    uint32_t nodeCount = 0;
+    uint32_t linkCount = 0;
+    uint32_t paramsSize = 0;
+    uint32_t reserved = 0;
+};
+
+struct GraphFileNode {
+    // see NodeFactory
+    uint32_t type = 0;
+    // offset of the parameters from the begin of the parameters block
+    uint32_t paramsOffset = 0;
+    uint32_t paramsSize = 0;
+    // position of the node in the editor
+    float x = 0;
+    float y = 0;
+};
+
+struct GraphFileLink {
+    uint32_t srcNode = 0;
+    uint32_t srcPin = 0;
+    uint32_t dstNode = 0;
+    uint32_t dstPin = 0;
+};
+
+// Parameters of one node in the binary form
+class ParamsWriter {
+public:
+    ParamsWriter() = default;
+    ~ParamsWriter() = default;
+
+    template <typename T> void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "the parameter should be trivially copyable");
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void WriteBytes(const std::vector<uint8_t>& bytes) {
+        m_data.insert(m_data.end(), bytes.cbegin(), bytes.cend());
+    }
+
+    const std::vector<uint8_t>& GetData() const noexcept { return m_data; }
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
+// Reads the parameters written by ParamsWriter in the same order.
+// The bool and enum parameters should be read as the integers and checked by the caller,
+// not every byte is a valid value of them
+class ParamsReader {
+public:
+    ParamsReader() = delete;
+    ParamsReader(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_size(size) {}
+    ~ParamsReader() = default;
+
+    // Throws EngineError if the parameters are over or the floating point value is not finite
+    template <typename T> void Read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "the parameter should be trivially copyable");
+        static_assert((!std::is_same_v<T, bool>) && (!std::is_enum_v<T>), "the bool and enum parameters should be read as the integers");
+        if (m_size - m_offset < sizeof(T)) {
+            throw EngineError("unexpected end of the node parameters, offset = {}, size = {}", m_offset, m_size);
+        }
+        T result;
+        std::memcpy(&result, m_data + m_offset, sizeof(T));
+        if constexpr (std::is_floating_point_v<T>) {
+            if (!std::isfinite(result)) {
+                throw EngineError("not finite value of the node parameter, offset = {}", m_offset);
+            }
+        }
+        value = result;
+        m_offset += sizeof(T);
+    }
+
+    // Throws EngineError if not all parameters are read
+    void CheckEnd() const {
+        if (m_offset != m_size) {
+            throw EngineError("unexpected {} bytes after the node parameters", m_size - m_offset);
+        }
+    }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_offset = 0;
+};
+
+class BaseNode;
+// Creates the nodes by the type stored in GraphFileNode
+class NodeFactory {
+public:
+    // Throws EngineError if the type is unknown
+    static std::shared_ptr<BaseNode> Create(uint32_t type);
+    // The types are the numbers from 0 to GetTypeCount() - 1
+    static uint32_t GetTypeCount();
+    // Throws EngineError if the type of the node is not registered
+    static uint32_t GetType(const BaseNode* node);
+    // Creates the node of the same type with the same parameters, the copy is not linked
+    // Throws EngineError if the type of the node is not registered
+    static std::shared_ptr<BaseNode> Clone(const BaseNode* node);
+    // Copies the node and all nodes of its subgraph with the parameters and the links between them,
+    // the returned pointer owns all copies. The background jobs evaluate the copy,
+    // so the nodes of the editor can be changed or deleted while the jobs are running.
+    // Should be called on the main thread (see BaseNode::SetNeedUpdate)
+    // Throws EngineError if the subgraph contains other nodes than the noise nodes (BaseNoise2DNode, BaseNoise3DNode)
+    static std::shared_ptr<BaseNode> CloneSubgraph(const BaseNode* root);
+};
+
+class BasePin;
+// The graph stored in the file
+struct GraphData {
+    std::vector<std::shared_ptr<BaseNode>> nodes;
+    // position of every node in the editor
+    std::vector<math::Pointf> positions;
+    // srcPin -> dstPin, the pins belong to the nodes, the nodes are not linked by GraphFile::Read
+    std::vector<std::pair<BasePin*, BasePin*>> links;
+};
+
+class GraphFile {
+public:
+    // Throws EngineError
+    static void Write(const std::filesystem::path& path, const GraphData& graph);
+    // The file is mapped into the memory, the types and the parameters of the nodes,
+    // the pins of the links and the absence of cycles are checked
+    // Throws EngineError
+    static GraphData Read(const std::filesystem::path& path);
+};
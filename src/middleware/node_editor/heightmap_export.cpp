@@ -0,0 +1,117 @@
+#include "middleware/node_editor/heightmap_export.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "engine/common/exception.h"
+#include "engine/common/mapped_file.h"
+#include "engine/common/thread_pool.h"
+#include "middleware/node_editor/noise_2d.h"
+#include "middleware/node_editor/noiseutils.h"
+
+
+void HeightmapExport::SetSize(uint32_t width, uint32_t height) noexcept {
+    m_width = width;
+    m_height = height;
+}
+
+void HeightmapExport::SetBounds(double lowerUBound, double upperUBound, double lowerVBound, double upperVBound) noexcept {
+    m_lowerUBound = lowerUBound;
+    m_upperUBound = upperUBound;
+    m_lowerVBound = lowerVBound;
+    m_upperVBound = upperVBound;
+}
+
+void HeightmapExport::Export(const std::filesystem::path& path) const {
+    if (m_sourceModule == nullptr) {
+        throw EngineError("the source module of the heightmap '{}' is not set", path.string());
+    }
+    if ((m_width == 0) || (m_height == 0) || (m_tileSize == 0)) {
+        throw EngineError("wrong size {}x{} or tile size {} of the heightmap '{}'", m_width, m_height, m_tileSize, path.string());
+    }
+    // the negated comparisons reject NaN too
+    if ((!(m_lowerUBound < m_upperUBound)) || (!(m_lowerVBound < m_upperVBound))) {
+        throw EngineError("wrong bounds of the heightmap '{}'", path.string());
+    }
+
+    HeightmapFileHeader header;
+    header.format = m_format;
+    header.width = m_width;
+    header.height = m_height;
+
+    const size_t sampleSize = (m_format == HeightmapFileHeader::Format::R16) ? sizeof(uint16_t) : sizeof(float);
+    const size_t rowSize = static_cast<size_t>(m_width) * sampleSize;
+    MappedOutputFile file(path, sizeof(header) + rowSize * static_cast<size_t>(m_height));
+    std::memcpy(file.GetData(), &header, sizeof(header));
+    uint8_t* samples = file.GetData() + sizeof(header);
+
+    // the points are calculated as in NoiseMap, so the values of the tiles match the values of the whole map
+    const double uDelta = (m_upperUBound - m_lowerUBound) / static_cast<double>(m_width);
+    const double vDelta = (m_upperVBound - m_lowerVBound) / static_cast<double>(m_height);
+    // the tiles are counted in 64 bits, the sums and the product may not fit in uint32_t
+    const uint64_t tileCountX64 = (static_cast<uint64_t>(m_width) + m_tileSize - 1) / m_tileSize;
+    const uint64_t tileCountY64 = (static_cast<uint64_t>(m_height) + m_tileSize - 1) / m_tileSize;
+    const uint64_t tileCount64 = tileCountX64 * tileCountY64;
+    if (tileCount64 > std::numeric_limits<uint32_t>::max()) {
+        throw EngineError("too many tiles {} of the heightmap '{}', increase the tile size {}", tileCount64, path.string(), m_tileSize);
+    }
+    const auto tileCountX = static_cast<uint32_t>(tileCountX64);
+    const auto tileCount = static_cast<uint32_t>(tileCount64);
+
+    NoiseSampling sampling;
+    sampling.precision = m_precision;
+
+    auto& pool = ThreadPool::Get();
+    const uint32_t workerCount = (m_workerCount == 0) ? pool.GetThreadCount() : m_workerCount;
+    pool.ParallelFor(0, tileCount, 1, workerCount, [&](uint32_t begin, uint32_t end) {
+        const size_t maxCount = static_cast<size_t>(m_tileSize) * static_cast<size_t>(m_tileSize);
+        std::vector<double> u(maxCount);
+        std::vector<double> v(maxCount);
+        std::vector<double> values(maxCount);
+
+        for (uint32_t tile=begin; tile!=end; ++tile) {
+            const uint32_t x0 = (tile % tileCountX) * m_tileSize;
+            const uint32_t y0 = (tile / tileCountX) * m_tileSize;
+            const uint32_t width = std::min(m_tileSize, m_width - x0);
+            const uint32_t height = std::min(m_tileSize, m_height - y0);
+
+            size_t count = 0;
+            for (uint32_t y=y0; y!=y0 + height; ++y) {
+                const double vValue = m_lowerVBound + static_cast<double>(y) * vDelta;
+                for (uint32_t x=x0; x!=x0 + width; ++x) {
+                    u[count] = m_lowerUBound + static_cast<double>(x) * uDelta;
+                    v[count] = vValue;
+                    ++count;
+                }
+            }
+
+            for (size_t offset=0; offset < count; offset += noise::utils::NoiseMap::ChunkSize) {
+                const size_t chunkCount = std::min(noise::utils::NoiseMap::ChunkSize, count - offset);
+                m_sourceModule->GetValues(u.data() + offset, v.data() + offset, values.data() + offset, chunkCount, sampling);
+            }
+
+            const double* pSource = values.data();
+            for (uint32_t y=y0; y!=y0 + height; ++y, pSource += width) {
+                uint8_t* pRow = samples + static_cast<size_t>(m_height - 1 - y) * rowSize + static_cast<size_t>(x0) * sampleSize;
+                if (m_format == HeightmapFileHeader::Format::R16) {
+                    auto* pDest = reinterpret_cast<uint16_t*>(pRow);
+                    for (uint32_t x=0; x!=width; ++x) {
+                        // std::clamp passes NaN through and its cast to uint16_t is undefined
+                        const double value = std::isnan(pSource[x]) ? 0.0 : std::clamp((pSource[x] + 1.0) * 0.5, 0.0, 1.0);
+                        pDest[x] = static_cast<uint16_t>(value * 65535.0 + 0.5);
+                    }
+                } else {
+                    auto* pDest = reinterpret_cast<float*>(pRow);
+                    for (uint32_t x=0; x!=width; ++x) {
+                        pDest[x] = static_cast<float>(pSource[x]);
+                    }
+                }
+            }
+        }
+    });
+
+    file.Flush();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "middleware/node_editor/noise_3d.h"
+
+
+// Raw heightmap file, all values are in the native byte order:
+//   HeightmapFileHeader
+//   width * height samples, the rows are from the top (upper V bound) to the bottom
+// R16 - unsigned normalized samples, the noise value -1 is 0, 1 is 65535
+// R32F - the noise values
+struct HeightmapFileHeader {
+    // "RTGH"
+    static constexpr const uint32_t Magic = 0x48475452;
+    // incremented on every incompatible change of the format
+    static constexpr const uint32_t Version = 1;
+
+    enum class Format : uint32_t {
+        R16 = 0,
+        R32F = 1,
+    };
+
+    uint32_t magic = Magic;
+    uint32_t version = Version;
+    Format format = Format::R16;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t reserved = 0;
+};
+
+class BaseNoise2DNode;
+// Out-of-core export of the noise map of any size: the map is built tile by tile on the threads of ThreadPool,
+// every tile is written directly to the memory-mapped output file,
+// so the peak memory is bounded by worker count * tile size and does not depend on the size of the map.
+// The values are the same as the values of NoiseMap of the whole size, bounds and precision.
+class HeightmapExport {
+public:
+    static constexpr const uint32_t DefaultTileSize = 256;
+
+public:
+    HeightmapExport() = default;
+    ~HeightmapExport() = default;
+
+    void SetSourceModule(const BaseNoise2DNode* sourceModule) noexcept { m_sourceModule = sourceModule; }
+    void SetSize(uint32_t width, uint32_t height) noexcept;
+    void SetBounds(double lowerUBound, double upperUBound, double lowerVBound, double upperVBound) noexcept;
+    void SetFormat(HeightmapFileHeader::Format format) noexcept { m_format = format; }
+    // Size of the square tiles, in points
+    void SetTileSize(uint32_t tileSize) noexcept { m_tileSize = tileSize; }
+    // NoisePrecision::Double by default
+    void SetPrecision(NoisePrecision precision) noexcept { m_precision = precision; }
+    // 0 - all threads of ThreadPool
+    void SetWorkerCount(uint32_t workerCount) noexcept { m_workerCount = workerCount; }
+
+    // The subgraph of the source module should be full, the parameters of the nodes should not be changed during the export
+    // Throws EngineError
+    void Export(const std::filesystem::path& path) const;
+
+private:
+    const BaseNoise2DNode* m_sourceModule = nullptr;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    double m_lowerUBound = 0;
+    double m_upperUBound = 0;
+    double m_lowerVBound = 0;
+    double m_upperVBound = 0;
+    HeightmapFileHeader::Format m_format = HeightmapFileHeader::Format::R16;
+    uint32_t m_tileSize = DefaultTileSize;
+    uint32_t m_workerCount = 0;
+    NoisePrecision m_precision = NoisePrecision::Double;
+};
@@ -1,5 +1,6 @@
 #include "middleware/node_editor/node_editor.h"
 
+#include "engine/material/texture_manager.h"
 #include "middleware/node_editor/noise_2d.h"
 #include "middleware/node_editor/noise_3d.h"
 #include "middleware/node_editor/node_render.h"
@@ -8,8 +9,22 @@
 
 namespace ne = ax::NodeEditor;
 
+namespace {
+
+class PreviewDynamicTexture : public PreviewTexture {
+public:
+    void Update(const ImageView& view) override { m_texture.UpdateOrCreate(view); }
+    std::shared_ptr<Texture> GetTexture() override { return m_texture.GetTexture(); }
+
+private:
+    DynamicTexture m_texture;
+};
+
+}
+
 NodeEditor::NodeEditor(const std::string& name)
     : m_name(name) {
+    PreviewNode::SetTextureFactory([]() { return std::make_shared<PreviewDynamicTexture>(); });
     m_context = ne::CreateEditor();
     m_storage = std::make_shared<NodeEditorStorage>();
 }
@@ -25,6 +40,17 @@ NodeEditor::~NodeEditor() {
     }
 }
 
+void NodeEditor::Save(const std::filesystem::path& path) {
+    ne::SetCurrentEditor(m_context);
+    m_storage->Save(path);
+}
+
+void NodeEditor::Load(const std::filesystem::path& path) {
+    ne::SetCurrentEditor(m_context);
+    m_storage->Load(path);
+    m_viewNode.reset();
+}
+
 void NodeEditor::Draw() {
     ne::SetCurrentEditor(m_context);
     ne::Begin(m_name.c_str());
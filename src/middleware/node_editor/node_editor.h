@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <filesystem>
 
 #include "engine/common/noncopyable.h"
 
@@ -21,6 +22,10 @@ public:
 
     std::shared_ptr<BaseNode> GetViewNode() noexcept { return m_viewNode; }
 
+    // Saves and loads the graph with the layout, see NodeEditorStorage, throw EngineError
+    void Save(const std::filesystem::path& path);
+    void Load(const std::filesystem::path& path);
+
     void Draw();
 private:
     std::shared_ptr<BaseNode> EditorMenu();
@@ -1,15 +1,22 @@
 #include "middleware/node_editor/node_editor_storage.h"
 
+#include <algorithm>
+
+#include "middleware/node_editor/graph_file.h"
+
 
 namespace ne = ax::NodeEditor;
 
 NodeEditorStorage::~NodeEditorStorage() {
+    StopBackgroundWork();
     m_nodes.clear();
     m_links.clear();
 }
 
 void NodeEditorStorage::AddNode(const std::shared_ptr<BaseNode>& node) {
     m_nodes.push_back(node);
+    node->OnGraphChanged();
+    m_scheduler.OnGraphChanged(m_nodes);
 }
 
 bool NodeEditorStorage::AddLink(const ne::PinId pinIdFirst, const ne::PinId pinIdSecond, bool checkOnly) {
@@ -37,13 +44,20 @@ bool NodeEditorStorage::AddLink(const ne::PinId pinIdFirst, const ne::PinId pinI
         return false;
     }
 
+    // the link would create a cycle
+    if (srcNode->IsDependOn(dstNode)) {
+        return false;
+    }
+
     if (!checkOnly) {
+        StopBackgroundWork();
         dstNode->SetSourceNode(srcNode, dstPin);
         srcNode->AddDestNode(dstNode, srcPin);
 
         auto linkId = ne::LinkId(static_cast<uintptr_t>(m_nextId++));
         m_links[linkId] = LinkInfo{ne::PinId(srcPin), ne::PinId(dstPin)};
         ne::Link(linkId, ne::PinId(srcPin), ne::PinId(dstPin));
+        OnGraphChanged();
     }
 
     return true;
@@ -56,6 +70,7 @@ bool NodeEditorStorage::DelLink(const ne::LinkId linkId, bool checkOnly) {
     }
 
     if (!checkOnly) {
+        StopBackgroundWork();
         auto* srcPin = it->second.srcPin.AsPointer<BasePin>();
         auto* srcNode = srcPin->GetNode();
 
@@ -66,6 +81,7 @@ bool NodeEditorStorage::DelLink(const ne::LinkId linkId, bool checkOnly) {
         srcNode->DelDestNode(dstNode, srcPin);
 
         m_links.erase(it);
+        OnGraphChanged();
     }
 
     return true;
@@ -85,7 +101,68 @@ std::shared_ptr<BaseNode> NodeEditorStorage::GetNode(const ne::NodeId nodeId) {
     return std::shared_ptr<BaseNode>();
 }
 
+void NodeEditorStorage::Save(const std::filesystem::path& path) const {
+    GraphData graph;
+    graph.nodes = m_nodes;
+    graph.positions.reserve(m_nodes.size());
+    for (const auto& node: m_nodes) {
+        const auto position = ne::GetNodePosition(ne::NodeId(node.get()));
+        graph.positions.emplace_back(position.x, position.y);
+    }
+
+    // in the order of the creation
+    std::vector<std::pair<uintptr_t, LinkInfo>> sortedLinks(m_links.cbegin(), m_links.cend());
+    std::sort(sortedLinks.begin(), sortedLinks.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    graph.links.reserve(sortedLinks.size());
+    for (const auto& [id, info] : sortedLinks) {
+        graph.links.emplace_back(info.srcPin.AsPointer<BasePin>(), info.dstPin.AsPointer<BasePin>());
+    }
+
+    GraphFile::Write(path, graph);
+}
+
+void NodeEditorStorage::Load(const std::filesystem::path& path) {
+    auto graph = GraphFile::Read(path);
+
+    StopBackgroundWork();
+    m_links.clear();
+    m_nodes = std::move(graph.nodes);
+
+    // the links only connect the nodes, the nodes are prepared for the new graph once at the end
+    for (const auto& [srcPin, dstPin] : graph.links) {
+        dstPin->GetNode()->SetSourceNode(srcPin->GetNode(), dstPin);
+        srcPin->GetNode()->AddDestNode(dstPin->GetNode(), srcPin);
+
+        auto linkId = ne::LinkId(static_cast<uintptr_t>(m_nextId++));
+        m_links[linkId] = LinkInfo{ne::PinId(srcPin), ne::PinId(dstPin)};
+    }
+
+    for (size_t i=0; i!=m_nodes.size(); ++i) {
+        ne::SetNodePosition(ne::NodeId(m_nodes[i].get()), ImVec2(graph.positions[i].x, graph.positions[i].y));
+    }
+
+    OnGraphChanged();
+}
+
+void NodeEditorStorage::StopBackgroundWork() {
+    m_scheduler.Stop();
+    for (const auto& node: m_nodes) {
+        node->CancelBackgroundWork();
+    }
+    for (const auto& node: m_nodes) {
+        node->WaitBackgroundWork();
+    }
+}
+
+void NodeEditorStorage::OnGraphChanged() {
+    for (const auto& node: m_nodes) {
+        node->OnGraphChanged();
+    }
+    m_scheduler.OnGraphChanged(m_nodes);
+}
+
 void NodeEditorStorage::Draw() {
+    m_scheduler.Update();
     for (const auto& node: m_nodes) {
         node->Draw();
     }
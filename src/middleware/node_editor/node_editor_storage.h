@@ -1,10 +1,12 @@
 #pragma once
 
 #include <memory>
+#include <filesystem>
 #include <unordered_map>
 #include <imgui_node_editor.h>
 
 #include "middleware/node_editor/base_editor_node.h"
+#include "middleware/node_editor/node_scheduler.h"
 
 
 namespace std {
@@ -32,10 +34,22 @@ public:
 
     std::shared_ptr<BaseNode> GetNode(const ax::NodeEditor::NodeId nodeId);
 
+    // Writes the nodes with the parameters, the links and the positions of the nodes to the binary file (see graph_file.h)
+    // Should be called inside the node editor, throws EngineError
+    void Save(const std::filesystem::path& path) const;
+    // Replaces the graph by the graph from the file, the file is checked before the current graph is changed
+    // Should be called inside the node editor, throws EngineError
+    void Load(const std::filesystem::path& path);
+
     void Draw();
 
+private:
+    void StopBackgroundWork();
+    void OnGraphChanged();
+
 private:
     uintptr_t m_nextId = 1;
     std::vector<std::shared_ptr<BaseNode>> m_nodes;
     std::unordered_map<ax::NodeEditor::LinkId, LinkInfo> m_links;
+    NodeScheduler m_scheduler;
 };
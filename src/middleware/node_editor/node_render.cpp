@@ -4,7 +4,7 @@
 
 #include "engine/common/exception.h"
 #include "middleware/node_editor/noise_2d.h"
-#include "middleware/node_editor/noiseutils.h"
+#include "middleware/node_editor/noise_kernels.h"
 
 
 inline uint8_t BlendChannel(const uint8_t channel0, const uint8_t channel1, double alpha) {
@@ -23,6 +23,7 @@ inline math::Color LinearInterpColor(const math::Color& color0, const math::Colo
 
 void GradientColor::Add(double gradientPos, const math::Color& gradientColor) {
     m_points[gradientPos] = gradientColor;
+    BuildLut();
 }
 
 const math::Color GradientColor::Get(double gradientPos) const {
@@ -48,25 +49,60 @@ const math::Color GradientColor::Get(double gradientPos) const {
 
 void GradientColor::Clear() {
     m_points.clear();
+    BuildLut();
 }
 
-RenderNode::RenderNode()
-    : PreviewNode("Render")
-    , m_render(new noise::utils::RendererImage()) {
-    AddInPin(new BasePin(PinType::Noise2D, 0));
-    AddOutPin(new BasePin(PinType::Image, 0));
-    SetIsFull(false);
+void GradientColor::SetLutSize(uint32_t size) {
+    if (size < 2) {
+        throw EngineError("the size of the gradient lookup table should be at least 2, actual {}", size);
+    }
+
+    m_lutSize = size;
+    BuildLut();
+}
+
+const math::Color GradientColor::GetBaked(double gradientPos) const {
+    math::Color out;
+    const float value = static_cast<float>(gradientPos);
+    Colorize(&value, &out.value, 1);
+
+    return out;
+}
+
+void GradientColor::Colorize(const float* gradientPos, uint32_t* out, size_t count) const {
+    assert(m_points.size() >= 2);
 
-    // TODO: set correct size
-    m_render->SetDestSize(256, 256);
-    m_render->SetBounds(2.0, 6.0, 1.0, 5.0);
+    kernel::ColorLut lut;
+    lut.table = m_lut.data();
+    lut.size = m_lutSize;
+    lut.lower = m_lutLower;
+    lut.scale = m_lutScale;
+    kernel::Colorize(lut, gradientPos, out, count);
 }
 
-RenderNode::~RenderNode() {
-    if (m_render != nullptr) {
-        delete m_render;
-        m_render = nullptr;
+void GradientColor::BuildLut() {
+    m_lut.clear();
+    if (m_points.size() < 2) {
+        return;
     }
+
+    // the ends of the table are the first and the last points, values outside are clamped as in Get
+    const double lower = m_points.cbegin()->first;
+    const double upper = m_points.crbegin()->first;
+    const double step = (upper - lower) / static_cast<double>(m_lutSize - 1);
+    m_lut.resize(m_lutSize);
+    for (uint32_t i=0; i!=m_lutSize; ++i) {
+        m_lut[i] = Get(lower + static_cast<double>(i) * step).value;
+    }
+    m_lutLower = static_cast<float>(lower);
+    m_lutScale = static_cast<float>(1.0 / step);
+}
+
+RenderNode::RenderNode()
+    : PreviewNode("Render") {
+    AddInPin(new BasePin(PinType::Noise2D, 0));
+    AddOutPin(new BasePin(PinType::Image, 0));
+    SetIsFull(false);
 }
 
 void RenderNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
@@ -75,11 +111,11 @@ void RenderNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
         throw EngineError("BaseNoise2DNode incoming node is expected");
     }
 
-    m_render->SetSourceModule(srcNoiseNode);
+    m_sourceNode = srcNoiseNode;
 
     BaseNode::SetSourceNode(srcNode, dstPin);
 }
 
 void RenderNode::Update() {
-    UpdatePreview(m_render->Render());
+    UpdatePreview(m_sourceNode, m_renderSize);
 }
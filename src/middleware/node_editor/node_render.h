@@ -1,29 +1,52 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "engine/common/math.h"
 #include "middleware/node_editor/preview_node.h"
 
 
+// The points of the gradient are also baked into a dense lookup table,
+// the table is rebuilt by Add, Clear and SetLutSize
 class GradientColor {
+public:
+    static constexpr const uint32_t DefaultLutSize = 4096;
+
 public:
     GradientColor() = default;
 
     void Add(double gradientPos, const math::Color& gradientColor);
     size_t Count() const noexcept { return m_points.size(); }
+    // Exact color, interpolated between the points
     const math::Color Get(double gradientPos) const;
     void Clear();
 
+    // Number of elements of the lookup table, should be >= 2
+    void SetLutSize(uint32_t size);
+    uint32_t GetLutSize() const noexcept { return m_lutSize; }
+    // Color of the nearest element of the lookup table
+    const math::Color GetBaked(double gradientPos) const;
+    // Colors of the nearest elements of the lookup table as packed RGBA8, requires Count() >= 2
+    void Colorize(const float* gradientPos, uint32_t* out, size_t count) const;
+
+private:
+    void BuildLut();
+
 private:
     // pos => color
     std::map<double, math::Color> m_points;
+
+    uint32_t m_lutSize = DefaultLutSize;
+    float m_lutLower = 0;
+    float m_lutScale = 0;
+    std::vector<uint32_t> m_lut;
 };
 
 class RenderNode : public PreviewNode {
 public:
     RenderNode();
-    ~RenderNode() override;
+    ~RenderNode() override = default;
 
     void SetSourceNode(BaseNode* srcNode, BasePin* dstPin) final;
     void Update() final;
@@ -32,5 +55,7 @@ protected:
     bool DrawSettings() final { return false; }
 
 private:
-    noise::utils::RendererImage* m_render = nullptr;
+    // TODO: set correct size
+    uint32_t m_renderSize = 256;
+    const BaseNoise2DNode* m_sourceNode = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,477 @@
+#include "middleware/node_editor/node_scheduler.h"
+
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+#include "engine/common/exception.h"
+#include "engine/common/thread_pool.h"
+#include "middleware/node_editor/noise_2d.h"
+#include "middleware/node_editor/noise_3d.h"
+#include "middleware/node_editor/noiseutils.h"
+#include "middleware/node_editor/graph_file.h"
+#include "middleware/node_editor/noise_map_cache.h"
+
+
+// Evaluation of the previews of the noise 3D nodes in the thread pool.
+// The values of the node are calculated at the points of the plane (u, 0, v) of the preview,
+// the values of the sources are read from the maps of the sources: the maps built by this job
+// or the maps built before. The nodes are evaluated by levels: the sources of a node are on the lower levels,
+// the points of all nodes of one level are evaluated in parallel.
+// The previews are refined progressively as in PreviewJob, every pass evaluates all levels.
+// The octaves above the Nyquist limit of the previews are culled and the precision is single as in PreviewJob.
+// The values of the sources are read from the float maps, so a node with sources gets its inputs rounded to float
+// and its preview can differ slightly from PreviewJob and from the bakes, which pass the values between the nodes as doubles.
+// Every item evaluates its own copy of the node (see NodeFactory::Clone) made when the node is added,
+// so the editor can change the parameters of the nodes and the graph while the job is running.
+class GraphJob : Noncopyable {
+public:
+    static constexpr const uint32_t FirstPassSize = 16;
+    using MapPtr = std::shared_ptr<const noise::utils::NoiseMap>;
+
+public:
+    GraphJob() = delete;
+    GraphJob(uint32_t size);
+    ~GraphJob() = default;
+
+    // Should be called on the main thread before Run, the sources should be added before the node
+    // sources[i] - the map of the node connected to the input pin i
+    // Returns the map of the node, it is built when the job is finished
+    MapPtr AddNode(const BaseNoise3DNode* node, const std::vector<MapPtr>& sources, const std::shared_ptr<PreviewResult>& result);
+
+    // Called in the thread pool
+    void Run();
+
+    void Cancel() noexcept { m_cancelled = true; }
+    bool IsCancelled() const noexcept { return m_cancelled.load(); }
+    void Wait() { m_result->Wait(); }
+    bool IsFinished() const noexcept { return m_result->IsFinished(); }
+    // Returns true if all maps are built
+    bool IsBuilt() const noexcept { return m_built.load(); }
+
+private:
+    struct Item {
+        // the copy of the node with the parameters at the moment of AddNode
+        std::shared_ptr<const BaseNoise3DNode> node;
+        std::array<const noise::utils::NoiseMap*, BaseNoise3DNode::MaxSourceCount> sources = {};
+        std::shared_ptr<PreviewResult> result;
+        // invalid - the map can not be cached
+        NoiseMapKey cacheKey;
+        std::shared_ptr<const noise::utils::NoiseMap> cachedMap;
+        std::shared_ptr<noise::utils::NoiseMap> map;
+        uint32_t level = 0;
+        // values of the points of the current pass
+        std::vector<double> values;
+        noise::utils::RendererImage renderer;
+    };
+
+    void Evaluate();
+    void EvaluateChunk(Item& item, const noise::utils::NoiseMap::Points& points, size_t offset) const;
+
+private:
+    uint32_t m_size = 0;
+    uint32_t m_firstStep = 1;
+    // distance between the neighbouring points of the maps, see NoisePoints::spacing
+    double m_spacing = 0;
+    std::atomic<bool> m_cancelled = false;
+    std::atomic<bool> m_built = false;
+    // signals the end of the job
+    std::shared_ptr<PreviewResult> m_result = std::make_shared<PreviewResult>();
+    std::vector<std::unique_ptr<Item>> m_items;
+    // indices of the built items of every level
+    std::vector<std::vector<size_t>> m_levels;
+    // keeps the maps of the sources built before the job
+    std::vector<MapPtr> m_sourceMaps;
+};
+
+GraphJob::GraphJob(uint32_t size)
+    : m_size(size)
+    , m_spacing(std::max(PreviewNode::UpperUBound - PreviewNode::LowerUBound, PreviewNode::UpperVBound - PreviewNode::LowerVBound) / static_cast<double>(size)) {
+
+    while (size / (m_firstStep * 2) >= FirstPassSize) {
+        m_firstStep *= 2;
+    }
+}
+
+GraphJob::MapPtr GraphJob::AddNode(const BaseNoise3DNode* node, const std::vector<MapPtr>& sources, const std::shared_ptr<PreviewResult>& result) {
+    if (sources.size() > BaseNoise3DNode::MaxSourceCount) {
+        throw EngineError("wrong number {} of the sources, max value is {}", sources.size(), BaseNoise3DNode::MaxSourceCount);
+    }
+
+    auto item = std::make_unique<Item>();
+    item->node = std::dynamic_pointer_cast<const BaseNoise3DNode>(NodeFactory::Clone(node));
+    item->result = result;
+    item->cacheKey = NoiseMapCache::GetKey(node,
+        PreviewNode::LowerUBound, PreviewNode::UpperUBound, PreviewNode::LowerVBound, PreviewNode::UpperVBound, m_size, m_size,
+        NoisePrecision::Single, true);
+    if (item->cacheKey.IsValid()) {
+        item->cachedMap = NoiseMapCache::Get().Find(item->cacheKey);
+    }
+
+    MapPtr map = item->cachedMap;
+    if (map) {
+        item->renderer.SetSourceNoiseMap(*map);
+    } else {
+        for (size_t i=0; i!=sources.size(); ++i) {
+            if (!sources[i]) {
+                throw EngineError("the source {} of the noise node is not evaluated", i);
+            }
+            item->sources[i] = sources[i].get();
+
+            // the source is built by this job
+            const auto it = std::find_if(m_items.cbegin(), m_items.cend(), [&sources, i](const auto& other) {
+                return other->map == sources[i];
+            });
+            if (it == m_items.cend()) {
+                m_sourceMaps.push_back(sources[i]);
+            } else {
+                item->level = std::max(item->level, (*it)->level + 1);
+            }
+        }
+
+        item->map = std::make_shared<noise::utils::NoiseMap>();
+        item->map->SetSize(m_size, m_size);
+        item->map->SetBounds(PreviewNode::LowerUBound, PreviewNode::UpperUBound, PreviewNode::LowerVBound, PreviewNode::UpperVBound);
+        item->renderer.SetSourceNoiseMap(*item->map);
+        map = item->map;
+
+        if (m_levels.size() <= item->level) {
+            m_levels.resize(item->level + 1);
+        }
+        m_levels[item->level].push_back(m_items.size());
+    }
+
+    m_items.push_back(std::move(item));
+
+    return map;
+}
+
+void GraphJob::Run() {
+    try {
+        Evaluate();
+    } catch(...) {
+        const auto error = std::current_exception();
+        for (const auto& item: m_items) {
+            item->result->SetError(error);
+        }
+    }
+
+    for (const auto& item: m_items) {
+        item->result->Finish();
+    }
+    m_result->Finish();
+}
+
+void GraphJob::Evaluate() {
+    auto& pool = ThreadPool::Get();
+    const auto itemCount = static_cast<uint32_t>(m_items.size());
+
+    // the cached maps are only rendered
+    pool.ParallelFor(0, itemCount, 1, 0, [this](uint32_t begin, uint32_t end) {
+        for (uint32_t i=begin; i!=end; ++i) {
+            auto& item = *m_items[i];
+            if (item.cachedMap && (!m_cancelled.load())) {
+                item.result->Publish(item.renderer.Render());
+            }
+        }
+    });
+
+    if (m_levels.empty()) {
+        m_built = !m_cancelled.load();
+        return;
+    }
+
+    // all built maps have the same size and bounds and the same previous builds, so they have the same points
+    const auto& templateMap = *m_items[m_levels.front().front()]->map;
+    noise::utils::NoiseMap::Points points;
+    for (uint32_t step=m_firstStep; step!=0; step/=2) {
+        templateMap.GetBuildPoints(step, points);
+        const size_t pointCount = points.u.size();
+        const size_t chunkCount = (pointCount + noise::utils::NoiseMap::ChunkSize - 1) / noise::utils::NoiseMap::ChunkSize;
+
+        for (const auto& level: m_levels) {
+            for (const auto index: level) {
+                m_items[index]->values.resize(pointCount);
+            }
+
+            // one task is one chunk of the points of one node
+            const auto taskCount = static_cast<uint32_t>(level.size() * chunkCount);
+            pool.ParallelFor(0, taskCount, 1, 0, [this, &level, &points, chunkCount](uint32_t begin, uint32_t end) {
+                for (uint32_t task=begin; task!=end; ++task) {
+                    if (m_cancelled.load()) {
+                        return;
+                    }
+                    EvaluateChunk(*m_items[level[task / chunkCount]], points, (task % chunkCount) * noise::utils::NoiseMap::ChunkSize);
+                }
+            });
+
+            if (m_cancelled.load()) {
+                return;
+            }
+
+            pool.ParallelFor(0, static_cast<uint32_t>(level.size()), 1, 0, [this, &level, &points](uint32_t begin, uint32_t end) {
+                for (uint32_t i=begin; i!=end; ++i) {
+                    auto& item = *m_items[level[i]];
+                    item.map->SetBuildValues(points, item.values.data());
+                    item.result->Publish(item.renderer.Render());
+                }
+            });
+        }
+    }
+
+    for (const auto& item: m_items) {
+        if (item->map && item->cacheKey.IsValid()) {
+            NoiseMapCache::Get().Insert(item->cacheKey, item->map);
+        }
+    }
+    m_built = true;
+}
+
+void GraphJob::EvaluateChunk(Item& item, const noise::utils::NoiseMap::Points& points, size_t offset) const {
+    const size_t count = std::min(noise::utils::NoiseMap::ChunkSize, points.u.size() - offset);
+
+    std::array<std::vector<double>, BaseNoise3DNode::MaxSourceCount> buffers;
+    std::array<const double*, BaseNoise3DNode::MaxSourceCount> sources = {};
+    for (size_t i=0; i!=BaseNoise3DNode::MaxSourceCount; ++i) {
+        if (item.sources[i] == nullptr) {
+            continue;
+        }
+
+        // the points of the pass are evaluated by the sources in the same or in the previous passes
+        buffers[i].resize(count);
+        for (size_t j=0; j!=count; ++j) {
+            buffers[i][j] = static_cast<double>(item.sources[i]->GetValue(points.x[offset + j], points.y[offset + j]));
+        }
+        sources[i] = buffers[i].data();
+    }
+
+    // same as noise::model::Plane: (u, v) => (u, 0, v)
+    std::vector<double> y(count, 0.0);
+    item.node->OnGetValues(NoisePoints{points.u.data() + offset, y.data(), points.v.data() + offset, count, m_spacing, NoisePrecision::Single}, sources.data(), item.values.data() + offset);
+}
+
+NodeScheduler::~NodeScheduler() {
+    Stop();
+}
+
+void NodeScheduler::OnGraphChanged(const std::vector<std::shared_ptr<BaseNode>>& nodes) {
+    std::unordered_map<const BaseNode*, size_t> index;
+    for (size_t i=0; i!=nodes.size(); ++i) {
+        index[nodes[i].get()] = i;
+    }
+
+    // Kahn's algorithm, the state of the nodes is kept between the changes
+    std::vector<size_t> inDegree(nodes.size(), 0);
+    std::vector<std::vector<size_t>> dstNodes(nodes.size());
+    for (size_t i=0; i!=nodes.size(); ++i) {
+        for (const auto* srcNode: nodes[i]->m_LinkedSrcNodes) {
+            const auto it = index.find(srcNode);
+            if (it != index.cend()) {
+                dstNodes[it->second].push_back(i);
+                inDegree[i]++;
+            }
+        }
+    }
+
+    std::vector<size_t> order;
+    order.reserve(nodes.size());
+    for (size_t i=0; i!=nodes.size(); ++i) {
+        if (inDegree[i] == 0) {
+            order.push_back(i);
+        }
+    }
+    for (size_t i=0; i!=order.size(); ++i) {
+        for (const auto dst: dstNodes[order[i]]) {
+            if (--inDegree[dst] == 0) {
+                order.push_back(dst);
+            }
+        }
+    }
+
+    if (order.size() != nodes.size()) {
+        throw EngineError("the node graph contains a cycle");
+    }
+
+    std::vector<NodeState> states(nodes.size());
+    std::unordered_map<const BaseNode*, size_t> stateIndex;
+    for (size_t i=0; i!=order.size(); ++i) {
+        auto* node = nodes[order[i]].get();
+        stateIndex[node] = i;
+
+        auto& state = states[i];
+        if (const auto it = m_index.find(node); it != m_index.cend()) {
+            state = std::move(m_states[it->second]);
+            state.sources.clear();
+        }
+        state.node = node;
+        for (const auto* srcNode: node->m_LinkedSrcNodes) {
+            if (const auto it = stateIndex.find(srcNode); it != stateIndex.cend()) {
+                state.sources.push_back(it->second);
+            }
+        }
+    }
+
+    m_states = std::move(states);
+    m_index = std::move(stateIndex);
+}
+
+void NodeScheduler::Update() {
+    if (m_job && m_job->IsFinished()) {
+        ApplyJob();
+    }
+
+    bool isNoiseChanged = false;
+    for (auto& state: m_states) {
+        auto* node = state.node;
+        bool isFull = node->IsAllInPinsConnected();
+        state.generation = node->m_generation;
+        for (const auto src: state.sources) {
+            isFull = isFull && m_states[src].node->GetIsFull();
+            state.generation = std::max(state.generation, m_states[src].generation);
+        }
+        node->SetIsFull(isFull);
+
+        if ((!isFull) || (state.generation == state.evaluatedGeneration)) {
+            continue;
+        }
+        if (dynamic_cast<BaseNoise3DNode*>(node) != nullptr) {
+            isNoiseChanged = true;
+        } else if (auto* plane = dynamic_cast<PlaneNode*>(node); plane != nullptr) {
+            if (UpdatePlane(plane)) {
+                state.evaluatedGeneration = state.generation;
+            }
+        } else {
+            node->Update();
+            state.evaluatedGeneration = state.generation;
+        }
+    }
+
+    if (!isNoiseChanged) {
+        return;
+    }
+
+    // the nodes of the running job are evaluated again with the changed ones
+    CancelJob();
+
+    std::vector<bool> isChanged(m_states.size(), false);
+    for (size_t i=0; i!=m_states.size(); ++i) {
+        const auto& state = m_states[i];
+        isChanged[i] = state.node->GetIsFull() && (state.generation != state.evaluatedGeneration) &&
+            (dynamic_cast<BaseNoise3DNode*>(state.node) != nullptr);
+    }
+    // the sources without the maps (for example, after an error) are evaluated too
+    for (size_t i=m_states.size(); i!=0; --i) {
+        if (!isChanged[i - 1]) {
+            continue;
+        }
+        for (const auto src: m_states[i - 1].sources) {
+            isChanged[src] = isChanged[src] || (!m_states[src].noiseMap);
+        }
+    }
+
+    std::vector<size_t> indices;
+    for (size_t i=0; i!=m_states.size(); ++i) {
+        if (isChanged[i]) {
+            indices.push_back(i);
+        }
+    }
+    StartJob(indices);
+}
+
+void NodeScheduler::Stop() {
+    CancelJob();
+    for (const auto& job: m_cancelledJobs) {
+        job->Wait();
+    }
+    m_cancelledJobs.clear();
+}
+
+void NodeScheduler::ApplyJob() {
+    const bool isBuilt = m_job->IsBuilt();
+    for (const auto& [node, map]: m_jobNodes) {
+        const auto it = m_index.find(node);
+        if (it != m_index.cend()) {
+            // the map is not set after an error, the node is evaluated again when it is needed as the source
+            m_states[it->second].noiseMap = isBuilt ? map : nullptr;
+        }
+    }
+
+    m_job.reset();
+    m_jobNodes.clear();
+}
+
+void NodeScheduler::CancelJob() {
+    // the finished jobs are forgotten, the running ones are waited for by Stop
+    m_cancelledJobs.erase(std::remove_if(m_cancelledJobs.begin(), m_cancelledJobs.end(), [](const auto& job) {
+        return job->IsFinished();
+    }), m_cancelledJobs.end());
+
+    if (!m_job) {
+        return;
+    }
+
+    m_job->Cancel();
+    m_cancelledJobs.push_back(m_job);
+    for (const auto& [node, map]: m_jobNodes) {
+        const auto it = m_index.find(node);
+        if (it != m_index.cend()) {
+            m_states[it->second].evaluatedGeneration = 0;
+        }
+    }
+
+    m_job.reset();
+    m_jobNodes.clear();
+}
+
+void NodeScheduler::StartJob(const std::vector<size_t>& indices) {
+    if (indices.empty()) {
+        return;
+    }
+
+    auto* firstNode = dynamic_cast<BaseNoise3DNode*>(m_states[indices.front()].node);
+    auto job = std::make_shared<GraphJob>(firstNode->GetPreviewSize());
+    for (const auto i: indices) {
+        auto& state = m_states[i];
+        auto* node = dynamic_cast<BaseNoise3DNode*>(state.node);
+
+        std::vector<GraphJob::MapPtr> sources(node->GetSourceCount());
+        for (size_t pin=0; pin!=sources.size(); ++pin) {
+            sources[pin] = m_states[m_index.at(node->GetSourceNode(pin))].noiseMap;
+        }
+
+        auto result = std::make_shared<PreviewResult>();
+        state.noiseMap = job->AddNode(node, sources, result);
+        state.evaluatedGeneration = state.generation;
+        node->SetPreviewResult(result);
+        m_jobNodes.emplace_back(node, state.noiseMap);
+    }
+
+    // the maps of the nodes are published only after the job is finished
+    for (const auto i: indices) {
+        m_states[i].noiseMap = nullptr;
+    }
+
+    ThreadPool::Get().Submit([job]() { job->Run(); });
+    m_job = job;
+}
+
+bool NodeScheduler::UpdatePlane(PlaneNode* node) {
+    const auto& source = m_states[m_index.at(node->GetSourceNode())];
+    const bool isInJob = std::any_of(m_jobNodes.cbegin(), m_jobNodes.cend(), [&source](const auto& item) {
+        return item.first == source.node;
+    });
+    if ((source.generation != source.evaluatedGeneration) || isInJob) {
+        return false;
+    }
+
+    const auto size = node->GetPreviewSize();
+    if (source.noiseMap && (source.noiseMap->GetWidth() == size) && (source.noiseMap->GetHeight() == size)) {
+        node->UpdatePreview(source.noiseMap);
+    } else {
+        // the map of the source was not built (for example, after an error), the plane evaluates the subgraph
+        node->Update();
+    }
+
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
+
+#include "engine/common/noncopyable.h"
+
+
+namespace noise {
+    namespace utils {
+        class NoiseMap;
+    }
+}
+class BaseNode;
+class GraphJob;
+class PlaneNode;
+// Schedules the evaluation of the nodes of the graph.
+// The topological order of the nodes is calculated once per change of the graph.
+// Every change of a node increments its generation (see BaseNode::SetNeedUpdate), the generation of a node
+// with its sources is the maximum of their generations, the node is evaluated when this generation differs
+// from the evaluated one, so every node is evaluated once per change.
+// The previews of the noise 3D nodes are evaluated together by one GraphJob in the thread pool:
+// the nodes are grouped into levels, the nodes of one level do not depend on each other and are evaluated in parallel,
+// every node reads the values of its sources from their noise maps instead of evaluating the sources again.
+// The maps hold floats, so the inputs of a node with sources are rounded to float and its preview can differ
+// slightly from the values of the bakes and of PreviewJob, which pass the values between the nodes as doubles.
+// The preview of PlaneNode is the map of its source: both are the values of the source at the points (u, 0, v)
+// with the same bounds and size, so the plane waits for the map of its source and only renders it.
+// SphereNode and CylinderNode map the preview to other points and evaluate their subgraph again,
+// RenderNode evaluates its subgraph again at the size of the render.
+// Other nodes are evaluated by BaseNode::Update.
+class NodeScheduler : Noncopyable {
+public:
+    NodeScheduler() = default;
+    ~NodeScheduler();
+
+    // Called after any node or link of the graph is added or deleted
+    // Throws EngineError if the graph contains a cycle
+    void OnGraphChanged(const std::vector<std::shared_ptr<BaseNode>>& nodes);
+    // Called on the main thread before the drawing of the nodes
+    void Update();
+    // Cancels the evaluation and waits for it and for all jobs cancelled before, the cancelled nodes are evaluated again at the next update
+    void Stop();
+
+private:
+    struct NodeState {
+        BaseNode* node = nullptr;
+        // indices of the sources in m_states
+        std::vector<size_t> sources;
+        // generation of the node with its sources
+        uint64_t generation = 0;
+        uint64_t evaluatedGeneration = 0;
+        // only for the noise 3D nodes, nullptr if the node is being evaluated
+        std::shared_ptr<const noise::utils::NoiseMap> noiseMap;
+    };
+
+    void ApplyJob();
+    void CancelJob();
+    void StartJob(const std::vector<size_t>& indices);
+    // Returns false if the map of the source is not evaluated yet
+    bool UpdatePlane(PlaneNode* node);
+
+private:
+    // in the topological order
+    std::vector<NodeState> m_states;
+    std::unordered_map<const BaseNode*, size_t> m_index;
+    std::shared_ptr<GraphJob> m_job;
+    // the cancelled jobs that can still be running
+    std::vector<std::shared_ptr<GraphJob>> m_cancelledJobs;
+    // the nodes of m_job with their maps
+    std::vector<std::pair<const BaseNode*, std::shared_ptr<const noise::utils::NoiseMap>>> m_jobNodes;
+};
@@ -1,6 +1,12 @@
 #include "middleware/node_editor/noise_2d.h"
 
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <typeinfo>
+
 #include "engine/common/exception.h"
+#include "engine/common/hash_combine.h"
 #include "middleware/node_editor/noise_3d.h"
 
 
@@ -11,63 +17,143 @@ BaseNoise2DNode::BaseNoise2DNode(const std::string& name)
     SetIsFull(false);
 }
 
+void BaseNoise2DNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
+    auto* srcNoiseNode = dynamic_cast<BaseNoise3DNode*>(srcNode);
+    if (!srcNoiseNode) {
+        throw EngineError("BaseNoise3DNode incoming node is expected");
+    }
+
+    m_sourceNode = srcNoiseNode;
+    BaseNode::SetSourceNode(srcNode, dstPin);
+}
+
+void BaseNoise2DNode::DelSourceNode(BaseNode* srcNode, BasePin* dstPin) {
+    m_sourceNode = nullptr;
+    BaseNode::DelSourceNode(srcNode, dstPin);
+}
+
 void BaseNoise2DNode::Update() {
     UpdatePreview(this);
 }
 
-PlaneNode::PlaneNode()
-    : BaseNoise2DNode("Plane") {
+double BaseNoise2DNode::GetValue(double u, double v) const {
+    double value = 0;
+    GetValues(&u, &v, &value, 1, NoiseSampling());
+    return value;
 }
 
-double PlaneNode::GetValue(double u, double v) const {
-    return m_model.GetValue(u, v);
+bool BaseNoise2DNode::HasGradients() const {
+    return (m_sourceNode != nullptr) && m_sourceNode->HasGradients();
 }
 
-void PlaneNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
-    auto* srcNoiseNode = dynamic_cast<BaseNoise3DNode*>(srcNode);
-    if (!srcNoiseNode) {
-        throw EngineError("BaseNoise3DNode incoming node is expected");
+size_t BaseNoise2DNode::GetHash() const {
+    if (m_sourceNode == nullptr) {
+        return 0;
     }
 
-    m_model.SetModule(srcNoiseNode->GetModule());
+    size_t hash = m_sourceNode->GetHash();
+    if (hash == 0) {
+        return 0;
+    }
+    hash_combine(hash, typeid(*this).hash_code());
 
-    BaseNode::SetSourceNode(srcNode, dstPin);
+    return hash;
+}
+
+PlaneNode::PlaneNode()
+    : BaseNoise2DNode("Plane") {
+}
+
+void PlaneNode::GetValues(const double* u, const double* v, double* out, size_t count, const NoiseSampling& sampling) const {
+    // same as noise::model::Plane: (u, v) => (u, 0, v)
+    std::vector<double> y(count, 0.0);
+    m_sourceNode->GetValues(NoisePoints{u, y.data(), v, count, std::max(sampling.uSpacing, sampling.vSpacing), sampling.precision}, out);
+}
+
+void PlaneNode::GetGradients(const double* u, const double* v, double* out, double* du, double* dv, size_t count,
+    const NoiseSampling& sampling) const {
+    std::vector<double> buffer(count * 4, 0.0);
+    double* y = buffer.data();
+    const NoiseGradients gradients{y + count, y + count * 2, y + count * 3};
+    m_sourceNode->GetGradients(NoisePoints{u, y, v, count, std::max(sampling.uSpacing, sampling.vSpacing)}, out, gradients);
+    std::copy(gradients.x, gradients.x + count, du);
+    std::copy(gradients.z, gradients.z + count, dv);
 }
 
 SphereNode::SphereNode()
     : BaseNoise2DNode("Sphere") {
 }
 
-double SphereNode::GetValue(double u, double v) const {
-    return m_model.GetValue(v, u);
+void SphereNode::GetValues(const double* u, const double* v, double* out, size_t count, const NoiseSampling& sampling) const {
+    // same as noise::model::Sphere: (lat = v, lon = u) => (x, y, z)
+    std::vector<double> buffer(count * 3);
+    double* x = buffer.data();
+    double* y = x + count;
+    double* z = y + count;
+    for (size_t i=0; i!=count; ++i) {
+        noise::LatLonToXYZ(v[i], u[i], x[i], y[i], z[i]);
+    }
+    // the distance on the unit sphere is not greater than the angle
+    const double spacing = std::max(sampling.uSpacing, sampling.vSpacing) * noise::DEG_TO_RAD;
+    m_sourceNode->GetValues(NoisePoints{x, y, z, count, spacing, sampling.precision}, out);
 }
 
-void SphereNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
-    auto* srcNoiseNode = dynamic_cast<BaseNoise3DNode*>(srcNode);
-    if (!srcNoiseNode) {
-        throw EngineError("BaseNoise3DNode incoming node is expected");
+void SphereNode::GetGradients(const double* u, const double* v, double* out, double* du, double* dv, size_t count,
+    const NoiseSampling& sampling) const {
+    std::vector<double> buffer(count * 6);
+    double* x = buffer.data();
+    double* y = x + count;
+    double* z = y + count;
+    const NoiseGradients gradients{z + count, z + count * 2, z + count * 3};
+    for (size_t i=0; i!=count; ++i) {
+        noise::LatLonToXYZ(v[i], u[i], x[i], y[i], z[i]);
+    }
+    const double spacing = std::max(sampling.uSpacing, sampling.vSpacing) * noise::DEG_TO_RAD;
+    m_sourceNode->GetGradients(NoisePoints{x, y, z, count, spacing}, out, gradients);
+
+    // x = cos(lat) * cos(lon), y = sin(lat), z = cos(lat) * sin(lon), the angles are in degrees
+    for (size_t i=0; i!=count; ++i) {
+        const double cosLon = std::cos(u[i] * noise::DEG_TO_RAD);
+        const double sinLon = std::sin(u[i] * noise::DEG_TO_RAD);
+        const double r = std::cos(v[i] * noise::DEG_TO_RAD);
+        du[i] = (gradients.z[i] * x[i] - gradients.x[i] * z[i]) * noise::DEG_TO_RAD;
+        dv[i] = (gradients.y[i] * r - (gradients.x[i] * cosLon + gradients.z[i] * sinLon) * y[i]) * noise::DEG_TO_RAD;
     }
-
-    m_model.SetModule(srcNoiseNode->GetModule());
-
-    BaseNode::SetSourceNode(srcNode, dstPin);
 }
 
 CylinderNode::CylinderNode()
     : BaseNoise2DNode("Cylinder") {
 }
 
-double CylinderNode::GetValue(double u, double v) const {
-    return m_model.GetValue(u, v);
+void CylinderNode::GetValues(const double* u, const double* v, double* out, size_t count, const NoiseSampling& sampling) const {
+    // same as noise::model::Cylinder: (angle = u, height = v) => (x, y, z)
+    std::vector<double> buffer(count * 2);
+    double* x = buffer.data();
+    double* z = x + count;
+    for (size_t i=0; i!=count; ++i) {
+        x[i] = std::cos(u[i] * noise::DEG_TO_RAD);
+        z[i] = std::sin(u[i] * noise::DEG_TO_RAD);
+    }
+    const double spacing = std::max(sampling.uSpacing * noise::DEG_TO_RAD, sampling.vSpacing);
+    m_sourceNode->GetValues(NoisePoints{x, v, z, count, spacing, sampling.precision}, out);
 }
 
-void CylinderNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
-    auto* srcNoiseNode = dynamic_cast<BaseNoise3DNode*>(srcNode);
-    if (!srcNoiseNode) {
-        throw EngineError("BaseNoise3DNode incoming node is expected");
+void CylinderNode::GetGradients(const double* u, const double* v, double* out, double* du, double* dv, size_t count,
+    const NoiseSampling& sampling) const {
+    std::vector<double> buffer(count * 5);
+    double* x = buffer.data();
+    double* z = x + count;
+    const NoiseGradients gradients{z + count, z + count * 2, z + count * 3};
+    for (size_t i=0; i!=count; ++i) {
+        x[i] = std::cos(u[i] * noise::DEG_TO_RAD);
+        z[i] = std::sin(u[i] * noise::DEG_TO_RAD);
     }
+    const double spacing = std::max(sampling.uSpacing * noise::DEG_TO_RAD, sampling.vSpacing);
+    m_sourceNode->GetGradients(NoisePoints{x, v, z, count, spacing}, out, gradients);
 
-    m_model.SetModule(srcNoiseNode->GetModule());
-
-    BaseNode::SetSourceNode(srcNode, dstPin);
-}
\ No newline at end of file
+    // x = cos(angle), z = sin(angle), y = height, the angle is in degrees
+    for (size_t i=0; i!=count; ++i) {
+        du[i] = (gradients.z[i] * x[i] - gradients.x[i] * z[i]) * noise::DEG_TO_RAD;
+        dv[i] = gradients.y[i];
+    }
+}
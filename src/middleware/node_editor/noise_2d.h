@@ -2,51 +2,74 @@
 
 #include <noise.h>
 
+#include "middleware/node_editor/noise_3d.h"
 #include "middleware/node_editor/preview_node.h"
 
 
+// Sampling of the points of the 2D node, see NoisePoints
+struct NoiseSampling {
+    // distance between the neighbouring points along u and v (see NoisePoints::spacing),
+    // 0 - all octaves of the fractal generators are evaluated
+    double uSpacing = 0;
+    double vSpacing = 0;
+    NoisePrecision precision = NoisePrecision::Double;
+};
+
 class BaseNoise2DNode : public PreviewNode {
 protected:
     BaseNoise2DNode(const std::string& name);
 
 public:
+    void SetSourceNode(BaseNode* srcNode, BasePin* dstPin) override;
+    void DelSourceNode(BaseNode* srcNode, BasePin* dstPin) override;
     void Update() override;
-    virtual double GetValue(double u, double v) const = 0;
+    // Evaluates the node for one point through GetValues, prefer GetValues for many points
+    double GetValue(double u, double v) const;
+    // Evaluates the node for the points (u[i], v[i]), out should contain count elements
+    virtual void GetValues(const double* u, const double* v, double* out, size_t count, const NoiseSampling& sampling) const = 0;
+    // Returns true if the source node supports the gradients, see BaseNoise3DNode::HasGradients
+    bool HasGradients() const;
+    // Evaluates the node and the partial derivatives of its values by u and v for the points (u[i], v[i]),
+    // all arrays should contain count elements, the precision of the sampling is not used (the values are in double precision)
+    // Throws EngineError if HasGradients() is false
+    virtual void GetGradients(const double* u, const double* v, double* out, double* du, double* dv, size_t count,
+        const NoiseSampling& sampling) const = 0;
+    // Hash of the type of the node and of the source subgraph, returns 0 if the subgraph is not full
+    size_t GetHash() const;
+    // Returns nullptr if the input pin is not connected
+    const BaseNoise3DNode* GetSourceNode() const noexcept { return m_sourceNode; }
 
 protected:
     bool DrawSettings() override { return false; }
     virtual bool OnDrawSettings() { return false; }
+
+protected:
+    const BaseNoise3DNode* m_sourceNode = nullptr;
 };
 
 class PlaneNode: public BaseNoise2DNode {
 public:
     PlaneNode();
 
-    double GetValue(double u, double v) const override;
-    void SetSourceNode(BaseNode* srcNode, BasePin* dstPin) override;
-
-private:
-    noise::model::Plane m_model;
+    void GetValues(const double* u, const double* v, double* out, size_t count, const NoiseSampling& sampling) const override;
+    void GetGradients(const double* u, const double* v, double* out, double* du, double* dv, size_t count,
+        const NoiseSampling& sampling) const override;
 };
 
 class SphereNode: public BaseNoise2DNode {
 public:
     SphereNode();
 
-    double GetValue(double u, double v) const override;
-    void SetSourceNode(BaseNode* srcNode, BasePin* dstPin) override;
-
-private:
-    noise::model::Sphere m_model;
+    void GetValues(const double* u, const double* v, double* out, size_t count, const NoiseSampling& sampling) const override;
+    void GetGradients(const double* u, const double* v, double* out, double* du, double* dv, size_t count,
+        const NoiseSampling& sampling) const override;
 };
 
 class CylinderNode: public BaseNoise2DNode {
 public:
     CylinderNode();
 
-    double GetValue(double u, double v) const override;
-    void SetSourceNode(BaseNode* srcNode, BasePin* dstPin) override;
-
-private:
-    noise::model::Cylinder m_model;
+    void GetValues(const double* u, const double* v, double* out, size_t count, const NoiseSampling& sampling) const override;
+    void GetGradients(const double* u, const double* v, double* out, double* du, double* dv, size_t count,
+        const NoiseSampling& sampling) const override;
 };
@@ -1,14 +1,65 @@
 #include "middleware/node_editor/noise_3d.h"
 
+#include <cmath>
+#include <algorithm>
+#include <functional>
 #include <imgui_node_editor.h>
 
 #include "engine/gui/widgets.h"
+#include "engine/common/hash_combine.h"
 #include "engine/common/exception.h"
 #include "middleware/node_editor/noiseutils.h"
+#include "middleware/node_editor/graph_file.h"
+#include "middleware/node_editor/noise_program.h"
 
 
 namespace ne = ax::NodeEditor;
 
+// Returns the unbounded range if some value is NaN
+static NoiseRange MakeRange(std::initializer_list<double> values) {
+    NoiseRange result{std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+    for (const auto value: values) {
+        if (std::isnan(value)) {
+            return NoiseRange();
+        }
+        result.lower = std::min(result.lower, value);
+        result.upper = std::max(result.upper, value);
+    }
+
+    return result;
+}
+
+// Covers the rounding errors of the operations which are not monotonic in floating point
+static NoiseRange Widen(const NoiseRange& range) {
+    constexpr const double epsilon = 1e-9;
+    return NoiseRange{range.lower - epsilon * std::max(1.0, std::fabs(range.lower)),
+        range.upper + epsilon * std::max(1.0, std::fabs(range.upper))};
+}
+
+static double GetMaxAbs(const NoiseRange& range) {
+    return std::max(std::fabs(range.lower), std::fabs(range.upper));
+}
+
+// factor * error, 0 if the error is 0 for any factor
+static double ScaleError(double factor, double error) {
+    return (error > 0.0) ? factor * error : 0.0;
+}
+
+// gradients[i] = source[i] * factor
+static void SetGradient(const NoiseGradients& gradients, size_t i, const NoiseGradients& source, double factor) {
+    gradients.x[i] = source.x[i] * factor;
+    gradients.y[i] = source.y[i] * factor;
+    gradients.z[i] = source.z[i] * factor;
+}
+
+// gradients[i] = source0[i] * factor0 + source1[i] * factor1
+static void SetGradient(const NoiseGradients& gradients, size_t i, const NoiseGradients& source0, double factor0,
+    const NoiseGradients& source1, double factor1) {
+    gradients.x[i] = source0.x[i] * factor0 + source1.x[i] * factor1;
+    gradients.y[i] = source0.y[i] * factor0 + source1.y[i] * factor1;
+    gradients.z[i] = source0.z[i] * factor0 + source1.z[i] * factor1;
+}
+
 BaseNoise3DNode::BaseNoise3DNode(noise::module::Module* module, const std::string& name)
     : PreviewNode(name)
     , m_module(module) {
@@ -22,12 +73,82 @@ void BaseNoise3DNode::SetSourceNode(BaseNode* srcNode, BasePin* dstPin) {
         throw EngineError("BaseNoise3DNode incoming node is expected");
     }
 
-    m_module->SetSourceModule(static_cast<int>(dstPin->GetUserIndex()), srcNoiseNode->GetModule());
+    const auto index = dstPin->GetUserIndex();
+    if (index >= MaxSourceCount) {
+        throw EngineError("wrong index {} of the input pin, max value is {}", index, MaxSourceCount - 1);
+    }
+
+    m_module->SetSourceModule(static_cast<int>(index), srcNoiseNode->GetModule());
+    m_sourceNodes[index] = srcNoiseNode;
     BaseNode::SetSourceNode(srcNode, dstPin);
 }
 
-void BaseNoise3DNode::Update() {
-    UpdatePreview(this);
+void BaseNoise3DNode::DelSourceNode(BaseNode* srcNode, BasePin* dstPin) {
+    const auto index = dstPin->GetUserIndex();
+    if (index < MaxSourceCount) {
+        m_sourceNodes[index] = nullptr;
+    }
+    BaseNode::DelSourceNode(srcNode, dstPin);
+}
+
+void BaseNoise3DNode::OnGraphChanged() {
+    m_program = NoiseProgram::Compile(this);
+}
+
+size_t BaseNoise3DNode::GetHash() const {
+    return m_program ? m_program->GetHash() : 0;
+}
+
+double BaseNoise3DNode::GetSinglePrecisionError() const {
+    return m_program ? m_program->GetSinglePrecisionError() : std::numeric_limits<double>::infinity();
+}
+
+void BaseNoise3DNode::GetValues(const NoisePoints& points, double* out) const {
+    // the program evaluates every node of the subgraph once per block and shares the values with all its consumers,
+    // it is compiled by OnGraphChanged only, so a call does not pay for the compilation
+    if (!m_program) {
+        throw EngineError("the subgraph of the noise node '{}' is not full", GetName());
+    }
+    m_program->Execute(points, out);
+}
+
+bool BaseNoise3DNode::HasGradients() const {
+    return m_program && m_program->HasGradients();
+}
+
+void BaseNoise3DNode::GetGradients(const NoisePoints& points, double* out, const NoiseGradients& gradients) const {
+    if (!m_program) {
+        throw EngineError("the subgraph of the noise node '{}' is not full", GetName());
+    }
+    if (!m_program->HasGradients()) {
+        throw EngineError("the subgraph of the noise node '{}' contains nodes without the gradients", GetName());
+    }
+    m_program->ExecuteGradients(points, out, gradients);
+}
+
+void BaseNoise3DNode::OnGetValues(const NoisePoints& points, const double* const* /* sources */, double* out) const {
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = m_module->GetValue(points.x[i], points.y[i], points.z[i]);
+    }
+}
+
+void BaseNoise3DNode::OnGetGradients(const NoisePoints& /* points */, const double* const* /* sources */,
+    const NoiseGradients* /* sourceGradients */, double* /* out */, const NoiseGradients& /* gradients */) const {
+    throw EngineError("the noise node '{}' has no gradients", GetName());
+}
+
+NoiseRange BaseNoise3DNode::OnGetRange(const NoiseRange* /* sources */) const {
+    return NoiseRange();
+}
+
+double BaseNoise3DNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    for (size_t i=0; i!=GetSourceCount(); ++i) {
+        if (errors[i] > 0.0) {
+            return std::numeric_limits<double>::infinity();
+        }
+    }
+
+    return 0.0;
 }
 
 bool BaseNoise3DNode::DrawSettings() {
@@ -44,6 +165,39 @@ AbsNode::AbsNode()
     SetIsFull(false);
 }
 
+void AbsNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = std::fabs(src[i]);
+    }
+}
+
+void AbsNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = std::fabs(src[i]);
+        SetGradient(gradients, i, sourceGradients[0], (src[i] < 0.0) ? -1.0 : 1.0);
+    }
+}
+
+NoiseRange AbsNode::OnGetRange(const NoiseRange* sources) const {
+    const auto& src = sources[0];
+    if (src.lower >= 0.0) {
+        return src;
+    }
+    if (src.upper <= 0.0) {
+        return NoiseRange{-src.upper, -src.lower};
+    }
+
+    return NoiseRange{0.0, std::max(-src.lower, src.upper)};
+}
+
+double AbsNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    // ||a| - |b|| <= |a - b|
+    return errors[0];
+}
+
 ClampNode::ClampNode()
     : BaseNoise3DNode(this, "Clamp") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -63,6 +217,76 @@ bool ClampNode::OnDrawSettings() {
     return changed;
 }
 
+void ClampNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_lowerBound);
+    hash_combine(hash, m_upperBound);
+}
+
+void ClampNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_lowerBound);
+    writer.Write(m_upperBound);
+}
+
+void ClampNode::LoadParams(ParamsReader& reader) {
+    double lowerBound = 0;
+    double upperBound = 0;
+    reader.Read(lowerBound);
+    reader.Read(upperBound);
+    if (!(lowerBound < upperBound)) {
+        throw EngineError("wrong bounds [{}, {}] of the clamp node", lowerBound, upperBound);
+    }
+    SetBounds(lowerBound, upperBound);
+}
+
+void ClampNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        const double value = src[i];
+        if (value < m_lowerBound) {
+            out[i] = m_lowerBound;
+        } else if (value > m_upperBound) {
+            out[i] = m_upperBound;
+        } else {
+            out[i] = value;
+        }
+    }
+}
+
+void ClampNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        const double value = src[i];
+        if (value < m_lowerBound) {
+            out[i] = m_lowerBound;
+            SetGradient(gradients, i, sourceGradients[0], 0.0);
+        } else if (value > m_upperBound) {
+            out[i] = m_upperBound;
+            SetGradient(gradients, i, sourceGradients[0], 0.0);
+        } else {
+            out[i] = value;
+            SetGradient(gradients, i, sourceGradients[0], 1.0);
+        }
+    }
+}
+
+NoiseRange ClampNode::OnGetRange(const NoiseRange* sources) const {
+    const auto clamp = [this](double value) {
+        return (value < m_lowerBound) ? m_lowerBound : ((value > m_upperBound) ? m_upperBound : value);
+    };
+
+    return NoiseRange{clamp(sources[0].lower), clamp(sources[0].upper)};
+}
+
+double ClampNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    return errors[0];
+}
+
+size_t ClampNode::OnSelectSource(const NoiseRange* sources) const {
+    // the values within the bounds are returned as is
+    return ((sources[0].lower >= m_lowerBound) && (sources[0].upper <= m_upperBound)) ? 0 : NoSource;
+}
+
 ExponentNode::ExponentNode()
     : BaseNoise3DNode(this, "Exponent") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -77,12 +301,105 @@ bool ExponentNode::OnDrawSettings() {
     return changed;
 }
 
+void ExponentNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_exponent);
+}
+
+void ExponentNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_exponent);
+}
+
+void ExponentNode::LoadParams(ParamsReader& reader) {
+    reader.Read(m_exponent);
+}
+
+void ExponentNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = (std::pow(std::fabs((src[i] + 1.0) / 2.0), m_exponent) * 2.0 - 1.0);
+    }
+}
+
+void ExponentNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        const double base = (src[i] + 1.0) / 2.0;
+        out[i] = (std::pow(std::fabs(base), m_exponent) * 2.0 - 1.0);
+        // d(2 * |base|^p - 1) = 2 * p * |base|^(p - 1) * sign(base) * dsrc / 2
+        const double derivative = m_exponent * std::pow(std::fabs(base), m_exponent - 1.0);
+        SetGradient(gradients, i, sourceGradients[0], (base < 0.0) ? -derivative : derivative);
+    }
+}
+
+NoiseRange ExponentNode::OnGetRange(const NoiseRange* sources) const {
+    if (!(m_exponent > 0.0)) {
+        return NoiseRange();
+    }
+
+    // pow is increasing for the positive exponent
+    const auto base = MakeRange({(sources[0].lower + 1.0) / 2.0, (sources[0].upper + 1.0) / 2.0});
+    const double lower = (base.lower > 0.0) ? base.lower : ((base.upper < 0.0) ? -base.upper : 0.0);
+    const double upper = std::max(std::fabs(base.lower), std::fabs(base.upper));
+
+    return Widen(MakeRange({std::pow(lower, m_exponent) * 2.0 - 1.0, std::pow(upper, m_exponent) * 2.0 - 1.0}));
+}
+
+double ExponentNode::OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const {
+    if (!(errors[0] > 0.0)) {
+        return 0.0;
+    }
+    if (!(m_exponent > 0.0)) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    // the base |(value + 1) / 2| changes by at most error / 2
+    const double baseError = errors[0] / 2.0;
+    if (m_exponent < 1.0) {
+        // |x^p - y^p| <= |x - y|^p for x, y >= 0 and 0 < p < 1
+        return 2.0 * std::pow(baseError, m_exponent);
+    }
+
+    // |x^p - y^p| <= p * max(x, y)^(p - 1) * |x - y| for p >= 1
+    const double base = std::max(std::fabs(sources[0].lower - errors[0] + 1.0), std::fabs(sources[0].upper + errors[0] + 1.0)) / 2.0;
+    return 2.0 * m_exponent * std::pow(base, m_exponent - 1.0) * baseError;
+}
+
 InvertNode::InvertNode()
     : BaseNoise3DNode(this, "Invert") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
     SetIsFull(false);
 }
 
+void InvertNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = -src[i];
+    }
+}
+
+void InvertNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = -src[i];
+        SetGradient(gradients, i, sourceGradients[0], -1.0);
+    }
+}
+
+NoiseRange InvertNode::OnGetRange(const NoiseRange* sources) const {
+    return NoiseRange{-sources[0].upper, -sources[0].lower};
+}
+
+double InvertNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    return errors[0];
+}
+
+NoiseAffine InvertNode::OnGetAffine(const double* const* /* constants */, const uint32_t* /* sourceIds */) const {
+    // x * -1 + -0 == -x
+    return NoiseAffine{0, -1.0, -0.0};
+}
+
 ScaleBiasNode::ScaleBiasNode()
     : BaseNoise3DNode(this, "ScaleBias") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -98,6 +415,49 @@ bool ScaleBiasNode::OnDrawSettings() {
     return changed;
 }
 
+void ScaleBiasNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_bias);
+    hash_combine(hash, m_scale);
+}
+
+void ScaleBiasNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_bias);
+    writer.Write(m_scale);
+}
+
+void ScaleBiasNode::LoadParams(ParamsReader& reader) {
+    reader.Read(m_bias);
+    reader.Read(m_scale);
+}
+
+void ScaleBiasNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = src[i] * m_scale + m_bias;
+    }
+}
+
+void ScaleBiasNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src = sources[0];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = src[i] * m_scale + m_bias;
+        SetGradient(gradients, i, sourceGradients[0], m_scale);
+    }
+}
+
+NoiseRange ScaleBiasNode::OnGetRange(const NoiseRange* sources) const {
+    return MakeRange({sources[0].lower * m_scale + m_bias, sources[0].upper * m_scale + m_bias});
+}
+
+double ScaleBiasNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    return ScaleError(std::fabs(m_scale), errors[0]);
+}
+
+NoiseAffine ScaleBiasNode::OnGetAffine(const double* const* /* constants */, const uint32_t* /* sourceIds */) const {
+    return NoiseAffine{0, m_scale, m_bias};
+}
+
 AddNode::AddNode()
     : BaseNoise3DNode(this, "Add") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -105,6 +465,44 @@ AddNode::AddNode()
     SetIsFull(false);
 }
 
+void AddNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = src0[i] + src1[i];
+    }
+}
+
+void AddNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = src0[i] + src1[i];
+        SetGradient(gradients, i, sourceGradients[0], 1.0, sourceGradients[1], 1.0);
+    }
+}
+
+NoiseRange AddNode::OnGetRange(const NoiseRange* sources) const {
+    return MakeRange({sources[0].lower + sources[1].lower, sources[0].upper + sources[1].upper});
+}
+
+double AddNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    return errors[0] + errors[1];
+}
+
+NoiseAffine AddNode::OnGetAffine(const double* const* constants, const uint32_t* /* sourceIds */) const {
+    // x * 1 + c == x + c
+    if (constants[1] != nullptr) {
+        return NoiseAffine{0, 1.0, *constants[1]};
+    }
+    if (constants[0] != nullptr) {
+        return NoiseAffine{1, 1.0, *constants[0]};
+    }
+
+    return NoiseAffine();
+}
+
 MaxNode::MaxNode()
     : BaseNoise3DNode(this, "Max") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -112,6 +510,50 @@ MaxNode::MaxNode()
     SetIsFull(false);
 }
 
+void MaxNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::GetMax(src0[i], src1[i]);
+    }
+}
+
+void MaxNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        // same choice as noise::GetMax
+        const bool isFirst = (src0[i] > src1[i]);
+        out[i] = isFirst ? src0[i] : src1[i];
+        SetGradient(gradients, i, sourceGradients[isFirst ? 0 : 1], 1.0);
+    }
+}
+
+NoiseRange MaxNode::OnGetRange(const NoiseRange* sources) const {
+    return NoiseRange{std::max(sources[0].lower, sources[1].lower), std::max(sources[0].upper, sources[1].upper)};
+}
+
+double MaxNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    return std::max(errors[0], errors[1]);
+}
+
+size_t MaxNode::OnSelectSource(const NoiseRange* sources) const {
+    // noise::GetMax returns the second value for the equal values
+    if (sources[0].lower > sources[1].upper) {
+        return 0;
+    }
+    if (sources[0].upper <= sources[1].lower) {
+        return 1;
+    }
+
+    return NoSource;
+}
+
+NoiseAffine MaxNode::OnGetAffine(const double* const* /* constants */, const uint32_t* sourceIds) const {
+    return (sourceIds[0] == sourceIds[1]) ? NoiseAffine{0, 1.0, -0.0} : NoiseAffine();
+}
+
 MinNode::MinNode()
     : BaseNoise3DNode(this, "Min") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -119,6 +561,50 @@ MinNode::MinNode()
     SetIsFull(false);
 }
 
+void MinNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = noise::GetMin(src0[i], src1[i]);
+    }
+}
+
+void MinNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        // same choice as noise::GetMin
+        const bool isFirst = (src0[i] < src1[i]);
+        out[i] = isFirst ? src0[i] : src1[i];
+        SetGradient(gradients, i, sourceGradients[isFirst ? 0 : 1], 1.0);
+    }
+}
+
+NoiseRange MinNode::OnGetRange(const NoiseRange* sources) const {
+    return NoiseRange{std::min(sources[0].lower, sources[1].lower), std::min(sources[0].upper, sources[1].upper)};
+}
+
+double MinNode::OnGetSinglePrecisionError(const NoiseRange* /* sources */, const double* errors) const {
+    return std::max(errors[0], errors[1]);
+}
+
+size_t MinNode::OnSelectSource(const NoiseRange* sources) const {
+    // noise::GetMin returns the second value for the equal values
+    if (sources[0].upper < sources[1].lower) {
+        return 0;
+    }
+    if (sources[0].lower >= sources[1].upper) {
+        return 1;
+    }
+
+    return NoSource;
+}
+
+NoiseAffine MinNode::OnGetAffine(const double* const* /* constants */, const uint32_t* sourceIds) const {
+    return (sourceIds[0] == sourceIds[1]) ? NoiseAffine{0, 1.0, -0.0} : NoiseAffine();
+}
+
 MultiplyNode::MultiplyNode()
     : BaseNoise3DNode(this, "Multiply") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -126,6 +612,47 @@ MultiplyNode::MultiplyNode()
     SetIsFull(false);
 }
 
+void MultiplyNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = src0[i] * src1[i];
+    }
+}
+
+void MultiplyNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = src0[i] * src1[i];
+        SetGradient(gradients, i, sourceGradients[0], src1[i], sourceGradients[1], src0[i]);
+    }
+}
+
+NoiseRange MultiplyNode::OnGetRange(const NoiseRange* sources) const {
+    const auto& src0 = sources[0];
+    const auto& src1 = sources[1];
+    return MakeRange({src0.lower * src1.lower, src0.lower * src1.upper, src0.upper * src1.lower, src0.upper * src1.upper});
+}
+
+double MultiplyNode::OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const {
+    // |(a + ea) * (b + eb) - a * b| <= |a| * eb + |b| * ea + ea * eb
+    return ScaleError(GetMaxAbs(sources[0]), errors[1]) + ScaleError(GetMaxAbs(sources[1]), errors[0]) + errors[0] * errors[1];
+}
+
+NoiseAffine MultiplyNode::OnGetAffine(const double* const* constants, const uint32_t* /* sourceIds */) const {
+    // x * c + -0 == x * c
+    if (constants[1] != nullptr) {
+        return NoiseAffine{0, *constants[1], -0.0};
+    }
+    if (constants[0] != nullptr) {
+        return NoiseAffine{1, *constants[0], -0.0};
+    }
+
+    return NoiseAffine();
+}
+
 PowerNode::PowerNode()
     : BaseNoise3DNode(this, "Power") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -133,6 +660,32 @@ PowerNode::PowerNode()
     SetIsFull(false);
 }
 
+void PowerNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = std::pow(src0[i], src1[i]);
+    }
+}
+
+void PowerNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    for (size_t i=0; i!=points.count; ++i) {
+        out[i] = std::pow(src0[i], src1[i]);
+        // d(a^b) = b * a^(b - 1) * da + a^b * ln(a) * db, the second term is defined only for the positive base
+        const double baseFactor = src1[i] * std::pow(src0[i], src1[i] - 1.0);
+        const double exponentFactor = (src0[i] > 0.0) ? out[i] * std::log(src0[i]) : 0.0;
+        SetGradient(gradients, i, sourceGradients[0], baseFactor, sourceGradients[1], exponentFactor);
+    }
+}
+
+NoiseAffine PowerNode::OnGetAffine(const double* const* constants, const uint32_t* /* sourceIds */) const {
+    // pow(x, 1) == x
+    return ((constants[1] != nullptr) && std::equal_to<double>()(*constants[1], 1.0)) ? NoiseAffine{0, 1.0, -0.0} : NoiseAffine();
+}
+
 SelectNode::SelectNode()
     : BaseNoise3DNode(this, "Select") {
     AddInPin(new BasePin(PinType::Noise3D, 0));
@@ -154,3 +707,179 @@ bool SelectNode::OnDrawSettings() {
 
     return changed;
 }
+
+void SelectNode::OnHashParams(size_t& hash) const {
+    hash_combine(hash, m_edgeFalloff);
+    hash_combine(hash, m_lowerBound);
+    hash_combine(hash, m_upperBound);
+}
+
+void SelectNode::SaveParams(ParamsWriter& writer) const {
+    writer.Write(m_edgeFalloff);
+    writer.Write(m_lowerBound);
+    writer.Write(m_upperBound);
+}
+
+void SelectNode::LoadParams(ParamsReader& reader) {
+    double lowerBound = 0;
+    double upperBound = 0;
+    reader.Read(m_edgeFalloff);
+    reader.Read(lowerBound);
+    reader.Read(upperBound);
+    if (!(lowerBound < upperBound)) {
+        throw EngineError("wrong bounds [{}, {}] of the select node", lowerBound, upperBound);
+    }
+    // clamps the edge falloff by the bounds
+    SetBounds(lowerBound, upperBound);
+}
+
+void SelectNode::OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    const double* control = sources[2];
+
+    // same as noise::module::Select::GetValue
+    if (m_edgeFalloff > 0.0) {
+        const double lowerCurve0 = (m_lowerBound - m_edgeFalloff);
+        const double upperCurve0 = (m_lowerBound + m_edgeFalloff);
+        const double lowerCurve1 = (m_upperBound - m_edgeFalloff);
+        const double upperCurve1 = (m_upperBound + m_edgeFalloff);
+        for (size_t i=0; i!=points.count; ++i) {
+            const double controlValue = control[i];
+            if (controlValue < lowerCurve0) {
+                out[i] = src0[i];
+            } else if (controlValue < upperCurve0) {
+                const double alpha = noise::SCurve3((controlValue - lowerCurve0) / (upperCurve0 - lowerCurve0));
+                out[i] = noise::LinearInterp(src0[i], src1[i], alpha);
+            } else if (controlValue < lowerCurve1) {
+                out[i] = src1[i];
+            } else if (controlValue < upperCurve1) {
+                const double alpha = noise::SCurve3((controlValue - lowerCurve1) / (upperCurve1 - lowerCurve1));
+                out[i] = noise::LinearInterp(src1[i], src0[i], alpha);
+            } else {
+                out[i] = src0[i];
+            }
+        }
+    } else {
+        for (size_t i=0; i!=points.count; ++i) {
+            const double controlValue = control[i];
+            if (controlValue < m_lowerBound || controlValue > m_upperBound) {
+                out[i] = src0[i];
+            } else {
+                out[i] = src1[i];
+            }
+        }
+    }
+}
+
+void SelectNode::OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+    double* out, const NoiseGradients& gradients) const {
+    const double* src0 = sources[0];
+    const double* src1 = sources[1];
+    const double* control = sources[2];
+
+    // same as OnGetValues, in the falloff the derivative of alpha = SCurve3(t) by the control value is 6 * t * (1 - t) / (2 * falloff)
+    auto blend = [&](size_t i, size_t from, size_t to, double lowerCurve, double upperCurve) {
+        const double t = (control[i] - lowerCurve) / (upperCurve - lowerCurve);
+        const double alpha = noise::SCurve3(t);
+        const double alphaDerivative = 6.0 * t * (1.0 - t) / (upperCurve - lowerCurve);
+        const double* a = sources[from];
+        const double* b = sources[to];
+        out[i] = noise::LinearInterp(a[i], b[i], alpha);
+        SetGradient(gradients, i, sourceGradients[from], 1.0 - alpha, sourceGradients[to], alpha);
+        const double controlFactor = alphaDerivative * (b[i] - a[i]);
+        gradients.x[i] += sourceGradients[2].x[i] * controlFactor;
+        gradients.y[i] += sourceGradients[2].y[i] * controlFactor;
+        gradients.z[i] += sourceGradients[2].z[i] * controlFactor;
+    };
+
+    if (m_edgeFalloff > 0.0) {
+        const double lowerCurve0 = (m_lowerBound - m_edgeFalloff);
+        const double upperCurve0 = (m_lowerBound + m_edgeFalloff);
+        const double lowerCurve1 = (m_upperBound - m_edgeFalloff);
+        const double upperCurve1 = (m_upperBound + m_edgeFalloff);
+        for (size_t i=0; i!=points.count; ++i) {
+            const double controlValue = control[i];
+            if (controlValue < lowerCurve0) {
+                out[i] = src0[i];
+                SetGradient(gradients, i, sourceGradients[0], 1.0);
+            } else if (controlValue < upperCurve0) {
+                blend(i, 0, 1, lowerCurve0, upperCurve0);
+            } else if (controlValue < lowerCurve1) {
+                out[i] = src1[i];
+                SetGradient(gradients, i, sourceGradients[1], 1.0);
+            } else if (controlValue < upperCurve1) {
+                blend(i, 1, 0, lowerCurve1, upperCurve1);
+            } else {
+                out[i] = src0[i];
+                SetGradient(gradients, i, sourceGradients[0], 1.0);
+            }
+        }
+    } else {
+        for (size_t i=0; i!=points.count; ++i) {
+            const double controlValue = control[i];
+            const size_t index = (controlValue < m_lowerBound || controlValue > m_upperBound) ? 0 : 1;
+            out[i] = sources[index][i];
+            SetGradient(gradients, i, sourceGradients[index], 1.0);
+        }
+    }
+}
+
+NoiseRange SelectNode::OnGetRange(const NoiseRange* sources) const {
+    if (const auto index = OnSelectSource(sources); index != NoSource) {
+        return sources[index];
+    }
+
+    const auto range = NoiseRange{std::min(sources[0].lower, sources[1].lower), std::max(sources[0].upper, sources[1].upper)};
+    // the interpolation of the equal values can differ from them in the last bit
+    return (m_edgeFalloff > 0.0) ? Widen(range) : range;
+}
+
+double SelectNode::OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const {
+    const double maxError = std::max(errors[0], errors[1]);
+    if (!(errors[2] > 0.0)) {
+        return maxError;
+    }
+
+    // the source is the same for all control values within the error
+    const std::array<NoiseRange, 3> widened = {sources[0], sources[1], NoiseRange{sources[2].lower - errors[2], sources[2].upper + errors[2]}};
+    if (const auto index = OnSelectSource(widened.data()); index != NoSource) {
+        return errors[index];
+    }
+
+    const double span = std::max(sources[0].upper, sources[1].upper) - std::min(sources[0].lower, sources[1].lower);
+    if (m_edgeFalloff > 0.0) {
+        // a + alpha * (b - a), alpha = SCurve3((control - curve) / (2 * falloff)), |SCurve3'| <= 1.5
+        return maxError + ScaleError(0.75 / m_edgeFalloff * span, errors[2]);
+    }
+
+    // the other source can be selected near the bounds
+    return maxError + span;
+}
+
+size_t SelectNode::OnSelectSource(const NoiseRange* sources) const {
+    // same conditions as in OnGetValues
+    const auto& control = sources[2];
+    if (m_edgeFalloff > 0.0) {
+        if ((control.upper < m_lowerBound - m_edgeFalloff) || (control.lower >= m_upperBound + m_edgeFalloff)) {
+            return 0;
+        }
+        if ((control.lower >= m_lowerBound + m_edgeFalloff) && (control.upper < m_upperBound - m_edgeFalloff)) {
+            return 1;
+        }
+    } else {
+        if ((control.upper < m_lowerBound) || (control.lower > m_upperBound)) {
+            return 0;
+        }
+        if ((control.lower >= m_lowerBound) && (control.upper <= m_upperBound)) {
+            return 1;
+        }
+    }
+
+    return NoSource;
+}
+
+NoiseAffine SelectNode::OnGetAffine(const double* const* /* constants */, const uint32_t* sourceIds) const {
+    // the interpolation of the equal values can differ from them in the last bit, so only without the edge falloff
+    return ((sourceIds[0] == sourceIds[1]) && !(m_edgeFalloff > 0.0)) ? NoiseAffine{0, 1.0, -0.0} : NoiseAffine();
+}
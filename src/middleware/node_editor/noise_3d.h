@@ -1,86 +1,305 @@
 #pragma once
 
+#include <cmath>
+#include <array>
+#include <limits>
+#include <cstdint>
+#include <memory>
 #include <noise.h>
 
 #include "middleware/node_editor/preview_node.h"
 
 
+// Precision of the evaluation of the fractal generators (Perlin, Billow, RidgedMulti), the other nodes
+// and the values passed between the nodes are always in double precision
+enum class NoisePrecision : uint8_t {
+    // same values as libnoise
+    Double,
+    // about twice faster, the deviation from Double is bounded, see BaseNoise3DNode::GetSinglePrecisionError
+    Single,
+};
+
+// Structure of arrays with the coordinates of the points for the batch evaluation
+struct NoisePoints {
+    const double* x = nullptr;
+    const double* y = nullptr;
+    const double* z = nullptr;
+    size_t count = 0;
+    // Distance between the neighbouring points, the fractal generators (Perlin, Billow, RidgedMulti)
+    // skip the octaves above the Nyquist limit of it, 0 - all octaves are evaluated
+    double spacing = 0;
+    NoisePrecision precision = NoisePrecision::Double;
+};
+
+// Structure of arrays with the partial derivatives of the values of a node by x, y and z,
+// see BaseNoise3DNode::GetGradients
+struct NoiseGradients {
+    double* x = nullptr;
+    double* y = nullptr;
+    double* z = nullptr;
+};
+
+// Conservative bounds of the values of a node, see BaseNoise3DNode::OnGetRange
+struct NoiseRange {
+    double lower = -std::numeric_limits<double>::infinity();
+    double upper = std::numeric_limits<double>::infinity();
+
+    // All values are equal to lower
+    bool IsConst() const noexcept { return std::isfinite(lower) && (lower >= upper); }
+};
+
+// The values of a node as the values of one source multiplied by scale plus bias, see BaseNoise3DNode::OnGetAffine
+struct NoiseAffine {
+    // index of the input pin, SIZE_MAX (BaseNoise3DNode::NoSource) - the node is not affine
+    size_t source = SIZE_MAX;
+    double scale = 1.0;
+    // -0 is the exact identity of the addition
+    double bias = -0.0;
+};
+
 class BaseNoise2DNode;
+class GraphJob;
+class NoiseProgram;
 class BaseNoise3DNode : public PreviewNode {
+    friend class GraphJob;
+    friend class NoiseProgram;
 protected:
     BaseNoise3DNode(noise::module::Module* module, const std::string& name);
 
+public:
+    // See OnSelectSource
+    static constexpr const size_t NoSource = SIZE_MAX;
+
 public:
     void SetSourceNode(BaseNode* srcNode, BasePin* dstPin) final;
-    void Update() final;
+    void DelSourceNode(BaseNode* srcNode, BasePin* dstPin) final;
+    void OnGraphChanged() final;
+    // The preview is evaluated by NodeScheduler together with the previews of the other noise nodes
+    void Update() final {}
 
     const noise::module::Module& GetModule() const { return *m_module; }
+    // Number of the input pins
+    size_t GetSourceCount() const { return static_cast<size_t>(m_module->GetSourceModuleCount()); }
+    // Returns nullptr if the input pin is not connected
+    const BaseNoise3DNode* GetSourceNode(size_t index) const { return m_sourceNodes[index]; }
+    // Returns nullptr if some input pin of the subgraph is not connected
+    std::shared_ptr<const NoiseProgram> GetProgram() const { return m_program; }
+    // Hash of the types and the parameters of the nodes of the subgraph and of the links between them,
+    // equal subgraphs have equal hashes, returns 0 if some input pin of the subgraph is not connected
+    size_t GetHash() const;
+
+    // Upper bound of the deviation of the values of the subgraph in NoisePrecision::Single from NoisePrecision::Double,
+    // see OnGetSinglePrecisionError, infinity if some input pin of the subgraph is not connected or the deviation is not bounded
+    double GetSinglePrecisionError() const;
+
+    // Evaluates the node for all points, out should contain points.count elements
+    // The values of every node of the subgraph are computed once per block of points and shared by all its consumers
+    // Throws EngineError if some input pin of the subgraph is not connected or OnGraphChanged was not called
+    void GetValues(const NoisePoints& points, double* out) const;
+
+    // Returns true if GetGradients is supported by the subgraph for the current parameters of the nodes,
+    // the nodes with the constant values are not asked (see CanGetGradients)
+    bool HasGradients() const;
+    // Evaluates the node and the partial derivatives of its values by x, y and z for all points, out and the arrays
+    // of gradients should contain points.count elements. The values are the same as GetValues in NoisePrecision::Double
+    // Throws EngineError if some input pin of the subgraph is not connected, OnGraphChanged was not called
+    // or HasGradients() is false
+    void GetGradients(const NoisePoints& points, double* out, const NoiseGradients& gradients) const;
 
 protected:
     bool DrawSettings() final;
 
     virtual bool OnDrawSettings() { return false; }
 
+    // sources[i] - values of the node connected to the input pin i for the same points (nullptr if not connected)
+    // Default implementation calls Module::GetValue for every point and does not use the sources
+    virtual void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const;
+    // Adds all parameters of the node that affect the values to the hash
+    virtual void OnHashParams(size_t& /* hash */) const {}
+
+    // sources[i] - bounds of the values of the node connected to the input pin i
+    // Returns the bounds of the values of the node, default implementation returns the unbounded range
+    virtual NoiseRange OnGetRange(const NoiseRange* sources) const;
+    // Only the nodes with CanSelectSource() are asked by OnSelectSource during the evaluation
+    virtual bool CanSelectSource() const { return false; }
+    // Returns the index of the input pin whose values are the values of the node for all points
+    // with the values of the sources within the bounds, NoSource if the values depend on several sources
+    virtual size_t OnSelectSource(const NoiseRange* /* sources */) const { return NoSource; }
+    // constants[i] - the value of the source i if it is constant, nullptr otherwise
+    // sourceIds[i] - id of the values of the source i, the sources with equal ids have equal values
+    // Returns the source if the values of the node are exactly source * scale + bias for all points
+    // (up to the sign of zero), NoiseAffine::source is NoSource otherwise, see NoiseProgram::Optimize
+    virtual NoiseAffine OnGetAffine(const double* const* /* constants */, const uint32_t* /* sourceIds */) const { return NoiseAffine(); }
+    // sources[i] - bounds of the values of the node connected to the input pin i (in NoisePrecision::Double),
+    // errors[i] - upper bound of the deviation of its values in NoisePrecision::Single from NoisePrecision::Double
+    // Returns the upper bound of the deviation of the values of the node, infinity if it is not bounded,
+    // default implementation returns 0 if all errors are 0 (the node is calculated in double precision) and infinity otherwise
+    virtual double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const;
+    // Returns true if the node implements OnGetGradients
+    virtual bool CanGetGradients() const { return false; }
+    // sourceGradients[i] - partial derivatives of the values of the source i for the same points
+    // Calculates the values as OnGetValues in NoisePrecision::Double and their partial derivatives by x, y and z,
+    // the derivative of a point where the values are not differentiable is the derivative of one side,
+    // default implementation throws EngineError
+    virtual void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const;
+
 private:
+    static constexpr const size_t MaxSourceCount = 3;
+
     noise::module::Module* m_module = nullptr;
+    // index - user index of the input pin
+    std::array<const BaseNoise3DNode*, MaxSourceCount> m_sourceNodes = {};
+    // recompiled on every change of the graph, nullptr until the first OnGraphChanged
+    // or if some input pin of the subgraph is not connected
+    std::shared_ptr<const NoiseProgram> m_program;
 };
 
 class BillowNode : public BaseNoise3DNode, private noise::module::Billow {
 public:
     BillowNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class CheckerboardNode : public BaseNoise3DNode, private noise::module::Checkerboard {
 public:
     CheckerboardNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
 };
 
 class ConstNode : public BaseNoise3DNode, private noise::module::Const {
 public:
     ConstNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class CylindersNode : public BaseNoise3DNode, private noise::module::Cylinders {
 public:
     CylindersNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class PerlinNode : public BaseNoise3DNode, private noise::module::Perlin {
 public:
     PerlinNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class RidgedMultiNode : public BaseNoise3DNode, private noise::module::RidgedMulti {
 public:
     RidgedMultiNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class SpheresNode : public BaseNoise3DNode, private noise::module::Spheres {
 public:
     SpheresNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class VoronoiNode : public BaseNoise3DNode, private noise::module::Voronoi {
 public:
     VoronoiNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class AbsNode : public BaseNoise3DNode, private noise::module::Abs {
 public:
     AbsNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
 };
 
 class ClampNode : public BaseNoise3DNode, private noise::module::Clamp {
 public:
     ClampNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    bool CanSelectSource() const override { return true; }
+    size_t OnSelectSource(const NoiseRange* sources) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 // TODO: Curve
@@ -88,17 +307,49 @@ class ExponentNode : public BaseNoise3DNode, private noise::module::Exponent {
 public:
     ExponentNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 class InvertNode : public BaseNoise3DNode, private noise::module::Invert {
 public:
     InvertNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
 };
 
 class ScaleBiasNode : public BaseNoise3DNode, private noise::module::ScaleBias {
 public:
     ScaleBiasNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
+    void OnHashParams(size_t& hash) const override;
 };
 
 // TODO: Terrace
@@ -106,30 +357,91 @@ public:
 class AddNode : public BaseNoise3DNode, private noise::module::Add {
 public:
     AddNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
 };
 
 class MaxNode : public BaseNoise3DNode, private noise::module::Max {
 public:
     MaxNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
+    bool CanSelectSource() const override { return true; }
+    size_t OnSelectSource(const NoiseRange* sources) const override;
 };
 
 class MinNode : public BaseNoise3DNode, private noise::module::Min {
 public:
     MinNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
+    bool CanSelectSource() const override { return true; }
+    size_t OnSelectSource(const NoiseRange* sources) const override;
 };
 
 class MultiplyNode : public BaseNoise3DNode, private noise::module::Multiply {
 public:
     MultiplyNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
 };
 
 class PowerNode : public BaseNoise3DNode, private noise::module::Power {
 public:
     PowerNode();
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
 };
 
 class SelectNode : public BaseNoise3DNode, private noise::module::Select {
 public:
     SelectNode();
     bool OnDrawSettings() override;
+    void SaveParams(ParamsWriter& writer) const override;
+    void LoadParams(ParamsReader& reader) override;
+
+protected:
+    void OnGetValues(const NoisePoints& points, const double* const* sources, double* out) const override;
+    bool CanGetGradients() const override { return true; }
+    void OnGetGradients(const NoisePoints& points, const double* const* sources, const NoiseGradients* sourceGradients,
+        double* out, const NoiseGradients& gradients) const override;
+    NoiseRange OnGetRange(const NoiseRange* sources) const override;
+    double OnGetSinglePrecisionError(const NoiseRange* sources, const double* errors) const override;
+    NoiseAffine OnGetAffine(const double* const* constants, const uint32_t* sourceIds) const override;
+    bool CanSelectSource() const override { return true; }
+    size_t OnSelectSource(const NoiseRange* sources) const override;
+    void OnHashParams(size_t& hash) const override;
 };
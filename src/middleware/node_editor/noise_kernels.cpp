@@ -0,0 +1,571 @@
+#include "middleware/node_editor/noise_kernels.h"
+
+#include <array>
+#include <cmath>
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include <vectortable.h>
+
+#include "engine/common/cpu_features.h"
+#include "middleware/node_editor/noise_3d.h"
+
+
+namespace kernel {
+
+static bool Fractal(detail::FractalType type, const FractalParams& params, const NoisePoints& points, double* out) {
+    // the table is rounded once, the single precision kernels gather the gradients from it
+    static const std::array<float, 256 * 4> randomVectorsSingle = []() {
+        std::array<float, 256 * 4> result;
+        for (size_t i=0; i!=result.size(); ++i) {
+            result[i] = static_cast<float>(noise::g_randomVectors[i]);
+        }
+        return result;
+    }();
+
+    const bool isSinglePrecision = (points.precision == NoisePrecision::Single);
+    const detail::FractalArgs args{type, params, noise::g_randomVectors, randomVectorsSingle.data(), isSinglePrecision};
+    switch (GetSimdLevel()) {
+        case SimdLevel::AVX2:
+            detail::FractalAVX2(args, points.x, points.y, points.z, out, points.count);
+            return true;
+        case SimdLevel::SSE41:
+            detail::FractalSSE41(args, points.x, points.y, points.z, out, points.count);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void CullOctaves(FractalParams& params, double spacing) {
+    if ((!(spacing > 0)) || (!(params.lacunarity > 1.0))) {
+        return;
+    }
+
+    // the frequencies of the neighbouring octaves differ by lacunarity times,
+    // so only one octave can be within [fadeStart, 0.5) cycles per sample
+    const double fadeStart = 0.5 / params.lacunarity;
+    double rate = params.frequency * spacing;
+    for (int octave=1; octave < params.octaveCount; ++octave) {
+        rate *= params.lacunarity;
+        if (rate >= 0.5) {
+            params.octaveCount = octave;
+            return;
+        }
+        if (rate > fadeStart) {
+            params.octaveCount = octave + 1;
+            params.lastOctaveWeight = (0.5 - rate) / (0.5 - fadeStart);
+            return;
+        }
+    }
+}
+
+bool Perlin(const FractalParams& params, const NoisePoints& points, double* out) {
+    return Fractal(detail::FractalType::Perlin, params, points, out);
+}
+
+bool Billow(const FractalParams& params, const NoisePoints& points, double* out) {
+    return Fractal(detail::FractalType::Billow, params, points, out);
+}
+
+bool RidgedMulti(const FractalParams& params, const NoisePoints& points, double* out) {
+    return Fractal(detail::FractalType::RidgedMulti, params, points, out);
+}
+
+// deviation of one octave in the single precision, see GetPerlinSingleError
+static double GetOctaveSingleError(noise::NoiseQuality quality) {
+    return (quality == noise::QUALITY_BEST) ? 2e-5 : 2e-6;
+}
+
+static double GetPersistenceSum(const FractalParams& params) {
+    double sum = 0;
+    double persistence = 1.0;
+    for (int i=0; i!=params.octaveCount; ++i) {
+        sum += std::fabs(persistence);
+        persistence *= params.persistence;
+    }
+
+    return sum;
+}
+
+double GetPerlinSingleError(const FractalParams& params) {
+    return GetOctaveSingleError(params.quality) * GetPersistenceSum(params);
+}
+
+double GetBillowSingleError(const FractalParams& params) {
+    return 2.0 * GetOctaveSingleError(params.quality) * GetPersistenceSum(params);
+}
+
+double GetRidgedMultiSingleError(const FractalParams& params) {
+    double sum = 0;
+    for (int i=0; i!=params.octaveCount; ++i) {
+        sum += std::fabs(params.spectralWeights[i]) * static_cast<double>(i + 1);
+    }
+
+    return 2.5 * GetOctaveSingleError(params.quality) * sum;
+}
+
+namespace {
+
+// constants of libnoise noisegen.cpp
+constexpr uint32_t X_NOISE_GEN = 1619;
+constexpr uint32_t Y_NOISE_GEN = 31337;
+constexpr uint32_t Z_NOISE_GEN = 6971;
+constexpr uint32_t SEED_NOISE_GEN = 1013;
+
+// The value and its partial derivatives by x, y and z
+struct Dual {
+    double value = 0;
+    std::array<double, 3> d = {};
+};
+
+// same as noise::SCurve3 and noise::SCurve5, derivative - the derivative by a
+double Interp(double a, noise::NoiseQuality quality, double& derivative) {
+    switch (quality) {
+        case noise::QUALITY_FAST:
+            derivative = 1.0;
+            return a;
+        case noise::QUALITY_STD:
+            derivative = 6.0 * a * (1.0 - a);
+            return (a * a) * (3.0 - 2.0 * a);
+        case noise::QUALITY_BEST: {
+            derivative = 30.0 * (a * a) * (a - 1.0) * (a - 1.0);
+            const double a3 = (a * a) * a;
+            const double a4 = a3 * a;
+            const double a5 = a4 * a;
+            return (6.0 * a5 - 15.0 * a4) + 10.0 * a3;
+        }
+    }
+
+    derivative = 0;
+    return 0;
+}
+
+// same as noise::LinearInterp, a depends only on the coordinate axis with the derivative da
+Dual LinearInterp(const Dual& n0, const Dual& n1, double a, double da, size_t axis) {
+    Dual result;
+    result.value = ((1.0 - a) * n0.value) + (a * n1.value);
+    for (size_t i=0; i!=3; ++i) {
+        result.d[i] = ((1.0 - a) * n0.d[i]) + (a * n1.d[i]);
+    }
+    result.d[axis] += da * (n1.value - n0.value);
+
+    return result;
+}
+
+// same as noise::GradientNoise3D, offset - (fx - ix, fy - iy, fz - iz)
+Dual GradientNoise3D(uint32_t hash, const std::array<double, 3>& offset) {
+    uint32_t index = hash ^ (hash >> 8);
+    index = (index & 0xff) << 2;
+    const double* gradient = noise::g_randomVectors + index;
+
+    Dual result;
+    result.value = ((gradient[0] * offset[0]) + (gradient[1] * offset[1]) + (gradient[2] * offset[2])) * 2.12;
+    for (size_t i=0; i!=3; ++i) {
+        result.d[i] = gradient[i] * 2.12;
+    }
+
+    return result;
+}
+
+// same as noise::GradientCoherentNoise3D(noise::MakeInt32Range(coord[i])...), the derivatives are by coord
+Dual GradientCoherentNoise3D(const std::array<double, 3>& coord, uint32_t seed, noise::NoiseQuality quality) {
+    const std::array<uint32_t, 3> gens = {X_NOISE_GEN, Y_NOISE_GEN, Z_NOISE_GEN};
+    std::array<uint32_t, 3> hash0;
+    std::array<double, 3> d0;
+    std::array<double, 3> d1;
+    std::array<double, 3> s;
+    std::array<double, 3> ds;
+    // the coordinates beyond the range are mapped by 2 * fmod
+    std::array<double, 3> factor;
+    for (size_t axis=0; axis!=3; ++axis) {
+        const double n = noise::MakeInt32Range(coord[axis]);
+        factor[axis] = (std::fabs(coord[axis]) >= 1073741824.0) ? 2.0 : 1.0;
+        const int cell = (n > 0.0) ? static_cast<int>(n) : static_cast<int>(n) - 1;
+        const auto c0 = static_cast<double>(cell);
+        hash0[axis] = static_cast<uint32_t>(cell) * gens[axis];
+        d0[axis] = n - c0;
+        d1[axis] = n - (c0 + 1.0);
+        s[axis] = Interp(d0[axis], quality, ds[axis]);
+    }
+    hash0[2] += SEED_NOISE_GEN * seed;
+
+    // corners in the order of libnoise
+    auto corner = [&hash0, &d0, &d1](uint32_t i, uint32_t j, uint32_t k) {
+        const uint32_t hash = (hash0[0] + i * X_NOISE_GEN) + ((hash0[1] + j * Y_NOISE_GEN) + (hash0[2] + k * Z_NOISE_GEN));
+        return GradientNoise3D(hash, {(i == 0) ? d0[0] : d1[0], (j == 0) ? d0[1] : d1[1], (k == 0) ? d0[2] : d1[2]});
+    };
+    const Dual iy0 = LinearInterp(
+        LinearInterp(corner(0, 0, 0), corner(1, 0, 0), s[0], ds[0], 0),
+        LinearInterp(corner(0, 1, 0), corner(1, 1, 0), s[0], ds[0], 0), s[1], ds[1], 1);
+    const Dual iy1 = LinearInterp(
+        LinearInterp(corner(0, 0, 1), corner(1, 0, 1), s[0], ds[0], 0),
+        LinearInterp(corner(0, 1, 1), corner(1, 1, 1), s[0], ds[0], 0), s[1], ds[1], 1);
+    Dual result = LinearInterp(iy0, iy1, s[2], ds[2], 2);
+    for (size_t axis=0; axis!=3; ++axis) {
+        result.d[axis] *= factor[axis];
+    }
+
+    return result;
+}
+
+// same as FractalKernel::Evaluate in the double precision, the derivatives are by the coordinates of the point
+Dual FractalGradient(detail::FractalType type, const FractalParams& params, double x, double y, double z) {
+    std::array<double, 3> coord = {x * params.frequency, y * params.frequency, z * params.frequency};
+    // derivative of coord by the coordinates of the point
+    double scale = params.frequency;
+
+    Dual result;
+    if (type == detail::FractalType::RidgedMulti) {
+        const double offset = 1.0;
+        const double gain = 2.0;
+        Dual weight;
+        weight.value = 1.0;
+        for (int curOctave = 0; curOctave < params.octaveCount; curOctave++) {
+            const auto seed = (static_cast<uint32_t>(params.seed) + static_cast<uint32_t>(curOctave)) & 0x7fffffffu;
+            const Dual noise = GradientCoherentNoise3D(coord, seed, params.quality);
+            const double sign = (noise.value < 0.0) ? -1.0 : 1.0;
+            double signal = std::fabs(noise.value);
+            signal = offset - signal;
+            const double base = signal;
+            signal *= signal;
+            const double square = signal;
+            signal *= weight.value;
+
+            const double octaveWeight = (curOctave + 1 == params.octaveCount) ? params.lastOctaveWeight : 1.0;
+            const double spectralWeight = params.spectralWeights[curOctave] * octaveWeight;
+            std::array<double, 3> dSignal;
+            for (size_t i=0; i!=3; ++i) {
+                dSignal[i] = 2.0 * base * (-sign * noise.d[i] * scale) * weight.value + square * weight.d[i];
+                result.d[i] += dSignal[i] * spectralWeight;
+            }
+
+            weight.value = signal * gain;
+            const bool isClamped = (weight.value > 1.0) || (weight.value < 0.0);
+            weight.value = std::max(std::min(weight.value, 1.0), 0.0);
+            for (size_t i=0; i!=3; ++i) {
+                weight.d[i] = isClamped ? 0.0 : dSignal[i] * gain;
+            }
+            result.value = result.value + signal * spectralWeight;
+
+            for (auto& c: coord) {
+                c *= params.lacunarity;
+            }
+            scale *= params.lacunarity;
+        }
+
+        result.value = (result.value * 1.25) - 1.0;
+        for (auto& d: result.d) {
+            d *= 1.25;
+        }
+
+        return result;
+    }
+
+    double curPersistence = 1.0;
+    for (int curOctave = 0; curOctave < params.octaveCount; curOctave++) {
+        const auto seed = static_cast<uint32_t>(params.seed) + static_cast<uint32_t>(curOctave);
+        Dual signal = GradientCoherentNoise3D(coord, seed, params.quality);
+        if (type == detail::FractalType::Billow) {
+            const double sign = (signal.value < 0.0) ? -1.0 : 1.0;
+            signal.value = (2.0 * std::fabs(signal.value)) - 1.0;
+            for (auto& d: signal.d) {
+                d *= 2.0 * sign;
+            }
+        }
+        const double octaveWeight = curPersistence * ((curOctave + 1 == params.octaveCount) ? params.lastOctaveWeight : 1.0);
+        result.value = result.value + signal.value * octaveWeight;
+        for (size_t i=0; i!=3; ++i) {
+            result.d[i] += signal.d[i] * scale * octaveWeight;
+        }
+
+        for (auto& c: coord) {
+            c *= params.lacunarity;
+        }
+        scale *= params.lacunarity;
+        curPersistence *= params.persistence;
+    }
+
+    if (type == detail::FractalType::Billow) {
+        result.value = result.value + 0.5;
+    }
+
+    return result;
+}
+
+void FractalGradients(detail::FractalType type, const FractalParams& params, const NoisePoints& points, double* out, const NoiseGradients& gradients) {
+    for (size_t i=0; i!=points.count; ++i) {
+        const Dual result = FractalGradient(type, params, points.x[i], points.y[i], points.z[i]);
+        out[i] = result.value;
+        gradients.x[i] = result.d[0];
+        gradients.y[i] = result.d[1];
+        gradients.z[i] = result.d[2];
+    }
+}
+
+}
+
+void PerlinGradients(const FractalParams& params, const NoisePoints& points, double* out, const NoiseGradients& gradients) {
+    FractalGradients(detail::FractalType::Perlin, params, points, out, gradients);
+}
+
+void BillowGradients(const FractalParams& params, const NoisePoints& points, double* out, const NoiseGradients& gradients) {
+    FractalGradients(detail::FractalType::Billow, params, points, out, gradients);
+}
+
+void RidgedMultiGradients(const FractalParams& params, const NoisePoints& points, double* out, const NoiseGradients& gradients) {
+    FractalGradients(detail::FractalType::RidgedMulti, params, points, out, gradients);
+}
+
+double GetGradientNoiseBound() {
+    // GradientNoise3D is the dot product of the gradient and the offset from the corner of the cell (|offset| <= sqrt(3)),
+    // scaled by 2.12, the interpolation of the corners does not leave the range of their values
+    static const double bound = []() {
+        double maxLength = 0;
+        for (size_t i=0; i!=256; ++i) {
+            const double* vector = noise::g_randomVectors + i * 4;
+            maxLength = std::max(maxLength, std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]));
+        }
+        // the margin covers the rounding errors
+        return 2.12 * std::sqrt(3.0) * maxLength * (1.0 + 1e-9);
+    }();
+
+    return bound;
+}
+
+namespace {
+
+// the initial minimal distance of libnoise
+constexpr const double VoronoiMaxDistance = 2147483647.0;
+// the cells from -VoronoiReach to VoronoiReach around the cell of the point are checked by libnoise
+constexpr const int VoronoiReach = 2;
+constexpr const int VoronoiWidth = VoronoiReach * 2 + 1;
+// the points are processed by chunks, the seed points of the cells of a chunk are cached
+constexpr const size_t VoronoiChunkSize = 256;
+// the maximum number of the cached cells per point of the chunk, the seed points of all cells of the bounding box
+// of the chunk are calculated in advance. For the points on a plane or on a line (the previews, the noise maps)
+// the box is thin and most of its cells are used by several points, for the scattered points
+// only the neighbourhood of the current point is cached
+constexpr const int64_t VoronoiMaxCellsPerPoint = 16;
+
+int ToCell(double coord) {
+    return coord > 0.0 ? static_cast<int>(coord) : static_cast<int>(coord) - 1;
+}
+
+// Seed points of the Voronoi cells
+class VoronoiCells {
+public:
+    explicit VoronoiCells(int seed)
+        : m_seed(seed) {
+    }
+
+    // Caches the seed points of the cells [lower - VoronoiReach, upper + VoronoiReach] if there are not too many of them
+    void SetBox(const std::array<int, 3>& lower, const std::array<int, 3>& upper, size_t pointCount) {
+        int64_t volume = 1;
+        for (size_t axis=0; axis!=3; ++axis) {
+            m_lower[axis] = static_cast<int64_t>(lower[axis]) - VoronoiReach;
+            m_size[axis] = static_cast<int64_t>(upper[axis]) - static_cast<int64_t>(lower[axis]) + VoronoiWidth;
+            volume *= std::min(m_size[axis], VoronoiMaxCellsPerPoint * static_cast<int64_t>(VoronoiChunkSize) + 1);
+        }
+        m_isBox = (volume <= VoronoiMaxCellsPerPoint * static_cast<int64_t>(pointCount));
+        if (!m_isBox) {
+            return;
+        }
+
+        m_points.resize(static_cast<size_t>(volume) * 3);
+        double* out = m_points.data();
+        for (int64_t z=m_lower[2]; z!=m_lower[2] + m_size[2]; ++z) {
+            for (int64_t y=m_lower[1]; y!=m_lower[1] + m_size[1]; ++y) {
+                for (int64_t x=m_lower[0]; x!=m_lower[0] + m_size[0]; ++x) {
+                    Calculate(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z), out);
+                    out += 3;
+                }
+            }
+        }
+    }
+
+    // The cells [cell - VoronoiReach, cell + VoronoiReach] are requested until the next call
+    void SetPoint(int xInt, int yInt, int zInt) {
+        if (!m_isBox) {
+            m_point = {xInt, yInt, zInt};
+            m_isCalculated.fill(false);
+        }
+    }
+
+    const double* Get(int x, int y, int z) {
+        if (m_isBox) {
+            const auto index = ((static_cast<int64_t>(z) - m_lower[2]) * m_size[1] + (static_cast<int64_t>(y) - m_lower[1])) * m_size[0] +
+                (static_cast<int64_t>(x) - m_lower[0]);
+            return m_points.data() + index * 3;
+        }
+
+        const auto index = static_cast<size_t>(((z - m_point[2] + VoronoiReach) * VoronoiWidth + (y - m_point[1] + VoronoiReach)) * VoronoiWidth +
+            (x - m_point[0] + VoronoiReach));
+        double* point = m_neighbourhood[index].data();
+        if (!m_isCalculated[index]) {
+            Calculate(x, y, z, point);
+            m_isCalculated[index] = true;
+        }
+
+        return point;
+    }
+
+private:
+    void Calculate(int x, int y, int z, double* point) const {
+        point[0] = static_cast<double>(x) + noise::ValueNoise3D(x, y, z, m_seed);
+        point[1] = static_cast<double>(y) + noise::ValueNoise3D(x, y, z, m_seed + 1);
+        point[2] = static_cast<double>(z) + noise::ValueNoise3D(x, y, z, m_seed + 2);
+    }
+
+private:
+    int m_seed;
+    bool m_isBox = false;
+    std::array<int64_t, 3> m_lower = {};
+    std::array<int64_t, 3> m_size = {};
+    std::vector<double> m_points;
+
+    std::array<int, 3> m_point = {};
+    std::array<bool, VoronoiWidth * VoronoiWidth * VoronoiWidth> m_isCalculated = {};
+    std::array<std::array<double, 3>, VoronoiWidth * VoronoiWidth * VoronoiWidth> m_neighbourhood = {};
+};
+
+// Square of the distance from the coordinate to the range of the seed points of the cell [cell - 1, cell + 1] along one axis.
+// Calculated by the same operations as the distance to the seed point (see GetDistance), the sum of the axes
+// in the same order is not greater than the calculated square of the distance to any seed point of the cell
+double GetCellDistance(double coord, int cell) {
+    const double lower = static_cast<double>(cell) - 1.0;
+    const double upper = static_cast<double>(cell) + 1.0;
+    double dist = 0;
+    if (lower > coord) {
+        dist = lower - coord;
+    } else if (coord > upper) {
+        dist = upper - coord;
+    }
+
+    return dist * dist;
+}
+
+double GetDistance(const double* point, double x, double y, double z) {
+    const double xDist = point[0] - x;
+    const double yDist = point[1] - y;
+    const double zDist = point[2] - z;
+    return xDist * xDist + yDist * yDist + zDist * zDist;
+}
+
+double VoronoiValue(const VoronoiParams& params, VoronoiCells& cells, double x, double y, double z) {
+    const int xInt = ToCell(x);
+    const int yInt = ToCell(y);
+    const int zInt = ToCell(z);
+    cells.SetPoint(xInt, yInt, zInt);
+
+    // the cells whose boxes are farther than the bound can not contain the nearest seed point (the distance is greater),
+    // the cells with the equal distance are not skipped, the first of them in the libnoise order is taken.
+    // The first bound is the distance to the nearest seed point of the cells xInt..xInt + 1 (the same for y and z),
+    // the boxes of these cells contain the point
+    double bound = VoronoiMaxDistance;
+    for (int zCur=zInt; zCur<=zInt + 1; ++zCur) {
+        for (int yCur=yInt; yCur<=yInt + 1; ++yCur) {
+            for (int xCur=xInt; xCur<=xInt + 1; ++xCur) {
+                bound = std::min(bound, GetDistance(cells.Get(xCur, yCur, zCur), x, y, z));
+            }
+        }
+    }
+
+    std::array<double, VoronoiWidth> xCellDist;
+    std::array<double, VoronoiWidth> yCellDist;
+    std::array<double, VoronoiWidth> zCellDist;
+    for (int i=0; i!=VoronoiWidth; ++i) {
+        xCellDist[static_cast<size_t>(i)] = GetCellDistance(x, xInt - VoronoiReach + i);
+        yCellDist[static_cast<size_t>(i)] = GetCellDistance(y, yInt - VoronoiReach + i);
+        zCellDist[static_cast<size_t>(i)] = GetCellDistance(z, zInt - VoronoiReach + i);
+    }
+
+    double minDist = VoronoiMaxDistance;
+    const double* candidate = nullptr;
+    for (size_t k=0; k!=VoronoiWidth; ++k) {
+        if (zCellDist[k] > bound) {
+            continue;
+        }
+        const int zCur = zInt - VoronoiReach + static_cast<int>(k);
+        for (size_t j=0; j!=VoronoiWidth; ++j) {
+            if (yCellDist[j] + zCellDist[k] > bound) {
+                continue;
+            }
+            const int yCur = yInt - VoronoiReach + static_cast<int>(j);
+            for (size_t i=0; i!=VoronoiWidth; ++i) {
+                if (xCellDist[i] + yCellDist[j] + zCellDist[k] > bound) {
+                    continue;
+                }
+                const double* point = cells.Get(xInt - VoronoiReach + static_cast<int>(i), yCur, zCur);
+                const double dist = GetDistance(point, x, y, z);
+                if (dist < minDist) {
+                    minDist = dist;
+                    candidate = point;
+                    bound = std::min(bound, dist);
+                }
+            }
+        }
+    }
+
+    const double xCandidate = (candidate != nullptr) ? candidate[0] : 0;
+    const double yCandidate = (candidate != nullptr) ? candidate[1] : 0;
+    const double zCandidate = (candidate != nullptr) ? candidate[2] : 0;
+    double value = 0;
+    if (params.enableDistance) {
+        const double xDist = xCandidate - x;
+        const double yDist = yCandidate - y;
+        const double zDist = zCandidate - z;
+        value = std::sqrt(xDist * xDist + yDist * yDist + zDist * zDist) * noise::SQRT_3 - 1.0;
+    }
+
+    return value + params.displacement * noise::ValueNoise3D(
+        static_cast<int>(std::floor(xCandidate)), static_cast<int>(std::floor(yCandidate)), static_cast<int>(std::floor(zCandidate)));
+}
+
+}
+
+void Voronoi(const VoronoiParams& params, const NoisePoints& points, double* out) {
+    VoronoiCells cells(params.seed);
+    for (size_t offset=0; offset<points.count; offset+=VoronoiChunkSize) {
+        const size_t count = std::min(VoronoiChunkSize, points.count - offset);
+        std::array<int, 3> lower = {INT_MAX, INT_MAX, INT_MAX};
+        std::array<int, 3> upper = {INT_MIN, INT_MIN, INT_MIN};
+        for (size_t i=offset; i!=offset + count; ++i) {
+            const std::array<int, 3> cell = {
+                ToCell(points.x[i] * params.frequency), ToCell(points.y[i] * params.frequency), ToCell(points.z[i] * params.frequency)};
+            for (size_t axis=0; axis!=3; ++axis) {
+                lower[axis] = std::min(lower[axis], cell[axis]);
+                upper[axis] = std::max(upper[axis], cell[axis]);
+            }
+        }
+        cells.SetBox(lower, upper, count);
+
+        for (size_t i=offset; i!=offset + count; ++i) {
+            out[i] = VoronoiValue(params, cells, points.x[i] * params.frequency, points.y[i] * params.frequency, points.z[i] * params.frequency);
+        }
+    }
+}
+
+void Colorize(const ColorLut& lut, const float* values, uint32_t* out, size_t count) {
+    switch (GetSimdLevel()) {
+        case SimdLevel::AVX2:
+            detail::ColorizeAVX2(lut, values, out, count);
+            return;
+        case SimdLevel::SSE41:
+            detail::ColorizeSSE41(lut, values, out, count);
+            return;
+        default:
+            break;
+    }
+
+    // the comparisons are written the same way as max/min of SSE, so NaN gives index 0
+    const float maxIndex = static_cast<float>(lut.size - 1);
+    for (size_t i=0; i!=count; ++i) {
+        float index = (values[i] - lut.lower) * lut.scale + 0.5f;
+        index = (index > 0.0f) ? index : 0.0f;
+        index = (index < maxIndex) ? index : maxIndex;
+        out[i] = lut.table[static_cast<uint32_t>(index)];
+    }
+}
+
+}
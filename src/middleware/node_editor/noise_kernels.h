@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <noise.h>
+
+
+// Vectorized versions of the libnoise coherent noise generators (Perlin, Billow, RidgedMulti).
+//
+// The kernels evaluate 4 (AVX2) or 2 (SSE4.1) points per instruction in double precision,
+// the CPU is checked at runtime. They repeat the libnoise 1.0 algorithm operation by operation
+// (including MakeInt32Range, the int conversion of the cell coordinates and the gradient table),
+// so for the same seed, octave count, frequency, lacunarity, persistence and NoiseQuality
+// the result is equal to noise::module::Perlin/Billow/RidgedMulti::GetValue.
+// Documented tolerance: |kernel - libnoise| <= 1e-12 * octaveCount, the difference can appear only
+// if libnoise itself was built with contracted (FMA) floating point operations.
+//
+// PerlinGradients, BillowGradients and RidgedMultiGradients are the scalar versions with the analytic partial derivatives
+// of the values, see BaseNoise3DNode::GetGradients.
+//
+// Voronoi repeats noise::module::Voronoi::GetValue with the same result for all points, it is scalar:
+// the seed points of the cells are shared by the neighbour points and the cells that can not contain
+// the nearest seed point are skipped, see Voronoi.
+//
+// Colorize converts a row of the noise map into packed RGBA8 colors using a baked color gradient,
+// 8 (AVX2) or 4 (SSE4.1) values per instruction, the result does not depend on the instruction set.
+
+struct NoisePoints;
+struct NoiseGradients;
+namespace kernel {
+
+struct FractalParams {
+    double frequency = 1.0;
+    double lacunarity = 2.0;
+    // not used by RidgedMulti
+    double persistence = 0.5;
+    // RidgedMulti only, octaveCount elements
+    const double* spectralWeights = nullptr;
+    int octaveCount = 6;
+    // the contribution of the last octave is multiplied by it, see CullOctaves
+    double lastOctaveWeight = 1.0;
+    int seed = 0;
+    noise::NoiseQuality quality = noise::QUALITY_STD;
+};
+
+// Removes the octaves whose frequency (frequency * lacunarity ^ octave) is above the Nyquist limit
+// of the points with the spacing (0.5 / spacing), the last kept octave is faded out linearly from limit / lacunarity
+// to the limit, so the result changes continuously with the spacing. The first octave is always kept.
+// spacing 0 keeps all octaves
+void CullOctaves(FractalParams& params, double spacing);
+
+// Return false if the CPU supports neither AVX2 nor SSE4.1, the caller should use libnoise in this case
+// (libnoise evaluates all octaves)
+bool Perlin(const FractalParams& params, const NoisePoints& points, double* out);
+bool Billow(const FractalParams& params, const NoisePoints& points, double* out);
+bool RidgedMulti(const FractalParams& params, const NoisePoints& points, double* out);
+
+// Same values as Perlin, Billow and RidgedMulti in NoisePrecision::Double (points.precision is not used)
+// and their partial derivatives by x, y and z. The derivative of a point where the values are not differentiable
+// (the kinks of the absolute value in Billow and RidgedMulti, the clamped weights of RidgedMulti) is the derivative of one side.
+// The derivatives of the coordinates beyond MakeInt32Range are doubled, as the coordinates are
+void PerlinGradients(const FractalParams& params, const NoisePoints& points, double* out, const NoiseGradients& gradients);
+void BillowGradients(const FractalParams& params, const NoisePoints& points, double* out, const NoiseGradients& gradients);
+void RidgedMultiGradients(const FractalParams& params, const NoisePoints& points, double* out, const NoiseGradients& gradients);
+
+// Upper bounds of the deviation of the values in the single precision (NoisePrecision::Single) from the double precision
+// for any points. The deviation of one octave is at most E = 2e-6 for QUALITY_FAST and QUALITY_STD and 2e-5 for QUALITY_BEST
+// (the measured maximum over 4 * 10^5 random points with the coordinates up to 10^6 is 3.6e-7 and 4.5e-6),
+// it does not depend on the coordinates, because the lattice is calculated in double precision:
+//   Perlin: E * sum |persistence ^ i|
+//   Billow: 2 * E * sum |persistence ^ i|
+//   RidgedMulti: 2.5 * E * sum |spectralWeights[i]| * (i + 1), the deviation of the weight of every octave is carried
+//   to the next octaves, the measured deviation grows linearly with the octave count
+// The fields frequency, lacunarity and seed are not used
+double GetPerlinSingleError(const FractalParams& params);
+double GetBillowSingleError(const FractalParams& params);
+double GetRidgedMultiSingleError(const FractalParams& params);
+
+// Upper bound of the absolute value of one octave (noise::GradientCoherentNoise3D) for any quality,
+// the ranges of the values of Perlin, Billow and RidgedMulti are derived from it
+double GetGradientNoiseBound();
+
+struct VoronoiParams {
+    double frequency = 1.0;
+    double displacement = 1.0;
+    int seed = 0;
+    bool enableDistance = false;
+};
+
+// The result is equal to noise::module::Voronoi::GetValue for the same parameters.
+// libnoise checks the 5x5x5 cells around the point. The seed point of a cell is within 1 from the corner
+// of the cell along every axis, so a cell is skipped if this box is farther than the nearest seed point found so far
+// (the 8 cells whose boxes contain the point are taken first), the other cells are checked in the libnoise order,
+// so the ties are resolved in the same way. The seed points of the cells are calculated once per chunk of 256 points
+// if the chunk is compact (a row of the noise map), otherwise once per point
+void Voronoi(const VoronoiParams& params, const NoisePoints& points, double* out);
+
+// Baked color gradient: table[i] - packed RGBA8 color at the position lower + i / scale
+struct ColorLut {
+    const uint32_t* table = nullptr;
+    // >= 2
+    uint32_t size = 0;
+    float lower = 0;
+    float scale = 0;
+};
+
+// out[i] = table[index], index = (values[i] - lower) * scale + 0.5 rounded to zero and clamped to [0, size - 1]
+void Colorize(const ColorLut& lut, const float* values, uint32_t* out, size_t count);
+
+namespace detail {
+    enum class FractalType : uint8_t {
+        Perlin,
+        Billow,
+        RidgedMulti,
+    };
+
+    struct FractalArgs {
+        FractalType type;
+        FractalParams params;
+        // noise::g_randomVectors
+        const double* randomVectors;
+        // noise::g_randomVectors rounded to float
+        const float* randomVectorsSingle;
+        // see NoisePrecision::Single
+        bool isSinglePrecision;
+    };
+
+    // compiled with -msse4.1 and -mavx2 in separate translation units
+    void FractalSSE41(const FractalArgs& args, const double* x, const double* y, const double* z, double* out, size_t count);
+    void FractalAVX2(const FractalArgs& args, const double* x, const double* y, const double* z, double* out, size_t count);
+
+    void ColorizeSSE41(const ColorLut& lut, const float* values, uint32_t* out, size_t count);
+    void ColorizeAVX2(const ColorLut& lut, const float* values, uint32_t* out, size_t count);
+}
+
+}
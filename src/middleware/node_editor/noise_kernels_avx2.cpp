@@ -0,0 +1,142 @@
+#include "middleware/node_editor/noise_kernels.h"
+
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+
+namespace {
+
+struct AVX2Single {
+    using Scalar = float;
+    using D = __m256;
+    using I = __m256i;
+    static constexpr const size_t Lanes = 8;
+
+    static void Store(float* p, D v) { _mm256_storeu_ps(p, v); }
+    static D Set1(double v) { return _mm256_set1_ps(static_cast<float>(v)); }
+
+    static D Add(D a, D b) { return _mm256_add_ps(a, b); }
+    static D Sub(D a, D b) { return _mm256_sub_ps(a, b); }
+    static D Mul(D a, D b) { return _mm256_mul_ps(a, b); }
+    static D Min(D a, D b) { return _mm256_min_ps(a, b); }
+    static D Max(D a, D b) { return _mm256_max_ps(a, b); }
+    static D Abs(D v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+
+    static I Set1I(int32_t v) { return _mm256_set1_epi32(v); }
+    static I AddI(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I MulI(I a, I b) { return _mm256_mullo_epi32(a, b); }
+    static I XorI(I a, I b) { return _mm256_xor_si256(a, b); }
+    static I AndI(I a, I b) { return _mm256_and_si256(a, b); }
+    static I ShiftRightI8(I v) { return _mm256_srai_epi32(v, 8); }
+    static I ShiftLeftI2(I v) { return _mm256_slli_epi32(v, 2); }
+
+    static D Gather(const float* table, I index) {
+        // the masked version does not read an undefined source register
+        const D mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), table, index, mask, 4);
+    }
+
+    // lo - lanes 0-3, hi - lanes 4-7
+    static D Join(__m256d lo, __m256d hi) { return _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo)); }
+    static I JoinI(__m128i lo, __m128i hi) { return _mm256_set_m128i(hi, lo); }
+};
+
+struct AVX2 {
+    using Scalar = double;
+    using Single = AVX2Single;
+    using D = __m256d;
+    using I = __m128i;
+    static constexpr const size_t Lanes = 4;
+
+    static D Load(const double* p) { return _mm256_loadu_pd(p); }
+    static void Store(double* p, D v) { _mm256_storeu_pd(p, v); }
+    static D Set1(double v) { return _mm256_set1_pd(v); }
+
+    static D Add(D a, D b) { return _mm256_add_pd(a, b); }
+    static D Sub(D a, D b) { return _mm256_sub_pd(a, b); }
+    static D Mul(D a, D b) { return _mm256_mul_pd(a, b); }
+    static D Min(D a, D b) { return _mm256_min_pd(a, b); }
+    static D Max(D a, D b) { return _mm256_max_pd(a, b); }
+    static D Abs(D v) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v); }
+
+    static bool AnyAbsGreaterOrEqual(D v, double limit) {
+        return _mm256_movemask_pd(_mm256_cmp_pd(Abs(v), _mm256_set1_pd(limit), _CMP_GE_OQ)) != 0;
+    }
+
+    // (x > 0.0? (int)x: (int)x - 1)
+    static D CellFloor(D v) {
+        D truncated = _mm256_round_pd(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        D positive = _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_GT_OQ);
+        return _mm256_sub_pd(truncated, _mm256_andnot_pd(positive, _mm256_set1_pd(1.0)));
+    }
+
+    static I ToInt(D v) { return _mm256_cvttpd_epi32(v); }
+    static I Set1I(int32_t v) { return _mm_set1_epi32(v); }
+    static I AddI(I a, I b) { return _mm_add_epi32(a, b); }
+    static I MulI(I a, I b) { return _mm_mullo_epi32(a, b); }
+    static I XorI(I a, I b) { return _mm_xor_si128(a, b); }
+    static I AndI(I a, I b) { return _mm_and_si128(a, b); }
+    static I ShiftRightI8(I v) { return _mm_srai_epi32(v, 8); }
+    static I ShiftLeftI2(I v) { return _mm_slli_epi32(v, 2); }
+
+    static D Gather(const double* table, I index) {
+        // the masked version does not read an undefined source register
+        const D mask = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table, index, mask, 8);
+    }
+};
+
+}
+
+#include "middleware/node_editor/noise_kernels_simd.h"
+
+
+namespace kernel {
+namespace detail {
+
+void FractalAVX2(const FractalArgs& args, const double* x, const double* y, const double* z, double* out, size_t count) {
+    FractalKernel<AVX2>::Run(args, x, y, z, out, count);
+}
+
+void ColorizeAVX2(const ColorLut& lut, const float* values, uint32_t* out, size_t count) {
+    const __m256 lower = _mm256_set1_ps(lut.lower);
+    const __m256 scale = _mm256_set1_ps(lut.scale);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 maxIndex = _mm256_set1_ps(static_cast<float>(lut.size - 1));
+    const int* table = reinterpret_cast<const int*>(lut.table);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 index = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(values + i), lower), scale), half);
+        index = _mm256_min_ps(_mm256_max_ps(index, _mm256_setzero_ps()), maxIndex);
+        // masked for the same reason as AVX2::Gather
+        const __m256i colors = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), table, _mm256_cvttps_epi32(index), _mm256_set1_epi32(-1), 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), colors);
+    }
+
+    ColorizeTail(lut, values + i, out + i, count - i);
+}
+
+}
+}
+
+#else
+
+// the kernel is called only if GetSimdLevel() reports the support of AVX2
+namespace kernel {
+namespace detail {
+
+void FractalAVX2(const FractalArgs&, const double*, const double*, const double*, double*, size_t) {
+
+}
+
+void ColorizeAVX2(const ColorLut&, const float*, uint32_t*, size_t) {
+
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,340 @@
+#pragma once
+
+// Common code of the SIMD kernels, included only by noise_kernels_sse41.cpp and noise_kernels_avx2.cpp
+// after the definition of the vector type V:
+//   V::D - vector of V::Lanes doubles, V::I - vector of (at least) V::Lanes int32,
+//   V::Single - the same operations for the vector V::Single::D of 2 * V::Lanes floats and the vector V::Single::I
+//   of 2 * V::Lanes int32, Join and JoinI convert two vectors of V to one vector of V::Single.
+// Everything is in the anonymous namespace and the standard library templates are not used,
+// because these translation units are compiled with different instruction sets.
+
+#include <cmath>
+#include <cstring>
+
+#include "middleware/node_editor/noise_kernels.h"
+
+
+namespace {
+
+// constants of libnoise noisegen.cpp
+constexpr int32_t X_NOISE_GEN = 1619;
+constexpr int32_t Y_NOISE_GEN = 31337;
+constexpr int32_t Z_NOISE_GEN = 6971;
+constexpr int32_t SEED_NOISE_GEN = 1013;
+
+// libnoise multiplies and adds int values with overflow, here it is done without UB
+inline int32_t WrapMul(int32_t a, int32_t b) noexcept {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+}
+
+inline int32_t WrapAdd(int32_t a, int32_t b) noexcept {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+
+// same as the scalar version of kernel::Colorize, used for the tails of the rows
+inline void ColorizeTail(const kernel::ColorLut& lut, const float* values, uint32_t* out, size_t count) {
+    const float maxIndex = static_cast<float>(lut.size - 1);
+    for (size_t i=0; i!=count; ++i) {
+        float index = (values[i] - lut.lower) * lut.scale + 0.5f;
+        index = (index > 0.0f) ? index : 0.0f;
+        index = (index < maxIndex) ? index : maxIndex;
+        out[i] = lut.table[static_cast<uint32_t>(index)];
+    }
+}
+
+// Gradient noise of the cells with the known lattice, V can be a vector of doubles or floats (V::Scalar)
+template <typename V> struct GradientKernel {
+    using D = typename V::D;
+    using I = typename V::I;
+    using Scalar = typename V::Scalar;
+
+    static D SCurve3(D a) {
+        return V::Mul(V::Mul(a, a), V::Sub(V::Set1(3.0), V::Mul(V::Set1(2.0), a)));
+    }
+
+    static D SCurve5(D a) {
+        D a3 = V::Mul(V::Mul(a, a), a);
+        D a4 = V::Mul(a3, a);
+        D a5 = V::Mul(a4, a);
+        return V::Add(V::Sub(V::Mul(V::Set1(6.0), a5), V::Mul(V::Set1(15.0), a4)), V::Mul(V::Set1(10.0), a3));
+    }
+
+    static D LinearInterp(D n0, D n1, D a) {
+        return V::Add(V::Mul(V::Sub(V::Set1(1.0), a), n0), V::Mul(a, n1));
+    }
+
+    static D Interp(D a, noise::NoiseQuality quality) {
+        switch (quality) {
+            case noise::QUALITY_FAST: return a;
+            case noise::QUALITY_STD: return SCurve3(a);
+            case noise::QUALITY_BEST: return SCurve5(a);
+            default: return V::Set1(0.0);
+        }
+    }
+
+    // same as noise::GradientNoise3D, hash = X_NOISE_GEN * ix + Y_NOISE_GEN * iy + Z_NOISE_GEN * iz + SEED_NOISE_GEN * seed,
+    // (xd, yd, zd) = (fx - ix, fy - iy, fz - iz)
+    static D GradientNoise3D(const Scalar* randomVectors, I hash, D xd, D yd, D zd) {
+        I index = V::XorI(hash, V::ShiftRightI8(hash));
+        index = V::AndI(index, V::Set1I(0xff));
+        index = V::ShiftLeftI2(index);
+
+        D xGradient = V::Gather(randomVectors, index);
+        D yGradient = V::Gather(randomVectors + 1, index);
+        D zGradient = V::Gather(randomVectors + 2, index);
+
+        return V::Mul(V::Add(V::Add(V::Mul(xGradient, xd), V::Mul(yGradient, yd)), V::Mul(zGradient, zd)), V::Set1(2.12));
+    }
+
+    // same as noise::GradientCoherentNoise3D after the calculation of the cell:
+    // hx0, hy0, hz0 - hash terms of the lower corner (X_NOISE_GEN * x0, Y_NOISE_GEN * y0, Z_NOISE_GEN * z0 + SEED_NOISE_GEN * seed),
+    // xd0, yd0, zd0 - offsets of the point from the lower corner, xd1, yd1, zd1 - from the upper corner
+    static D Evaluate(const Scalar* randomVectors, I hx0, I hy0, I hz0, D xd0, D yd0, D zd0, D xd1, D yd1, D zd1, noise::NoiseQuality quality) {
+        D xs = Interp(xd0, quality);
+        D ys = Interp(yd0, quality);
+        D zs = Interp(zd0, quality);
+
+        // the hash is linear in every coordinate
+        I hx1 = V::AddI(hx0, V::Set1I(X_NOISE_GEN));
+        I hy1 = V::AddI(hy0, V::Set1I(Y_NOISE_GEN));
+        I hz1 = V::AddI(hz0, V::Set1I(Z_NOISE_GEN));
+
+        D n0, n1, ix0, ix1, iy0, iy1;
+        I h00 = V::AddI(hy0, hz0);
+        n0  = GradientNoise3D(randomVectors, V::AddI(hx0, h00), xd0, yd0, zd0);
+        n1  = GradientNoise3D(randomVectors, V::AddI(hx1, h00), xd1, yd0, zd0);
+        ix0 = LinearInterp(n0, n1, xs);
+        I h10 = V::AddI(hy1, hz0);
+        n0  = GradientNoise3D(randomVectors, V::AddI(hx0, h10), xd0, yd1, zd0);
+        n1  = GradientNoise3D(randomVectors, V::AddI(hx1, h10), xd1, yd1, zd0);
+        ix1 = LinearInterp(n0, n1, xs);
+        iy0 = LinearInterp(ix0, ix1, ys);
+        I h01 = V::AddI(hy0, hz1);
+        n0  = GradientNoise3D(randomVectors, V::AddI(hx0, h01), xd0, yd0, zd1);
+        n1  = GradientNoise3D(randomVectors, V::AddI(hx1, h01), xd1, yd0, zd1);
+        ix0 = LinearInterp(n0, n1, xs);
+        I h11 = V::AddI(hy1, hz1);
+        n0  = GradientNoise3D(randomVectors, V::AddI(hx0, h11), xd0, yd1, zd1);
+        n1  = GradientNoise3D(randomVectors, V::AddI(hx1, h11), xd1, yd1, zd1);
+        ix1 = LinearInterp(n0, n1, xs);
+        iy1 = LinearInterp(ix0, ix1, ys);
+
+        return LinearInterp(iy0, iy1, zs);
+    }
+};
+
+// V - vector of doubles, V::Single - vector of 2 * V::Lanes floats.
+// The double precision path repeats libnoise, the single precision path calculates the lattice
+// (the scaled coordinates, the cells and the offsets in the cells) in double precision as libnoise
+// and the gradients, the interpolation and the sum of the octaves in single precision,
+// so its error does not grow with the coordinates, see kernel::GetSinglePrecisionError
+template <typename V> struct FractalKernel {
+    using D = typename V::D;
+    using I = typename V::I;
+    using S = typename V::Single;
+    using FractalArgs = kernel::detail::FractalArgs;
+    using FractalType = kernel::detail::FractalType;
+
+    // N vectors of doubles per coordinate: 1 for the double precision path, 2 for the single precision path
+    template <size_t N> struct Point {
+        D x[N];
+        D y[N];
+        D z[N];
+
+        void Scale(D factor) {
+            for (size_t i=0; i!=N; ++i) {
+                x[i] = V::Mul(x[i], factor);
+                y[i] = V::Mul(y[i], factor);
+                z[i] = V::Mul(z[i], factor);
+            }
+        }
+    };
+
+    // same as noise::MakeInt32Range, the rare out of range lanes are processed one by one
+    static D MakeInt32Range(D n) {
+        if (!V::AnyAbsGreaterOrEqual(n, 1073741824.0)) {
+            return n;
+        }
+
+        double values[V::Lanes];
+        V::Store(values, n);
+        for (size_t i=0; i!=V::Lanes; ++i) {
+            if (values[i] >= 1073741824.0) {
+                values[i] = (2.0 * std::fmod(values[i], 1073741824.0)) - 1073741824.0;
+            } else if (values[i] <= -1073741824.0) {
+                values[i] = (2.0 * std::fmod(values[i], 1073741824.0)) + 1073741824.0;
+            }
+        }
+
+        return V::Load(values);
+    }
+
+    // cell of the coordinate as in noise::GradientCoherentNoise3D:
+    // cell - (x > 0.0? (int)x: (int)x - 1), d0 - offset from the lower corner, d1 - from the upper corner
+    static void Lattice(D coord, I& cell, D& d0, D& d1) {
+        coord = MakeInt32Range(coord);
+        D c0 = V::CellFloor(coord);
+        cell = V::ToInt(c0);
+        d0 = V::Sub(coord, c0);
+        d1 = V::Sub(coord, V::Add(c0, V::Set1(1.0)));
+    }
+
+    // same as noise::GradientCoherentNoise3D
+    static D Noise(const FractalArgs& args, const Point<1>& point, int32_t seed) {
+        I x0, y0, z0;
+        D xd0, yd0, zd0, xd1, yd1, zd1;
+        Lattice(point.x[0], x0, xd0, xd1);
+        Lattice(point.y[0], y0, yd0, yd1);
+        Lattice(point.z[0], z0, zd0, zd1);
+
+        I hx0 = V::MulI(x0, V::Set1I(X_NOISE_GEN));
+        I hy0 = V::MulI(y0, V::Set1I(Y_NOISE_GEN));
+        I hz0 = V::AddI(V::MulI(z0, V::Set1I(Z_NOISE_GEN)), V::Set1I(WrapMul(SEED_NOISE_GEN, seed)));
+
+        return GradientKernel<V>::Evaluate(args.randomVectors, hx0, hy0, hz0, xd0, yd0, zd0, xd1, yd1, zd1, args.params.quality);
+    }
+
+    // single precision version, the lanes 0..V::Lanes-1 are in the vectors 0 of the point
+    static typename S::D Noise(const FractalArgs& args, const Point<2>& point, int32_t seed) {
+        const D* coords[3] = {point.x, point.y, point.z};
+        const int32_t gens[3] = {X_NOISE_GEN, Y_NOISE_GEN, Z_NOISE_GEN};
+        typename S::I hash[3];
+        typename S::D d0[3];
+        typename S::D d1[3];
+        for (size_t axis=0; axis!=3; ++axis) {
+            I cell[2];
+            D lower[2];
+            D upper[2];
+            Lattice(coords[axis][0], cell[0], lower[0], upper[0]);
+            Lattice(coords[axis][1], cell[1], lower[1], upper[1]);
+            hash[axis] = S::MulI(S::JoinI(cell[0], cell[1]), S::Set1I(gens[axis]));
+            d0[axis] = S::Join(lower[0], lower[1]);
+            d1[axis] = S::Join(upper[0], upper[1]);
+        }
+        hash[2] = S::AddI(hash[2], S::Set1I(WrapMul(SEED_NOISE_GEN, seed)));
+
+        return GradientKernel<S>::Evaluate(args.randomVectorsSingle, hash[0], hash[1], hash[2], d0[0], d0[1], d0[2], d1[0], d1[1], d1[2], args.params.quality);
+    }
+
+    // same as noise::module::Perlin::GetValue, Billow::GetValue and RidgedMulti::GetValue,
+    // the weight of the last octave is 1 unless the octaves are culled (see kernel::CullOctaves)
+    // R - V for the double precision path (N = 1), S for the single precision path (N = 2)
+    template <typename R, size_t N> static typename R::D Evaluate(const FractalArgs& args, Point<N> point) {
+        using RD = typename R::D;
+        const kernel::FractalParams& params = args.params;
+        const D lacunarity = V::Set1(params.lacunarity);
+        point.Scale(V::Set1(params.frequency));
+
+        RD value = R::Set1(0.0);
+        if (args.type == FractalType::RidgedMulti) {
+            const RD offset = R::Set1(1.0);
+            const RD gain = R::Set1(2.0);
+            RD weight = R::Set1(1.0);
+            for (int curOctave = 0; curOctave < params.octaveCount; curOctave++) {
+                const int32_t seed = WrapAdd(params.seed, curOctave) & 0x7fffffff;
+                RD signal = Noise(args, point, seed);
+                signal = R::Abs(signal);
+                signal = R::Sub(offset, signal);
+                signal = R::Mul(signal, signal);
+                signal = R::Mul(signal, weight);
+                weight = R::Mul(signal, gain);
+                weight = R::Max(R::Min(weight, R::Set1(1.0)), R::Set1(0.0));
+                const double octaveWeight = (curOctave + 1 == params.octaveCount) ? params.lastOctaveWeight : 1.0;
+                value = R::Add(value, R::Mul(signal, R::Set1(params.spectralWeights[curOctave] * octaveWeight)));
+
+                point.Scale(lacunarity);
+            }
+
+            return R::Sub(R::Mul(value, R::Set1(1.25)), R::Set1(1.0));
+        }
+
+        double curPersistence = 1.0;
+        for (int curOctave = 0; curOctave < params.octaveCount; curOctave++) {
+            const int32_t seed = WrapAdd(params.seed, curOctave);
+            RD signal = Noise(args, point, seed);
+            if (args.type == FractalType::Billow) {
+                signal = R::Sub(R::Mul(R::Set1(2.0), R::Abs(signal)), R::Set1(1.0));
+            }
+            const double octaveWeight = (curOctave + 1 == params.octaveCount) ? params.lastOctaveWeight : 1.0;
+            value = R::Add(value, R::Mul(signal, R::Set1(curPersistence * octaveWeight)));
+
+            point.Scale(lacunarity);
+            curPersistence *= params.persistence;
+        }
+
+        if (args.type == FractalType::Billow) {
+            value = R::Add(value, R::Set1(0.5));
+        }
+
+        return value;
+    }
+
+    static void RunDouble(const FractalArgs& args, const double* x, const double* y, const double* z, double* out, size_t count) {
+        size_t i = 0;
+        for (; i + V::Lanes <= count; i += V::Lanes) {
+            const Point<1> point{{V::Load(x + i)}, {V::Load(y + i)}, {V::Load(z + i)}};
+            V::Store(out + i, Evaluate<V>(args, point));
+        }
+
+        if (i == count) {
+            return;
+        }
+
+        // the tail is padded with the last point
+        double tail[3][V::Lanes];
+        double result[V::Lanes];
+        const size_t rest = count - i;
+        for (size_t j=0; j!=V::Lanes; ++j) {
+            const size_t src = i + ((j < rest) ? j : (rest - 1));
+            tail[0][j] = x[src];
+            tail[1][j] = y[src];
+            tail[2][j] = z[src];
+        }
+        const Point<1> point{{V::Load(tail[0])}, {V::Load(tail[1])}, {V::Load(tail[2])}};
+        V::Store(result, Evaluate<V>(args, point));
+        std::memcpy(out + i, result, rest * sizeof(double));
+    }
+
+    static void RunSingle(const FractalArgs& args, const double* x, const double* y, const double* z, double* out, size_t count) {
+        constexpr size_t Lanes = S::Lanes;
+        float result[Lanes];
+        double tail[3][Lanes];
+        for (size_t i=0; i < count; i += Lanes) {
+            const double* px = x + i;
+            const double* py = y + i;
+            const double* pz = z + i;
+            const size_t rest = (count - i < Lanes) ? count - i : Lanes;
+            if (rest != Lanes) {
+                // the tail is padded with the last point
+                for (size_t j=0; j!=Lanes; ++j) {
+                    const size_t src = i + ((j < rest) ? j : (rest - 1));
+                    tail[0][j] = x[src];
+                    tail[1][j] = y[src];
+                    tail[2][j] = z[src];
+                }
+                px = tail[0];
+                py = tail[1];
+                pz = tail[2];
+            }
+
+            const Point<2> point{
+                {V::Load(px), V::Load(px + V::Lanes)},
+                {V::Load(py), V::Load(py + V::Lanes)},
+                {V::Load(pz), V::Load(pz + V::Lanes)}};
+            S::Store(result, Evaluate<S>(args, point));
+            for (size_t j=0; j!=rest; ++j) {
+                out[i + j] = static_cast<double>(result[j]);
+            }
+        }
+    }
+
+    static void Run(const FractalArgs& args, const double* x, const double* y, const double* z, double* out, size_t count) {
+        if (args.isSinglePrecision) {
+            RunSingle(args, x, y, z, out, count);
+        } else {
+            RunDouble(args, x, y, z, out, count);
+        }
+    }
+};
+
+}
@@ -0,0 +1,142 @@
+#include "middleware/node_editor/noise_kernels.h"
+
+
+#if defined(__SSE4_1__)
+
+#include <smmintrin.h>
+
+
+namespace {
+
+struct SSE41Single {
+    using Scalar = float;
+    using D = __m128;
+    using I = __m128i;
+    static constexpr const size_t Lanes = 4;
+
+    static void Store(float* p, D v) { _mm_storeu_ps(p, v); }
+    static D Set1(double v) { return _mm_set1_ps(static_cast<float>(v)); }
+
+    static D Add(D a, D b) { return _mm_add_ps(a, b); }
+    static D Sub(D a, D b) { return _mm_sub_ps(a, b); }
+    static D Mul(D a, D b) { return _mm_mul_ps(a, b); }
+    static D Min(D a, D b) { return _mm_min_ps(a, b); }
+    static D Max(D a, D b) { return _mm_max_ps(a, b); }
+    static D Abs(D v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+
+    static I Set1I(int32_t v) { return _mm_set1_epi32(v); }
+    static I AddI(I a, I b) { return _mm_add_epi32(a, b); }
+    static I MulI(I a, I b) { return _mm_mullo_epi32(a, b); }
+    static I XorI(I a, I b) { return _mm_xor_si128(a, b); }
+    static I AndI(I a, I b) { return _mm_and_si128(a, b); }
+    static I ShiftRightI8(I v) { return _mm_srai_epi32(v, 8); }
+    static I ShiftLeftI2(I v) { return _mm_slli_epi32(v, 2); }
+
+    static D Gather(const float* table, I index) {
+        return _mm_set_ps(table[_mm_extract_epi32(index, 3)], table[_mm_extract_epi32(index, 2)],
+            table[_mm_extract_epi32(index, 1)], table[_mm_extract_epi32(index, 0)]);
+    }
+
+    // lo - lanes 0-1, hi - lanes 2-3, _mm_cvttpd_epi32 stores the ints in the lanes 0-1
+    static D Join(__m128d lo, __m128d hi) { return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)); }
+    static I JoinI(__m128i lo, __m128i hi) { return _mm_unpacklo_epi64(lo, hi); }
+};
+
+struct SSE41 {
+    using Scalar = double;
+    using Single = SSE41Single;
+    using D = __m128d;
+    using I = __m128i;
+    static constexpr const size_t Lanes = 2;
+
+    static D Load(const double* p) { return _mm_loadu_pd(p); }
+    static void Store(double* p, D v) { _mm_storeu_pd(p, v); }
+    static D Set1(double v) { return _mm_set1_pd(v); }
+
+    static D Add(D a, D b) { return _mm_add_pd(a, b); }
+    static D Sub(D a, D b) { return _mm_sub_pd(a, b); }
+    static D Mul(D a, D b) { return _mm_mul_pd(a, b); }
+    static D Min(D a, D b) { return _mm_min_pd(a, b); }
+    static D Max(D a, D b) { return _mm_max_pd(a, b); }
+    static D Abs(D v) { return _mm_andnot_pd(_mm_set1_pd(-0.0), v); }
+
+    static bool AnyAbsGreaterOrEqual(D v, double limit) {
+        return _mm_movemask_pd(_mm_cmpge_pd(Abs(v), _mm_set1_pd(limit))) != 0;
+    }
+
+    // (x > 0.0? (int)x: (int)x - 1)
+    static D CellFloor(D v) {
+        D truncated = _mm_round_pd(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        D positive = _mm_cmpgt_pd(v, _mm_setzero_pd());
+        return _mm_sub_pd(truncated, _mm_andnot_pd(positive, _mm_set1_pd(1.0)));
+    }
+
+    static I ToInt(D v) { return _mm_cvttpd_epi32(v); }
+    static I Set1I(int32_t v) { return _mm_set1_epi32(v); }
+    static I AddI(I a, I b) { return _mm_add_epi32(a, b); }
+    static I MulI(I a, I b) { return _mm_mullo_epi32(a, b); }
+    static I XorI(I a, I b) { return _mm_xor_si128(a, b); }
+    static I AndI(I a, I b) { return _mm_and_si128(a, b); }
+    static I ShiftRightI8(I v) { return _mm_srai_epi32(v, 8); }
+    static I ShiftLeftI2(I v) { return _mm_slli_epi32(v, 2); }
+
+    static D Gather(const double* table, I index) {
+        return _mm_set_pd(table[_mm_extract_epi32(index, 1)], table[_mm_extract_epi32(index, 0)]);
+    }
+};
+
+}
+
+#include "middleware/node_editor/noise_kernels_simd.h"
+
+
+namespace kernel {
+namespace detail {
+
+void FractalSSE41(const FractalArgs& args, const double* x, const double* y, const double* z, double* out, size_t count) {
+    FractalKernel<SSE41>::Run(args, x, y, z, out, count);
+}
+
+void ColorizeSSE41(const ColorLut& lut, const float* values, uint32_t* out, size_t count) {
+    const __m128 lower = _mm_set1_ps(lut.lower);
+    const __m128 scale = _mm_set1_ps(lut.scale);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 maxIndex = _mm_set1_ps(static_cast<float>(lut.size - 1));
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 index = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), lower), scale), half);
+        index = _mm_min_ps(_mm_max_ps(index, _mm_setzero_ps()), maxIndex);
+        const __m128i intIndex = _mm_cvttps_epi32(index);
+        const __m128i colors = _mm_set_epi32(
+            static_cast<int32_t>(lut.table[_mm_extract_epi32(intIndex, 3)]),
+            static_cast<int32_t>(lut.table[_mm_extract_epi32(intIndex, 2)]),
+            static_cast<int32_t>(lut.table[_mm_extract_epi32(intIndex, 1)]),
+            static_cast<int32_t>(lut.table[_mm_extract_epi32(intIndex, 0)]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), colors);
+    }
+
+    ColorizeTail(lut, values + i, out + i, count - i);
+}
+
+}
+}
+
+#else
+
+// the kernel is called only if GetSimdLevel() reports the support of SSE4.1
+namespace kernel {
+namespace detail {
+
+void FractalSSE41(const FractalArgs&, const double*, const double*, const double*, double*, size_t) {
+
+}
+
+void ColorizeSSE41(const ColorLut&, const float*, uint32_t*, size_t) {
+
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include "middleware/node_editor/noise_map_cache.h"
+
+#include <cstring>
+#include <typeinfo>
+
+#include "engine/common/hash_combine.h"
+#include "middleware/node_editor/noise_2d.h"
+#include "middleware/node_editor/noise_3d.h"
+#include "middleware/node_editor/noise_program.h"
+#include "middleware/node_editor/node_scheduler.h"
+#include "middleware/node_editor/noiseutils.h"
+
+
+namespace {
+
+NoiseMapKey MakeKey(const BaseNoise3DNode* sourceNode, std::type_index mapping,
+    double lowerUBound, double upperUBound, double lowerVBound, double upperVBound, uint32_t width, uint32_t height,
+    NoisePrecision precision, bool isBandLimited) {
+
+    NoiseMapKey key;
+    const auto program = (sourceNode != nullptr) ? sourceNode->GetProgram() : nullptr;
+    if (!program) {
+        return key;
+    }
+
+    key.mapping = mapping;
+    key.program = program->GetKey();
+    key.lowerUBound = lowerUBound;
+    key.upperUBound = upperUBound;
+    key.lowerVBound = lowerVBound;
+    key.upperVBound = upperVBound;
+    key.width = width;
+    key.height = height;
+    key.precision = precision;
+    key.isBandLimited = isBandLimited;
+
+    size_t hash = mapping.hash_code();
+    for (const auto byte: key.program) {
+        hash_combine(hash, byte);
+    }
+    hash_combine(hash, lowerUBound);
+    hash_combine(hash, upperUBound);
+    hash_combine(hash, lowerVBound);
+    hash_combine(hash, upperVBound);
+    hash_combine(hash, width);
+    hash_combine(hash, height);
+    hash_combine(hash, static_cast<uint8_t>(precision));
+    hash_combine(hash, isBandLimited);
+    // 0 is reserved for the invalid key
+    key.hash = (hash == 0) ? 1 : hash;
+
+    return key;
+}
+
+}
+
+bool NoiseMapKey::operator==(const NoiseMapKey& other) const noexcept {
+    // the bounds are compared bitwise as they are hashed
+    return (hash == other.hash) && (mapping == other.mapping) && (program == other.program) &&
+        (std::memcmp(&lowerUBound, &other.lowerUBound, sizeof(double)) == 0) &&
+        (std::memcmp(&upperUBound, &other.upperUBound, sizeof(double)) == 0) &&
+        (std::memcmp(&lowerVBound, &other.lowerVBound, sizeof(double)) == 0) &&
+        (std::memcmp(&upperVBound, &other.upperVBound, sizeof(double)) == 0) &&
+        (width == other.width) && (height == other.height) &&
+        (precision == other.precision) && (isBandLimited == other.isBandLimited);
+}
+
+NoiseMapKey NoiseMapCache::GetKey(const BaseNoise2DNode* sourceModule,
+    double lowerUBound, double upperUBound, double lowerVBound, double upperVBound, uint32_t width, uint32_t height,
+    NoisePrecision precision, bool isBandLimited) {
+
+    return MakeKey(sourceModule->GetSourceNode(), std::type_index(typeid(*sourceModule)),
+        lowerUBound, upperUBound, lowerVBound, upperVBound, width, height, precision, isBandLimited);
+}
+
+NoiseMapKey NoiseMapCache::GetKey(const BaseNoise3DNode* sourceModule,
+    double lowerUBound, double upperUBound, double lowerVBound, double upperVBound, uint32_t width, uint32_t height,
+    NoisePrecision precision, bool isBandLimited) {
+
+    return MakeKey(sourceModule, std::type_index(typeid(NodeScheduler)),
+        lowerUBound, upperUBound, lowerVBound, upperVBound, width, height, precision, isBandLimited);
+}
+
+std::shared_ptr<const noise::utils::NoiseMap> NoiseMapCache::Find(const NoiseMapKey& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_index.find(key);
+    if (it == m_index.cend()) {
+        return nullptr;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->second;
+}
+
+void NoiseMapCache::Insert(const NoiseMapKey& key, const std::shared_ptr<const noise::utils::NoiseMap>& map) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (const auto it = m_index.find(key); it != m_index.cend()) {
+        m_memoryUsage -= it->second->second->GetMemorySize();
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_lru.emplace_front(key, map);
+    m_index[key] = m_lru.begin();
+    m_memoryUsage += map->GetMemorySize();
+    Evict();
+}
+
+void NoiseMapCache::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_index.clear();
+    m_memoryUsage = 0;
+}
+
+void NoiseMapCache::SetMemoryBudget(size_t memoryBudget) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memoryBudget = memoryBudget;
+    Evict();
+}
+
+size_t NoiseMapCache::GetMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_memoryUsage;
+}
+
+void NoiseMapCache::Evict() {
+    while ((m_memoryUsage > m_memoryBudget) && (!m_lru.empty())) {
+        const auto& item = m_lru.back();
+        m_memoryUsage -= item.second->GetMemorySize();
+        m_index.erase(item.first);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <typeinfo>
+#include <typeindex>
+#include <unordered_map>
+
+#include "engine/common/noncopyable.h"
+
+
+namespace noise {
+    namespace utils {
+        class NoiseMap;
+    }
+}
+class BaseNoise2DNode;
+class BaseNoise3DNode;
+enum class NoisePrecision : uint8_t;
+// Full description of a cached noise map, the maps are equal only if all fields are equal
+struct NoiseMapKey {
+    // hash of the other fields, 0 - the map can not be cached
+    size_t hash = 0;
+    // type of the 2D node of the map or NodeScheduler for the preview maps of the noise 3D nodes
+    std::type_index mapping = std::type_index(typeid(void));
+    // see NoiseProgram::GetKey
+    std::vector<uint8_t> program;
+    double lowerUBound = 0;
+    double upperUBound = 0;
+    double lowerVBound = 0;
+    double upperVBound = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    NoisePrecision precision = {};
+    bool isBandLimited = false;
+
+    bool IsValid() const noexcept { return hash != 0; }
+    bool operator==(const NoiseMapKey& other) const noexcept;
+
+    struct Hasher {
+        size_t operator()(const NoiseMapKey& key) const noexcept { return key.hash; }
+    };
+};
+
+// Content-addressed cache of the built noise maps with the LRU eviction.
+// The key contains the types, the parameters and the links of the nodes of the source subgraph,
+// the bounds, the size, the precision and the band limit of the map, so equal subgraphs share the maps
+// and a parameter returned to the previous value finds the previous map.
+class NoiseMapCache : Noncopyable {
+public:
+    static constexpr const size_t DefaultMemoryBudget = 64 * 1024 * 1024;
+
+public:
+    NoiseMapCache() = default;
+    ~NoiseMapCache() = default;
+
+    static NoiseMapCache& Get() noexcept {
+        static NoiseMapCache instance;
+        return instance;
+    }
+
+    // Returns the invalid key if the subgraph of sourceModule is not full, the map can not be cached in this case
+    // Should be called on the main thread, the parameters of the nodes are read
+    static NoiseMapKey GetKey(const BaseNoise2DNode* sourceModule,
+        double lowerUBound, double upperUBound, double lowerVBound, double upperVBound, uint32_t width, uint32_t height,
+        NoisePrecision precision, bool isBandLimited);
+    // Same for the preview map of the noise node, the values are calculated from the maps of the sources,
+    // see NodeScheduler, so the key differs from the key of the plane of the node
+    static NoiseMapKey GetKey(const BaseNoise3DNode* sourceModule,
+        double lowerUBound, double upperUBound, double lowerVBound, double upperVBound, uint32_t width, uint32_t height,
+        NoisePrecision precision, bool isBandLimited);
+
+    // Thread safe, returns nullptr if the map is not found
+    std::shared_ptr<const noise::utils::NoiseMap> Find(const NoiseMapKey& key);
+    // Thread safe
+    void Insert(const NoiseMapKey& key, const std::shared_ptr<const noise::utils::NoiseMap>& map);
+    void Clear();
+
+    // Maps are evicted when the total size of the maps exceeds the budget, in bytes
+    void SetMemoryBudget(size_t memoryBudget);
+    size_t GetMemoryUsage() const;
+
+private:
+    // Should be called under the lock
+    void Evict();
+
+private:
+    using Item = std::pair<NoiseMapKey, std::shared_ptr<const noise::utils::NoiseMap>>;
+    // the most recently used map is the first
+    using LruList = std::list<Item>;
+
+    mutable std::mutex m_mutex;
+    size_t m_memoryBudget = DefaultMemoryBudget;
+    size_t m_memoryUsage = 0;
+    LruList m_lru;
+    std::unordered_map<NoiseMapKey, LruList::iterator, NoiseMapKey::Hasher> m_index;
+};
@@ -0,0 +1,759 @@
+#include "middleware/node_editor/noise_program.h"
+
+#include <cmath>
+#include <cstring>
+#include <typeinfo>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <fmt/format.h>
+
+#include "engine/common/exception.h"
+#include "engine/common/hash_combine.h"
+#include "middleware/node_editor/noise_3d.h"
+#include "middleware/node_editor/graph_file.h"
+
+
+// value - true if all sources of the node are visited
+using VisitedNodes = std::unordered_map<const BaseNoise3DNode*, bool>;
+using Instruction = NoiseProgram::Instruction;
+using AffineStep = NoiseProgram::AffineStep;
+
+struct InstructionState {
+    NoiseRange range;
+    // the values of the node are range.lower
+    bool isConst = false;
+    // the range is calculated from the values of the current block
+    bool isBlockRange = false;
+    // the values of the node are the values of the source, NoSource - the node is evaluated
+    size_t passSource = BaseNoise3DNode::NoSource;
+    // number of the evaluated instructions reading the values of the node, 0 - the node is not evaluated
+    uint32_t useCount = 0;
+};
+
+static std::array<NoiseRange, 3> GetSourceRanges(const Instruction& instruction, const std::vector<InstructionState>& states) {
+    std::array<NoiseRange, 3> result;
+    for (size_t i=0; i!=instruction.sourceCount; ++i) {
+        result[i] = states[instruction.srcInstruction[i]].range;
+    }
+
+    return result;
+}
+
+template <typename Fn> static void ForEachUsedSource(const Instruction& instruction, const InstructionState& state, Fn&& fn) {
+    if (state.isConst) {
+        return;
+    }
+    if (state.passSource != BaseNoise3DNode::NoSource) {
+        fn(instruction.srcInstruction[state.passSource]);
+        return;
+    }
+    for (size_t i=0; i!=instruction.sourceCount; ++i) {
+        fn(instruction.srcInstruction[i]);
+    }
+}
+
+// Returns the static range if some value is NaN
+static NoiseRange GetBlockRange(const double* values, size_t count, const NoiseRange& staticRange) {
+    NoiseRange result{values[0], values[0]};
+    for (size_t i=0; i!=count; ++i) {
+        const double value = values[i];
+        if (std::isnan(value)) {
+            return staticRange;
+        }
+        result.lower = std::min(result.lower, value);
+        result.upper = std::max(result.upper, value);
+    }
+
+    return result;
+}
+
+static NoiseRange GetAffineRange(const std::vector<AffineStep>& steps, NoiseRange range) {
+    for (const auto& step: steps) {
+        const double lower = range.lower * step.scale + step.bias;
+        const double upper = range.upper * step.scale + step.bias;
+        if (std::isnan(lower) || std::isnan(upper)) {
+            return NoiseRange();
+        }
+        range = NoiseRange{std::min(lower, upper), std::max(lower, upper)};
+    }
+
+    return range;
+}
+
+NoiseRange NoiseProgram::GetRange(const Instruction& instruction, const std::array<NoiseRange, 3>& sources) {
+    switch (instruction.type) {
+        case Instruction::Type::Node:
+            return instruction.node->OnGetRange(sources.data());
+        case Instruction::Type::Const:
+            return NoiseRange{instruction.value, instruction.value};
+        case Instruction::Type::Affine:
+            return GetAffineRange(instruction.steps, sources[0]);
+    }
+
+    return NoiseRange();
+}
+
+// Does nothing if the gradients are not evaluated (nullptr)
+static void FillGradients(const NoiseGradients& gradients, size_t count, double value) {
+    if (gradients.x != nullptr) {
+        std::fill(gradients.x, gradients.x + count, value);
+        std::fill(gradients.y, gradients.y + count, value);
+        std::fill(gradients.z, gradients.z + count, value);
+    }
+}
+
+// dst = src * scale, does nothing if the gradients are not evaluated (nullptr)
+static void ScaleGradients(const NoiseGradients& src, const NoiseGradients& dst, size_t count, double scale) {
+    if (dst.x != nullptr) {
+        for (size_t i=0; i!=count; ++i) {
+            dst.x[i] = src.x[i] * scale;
+            dst.y[i] = src.y[i] * scale;
+            dst.z[i] = src.z[i] * scale;
+        }
+    }
+}
+
+static bool IsEqual(double a, double b) {
+    return std::equal_to<double>()(a, b);
+}
+
+// -0 is the identity of the addition for all values including -0
+static bool IsNegativeZero(double value) {
+    return IsEqual(value, 0.0) && std::signbit(value);
+}
+
+// Appends the step to the chain, the result is exact: the negation is merged with the neighbour step,
+// x * 1 + 0 is removed (the sign of zero can be changed)
+static void AppendStep(std::vector<AffineStep>& steps, const AffineStep& step) {
+    auto isNegation = [](const AffineStep& value) {
+        return IsEqual(value.scale, -1.0) && IsNegativeZero(value.bias);
+    };
+
+    if (steps.empty()) {
+        steps.push_back(step);
+    } else if (isNegation(step)) {
+        // -(x * s + b) == x * (-s) + (-b)
+        steps.back().scale = -steps.back().scale;
+        steps.back().bias = -steps.back().bias;
+    } else if (isNegation(steps.back())) {
+        // (-x) * s + b == x * (-s) + b
+        steps.back().scale = -step.scale;
+        steps.back().bias = step.bias;
+    } else {
+        steps.push_back(step);
+    }
+
+    if (IsEqual(steps.back().scale, 1.0) && IsEqual(steps.back().bias, 0.0)) {
+        steps.pop_back();
+    }
+}
+
+static bool IsBitwiseEqual(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static size_t GetBits(double value) {
+    uint64_t result = 0;
+    std::memcpy(&result, &value, sizeof(result));
+    return static_cast<size_t>(result);
+}
+
+// post-order DFS, returns false if some input pin is not connected
+static bool TopologicalSort(const BaseNoise3DNode* node, VisitedNodes& visited, std::vector<const BaseNoise3DNode*>& order) {
+    if (const auto it = visited.find(node); it != visited.cend()) {
+        if (!it->second) {
+            throw EngineError("the noise graph contains a cycle");
+        }
+        return true;
+    }
+
+    // the sources are visited from the last input pin, so the control source of Select
+    // is evaluated before the selected sources and can exclude one of them
+    visited[node] = false;
+    for (size_t i=node->GetSourceCount(); i!=0; --i) {
+        const auto* srcNode = node->GetSourceNode(i - 1);
+        if ((srcNode == nullptr) || (!TopologicalSort(srcNode, visited, order))) {
+            return false;
+        }
+    }
+    visited[node] = true;
+    order.push_back(node);
+
+    return true;
+}
+
+std::shared_ptr<const NoiseProgram> NoiseProgram::Compile(const BaseNoise3DNode* root) {
+    VisitedNodes visited;
+    std::vector<const BaseNoise3DNode*> order;
+    if (!TopologicalSort(root, visited, order)) {
+        return nullptr;
+    }
+
+    std::unordered_map<const BaseNoise3DNode*, size_t> nodeIndex;
+    for (size_t i=0; i!=order.size(); ++i) {
+        nodeIndex[order[i]] = i;
+    }
+
+    auto program = std::make_shared<NoiseProgram>();
+    program->m_instructions.resize(order.size());
+    for (size_t i=0; i!=order.size(); ++i) {
+        const auto* node = order[i];
+        auto& instruction = program->m_instructions[i];
+        instruction.node = node;
+        instruction.sourceCount = static_cast<uint8_t>(node->GetSourceCount());
+        for (size_t j=0; j!=node->GetSourceCount(); ++j) {
+            instruction.srcInstruction[j] = static_cast<uint32_t>(nodeIndex[node->GetSourceNode(j)]);
+        }
+    }
+    program->AllocateRegisters();
+
+    return program;
+}
+
+std::shared_ptr<const NoiseProgram> NoiseProgram::Optimize() const {
+    std::vector<Instruction> instructions;
+    // saved parameters of the nodes of instructions (see BaseNode::SaveParams), empty for the other instructions
+    std::vector<std::vector<uint8_t>> params;
+    // structural hash -> index in instructions, for the elimination of the equal subtrees
+    std::unordered_multimap<size_t, uint32_t> known;
+    auto emit = [&instructions, &params, &known](Instruction&& instruction) -> uint32_t {
+        std::vector<uint8_t> nodeParams;
+        size_t paramsHash = 0;
+        size_t hash = static_cast<size_t>(instruction.type);
+        switch (instruction.type) {
+            case Instruction::Type::Node: {
+                ParamsWriter writer;
+                instruction.node->SaveParams(writer);
+                nodeParams = writer.GetData();
+                instruction.node->OnHashParams(paramsHash);
+                hash_combine(hash, typeid(*instruction.node).hash_code());
+                hash_combine(hash, paramsHash);
+                break;
+            }
+            case Instruction::Type::Const:
+                hash_combine(hash, GetBits(instruction.value));
+                break;
+            case Instruction::Type::Affine:
+                for (const auto& step: instruction.steps) {
+                    hash_combine(hash, GetBits(step.scale));
+                    hash_combine(hash, GetBits(step.bias));
+                }
+                break;
+        }
+        for (size_t i=0; i!=instruction.sourceCount; ++i) {
+            hash_combine(hash, instruction.srcInstruction[i]);
+        }
+
+        const auto range = known.equal_range(hash);
+        for (auto it=range.first; it!=range.second; ++it) {
+            const auto& other = instructions[it->second];
+            bool isEqual = (other.type == instruction.type) && (other.sourceCount == instruction.sourceCount) &&
+                std::equal(other.srcInstruction.cbegin(), other.srcInstruction.cbegin() + other.sourceCount, instruction.srcInstruction.cbegin());
+            if (isEqual && (instruction.type == Instruction::Type::Node)) {
+                // the nodes of the same type with the same saved parameters have the same values,
+                // the hash of the parameters only selects the candidates
+                isEqual = (typeid(*other.node) == typeid(*instruction.node)) && (params[it->second] == nodeParams);
+            } else if (isEqual && (instruction.type == Instruction::Type::Const)) {
+                isEqual = IsBitwiseEqual(other.value, instruction.value);
+            } else if (isEqual && (instruction.type == Instruction::Type::Affine)) {
+                isEqual = std::equal(other.steps.cbegin(), other.steps.cend(), instruction.steps.cbegin(), instruction.steps.cend(),
+                    [](const AffineStep& a, const AffineStep& b) {
+                        return IsBitwiseEqual(a.scale, b.scale) && IsBitwiseEqual(a.bias, b.bias);
+                    });
+            }
+            if (isEqual) {
+                return it->second;
+            }
+        }
+
+        const auto index = static_cast<uint32_t>(instructions.size());
+        instructions.push_back(std::move(instruction));
+        params.push_back(std::move(nodeParams));
+        known.emplace(hash, index);
+
+        return index;
+    };
+    auto makeConst = [](double value) {
+        Instruction instruction;
+        instruction.type = Instruction::Type::Const;
+        instruction.value = value;
+        return instruction;
+    };
+
+    // index - instruction of this program, value - instruction of the optimized program with the same values
+    std::vector<uint32_t> remap(m_instructions.size());
+    for (size_t i=0; i!=m_instructions.size(); ++i) {
+        const auto& instruction = m_instructions[i];
+        const auto* node = instruction.node;
+        std::array<uint32_t, 3> sourceIds = {};
+        std::array<const double*, 3> constants = {};
+        std::array<NoiseRange, 3> ranges;
+        bool isAllConst = true;
+        for (size_t j=0; j!=instruction.sourceCount; ++j) {
+            sourceIds[j] = remap[instruction.srcInstruction[j]];
+            const auto& source = instructions[sourceIds[j]];
+            if (source.type == Instruction::Type::Const) {
+                constants[j] = &source.value;
+                ranges[j] = NoiseRange{source.value, source.value};
+            } else {
+                isAllConst = false;
+            }
+        }
+
+        // the constants
+        if (const auto range = node->OnGetRange(ranges.data()); range.IsConst()) {
+            remap[i] = emit(makeConst(range.lower));
+            continue;
+        }
+        if ((instruction.sourceCount != 0) && isAllConst) {
+            // the values of the nodes with the sources depend only on the values of the sources
+            const double coord = 0;
+            double value = 0;
+            node->OnGetValues(NoisePoints{&coord, &coord, &coord, 1, 0, NoisePrecision::Double}, constants.data(), &value);
+            remap[i] = emit(makeConst(value));
+            continue;
+        }
+
+        // the affine chains and the identities
+        if (const auto affine = node->OnGetAffine(constants.data(), sourceIds.data()); affine.source != BaseNoise3DNode::NoSource) {
+            const auto srcIndex = sourceIds[affine.source];
+            const auto& source = instructions[srcIndex];
+            Instruction result;
+            result.type = Instruction::Type::Affine;
+            result.sourceCount = 1;
+            if (source.type == Instruction::Type::Affine) {
+                result.steps = source.steps;
+                result.srcInstruction[0] = source.srcInstruction[0];
+            } else {
+                result.srcInstruction[0] = srcIndex;
+            }
+            AppendStep(result.steps, AffineStep{affine.scale, affine.bias});
+            remap[i] = result.steps.empty() ? result.srcInstruction[0] : emit(std::move(result));
+            continue;
+        }
+
+        Instruction result;
+        result.node = node;
+        result.sourceCount = instruction.sourceCount;
+        result.srcInstruction = sourceIds;
+        remap[i] = emit(std::move(result));
+    }
+
+    // the instructions that do not affect the root are removed, the root becomes the last instruction
+    const uint32_t root = remap.back();
+    std::vector<bool> isUsed(instructions.size(), false);
+    isUsed[root] = true;
+    for (size_t i=root + 1; i!=0; --i) {
+        if (isUsed[i - 1]) {
+            for (size_t j=0; j!=instructions[i - 1].sourceCount; ++j) {
+                isUsed[instructions[i - 1].srcInstruction[j]] = true;
+            }
+        }
+    }
+
+    auto program = std::make_shared<NoiseProgram>();
+    program->m_isOptimized = true;
+    std::vector<uint32_t> compacted(instructions.size());
+    for (size_t i=0; i!=root + 1; ++i) {
+        if (isUsed[i]) {
+            auto& instruction = instructions[i];
+            for (size_t j=0; j!=instruction.sourceCount; ++j) {
+                instruction.srcInstruction[j] = compacted[instruction.srcInstruction[j]];
+            }
+            compacted[i] = static_cast<uint32_t>(program->m_instructions.size());
+            program->m_instructions.push_back(std::move(instruction));
+        }
+    }
+    program->AllocateRegisters();
+
+    return program;
+}
+
+std::shared_ptr<const NoiseProgram> NoiseProgram::GetOptimized() const {
+    return GetOptimizedProgram().program;
+}
+
+const NoiseProgram::OptimizedProgram& NoiseProgram::GetOptimizedProgram() const {
+    // called for every block of points by every worker, so the current result is checked without the lock,
+    // a new generation of any node means new parameters, unlike GetHash it has no collisions
+    const uint64_t revision = GetRevision();
+    const auto* optimized = m_optimized.load(std::memory_order_acquire);
+    if ((optimized != nullptr) && (optimized->revision == revision)) {
+        return *optimized;
+    }
+
+    std::lock_guard<std::mutex> lock(m_optimizedMutex);
+    optimized = m_optimized.load(std::memory_order_relaxed);
+    if ((optimized == nullptr) || (optimized->revision != revision)) {
+        m_optimizedPrograms.push_back(std::make_unique<const OptimizedProgram>(OptimizedProgram{revision, Optimize()}));
+        optimized = m_optimizedPrograms.back().get();
+        m_optimized.store(optimized, std::memory_order_release);
+    }
+
+    return *optimized;
+}
+
+void NoiseProgram::Execute(const NoisePoints& points, double* out) const {
+    if (m_isOptimized) {
+        Run(points, out, nullptr);
+    } else {
+        GetOptimizedProgram().program->Run(points, out, nullptr);
+    }
+}
+
+bool NoiseProgram::HasGradients() const {
+    if (!m_isOptimized) {
+        return GetOptimizedProgram().program->HasGradients();
+    }
+
+    // the constant nodes are folded by the optimization
+    return std::all_of(m_instructions.cbegin(), m_instructions.cend(), [](const Instruction& instruction) {
+        return (instruction.type != Instruction::Type::Node) || instruction.node->CanGetGradients();
+    });
+}
+
+void NoiseProgram::ExecuteGradients(const NoisePoints& points, double* out, const NoiseGradients& gradients) const {
+    if (!m_isOptimized) {
+        GetOptimizedProgram().program->ExecuteGradients(points, out, gradients);
+        return;
+    }
+
+    if (!HasGradients()) {
+        throw EngineError("the noise program contains nodes without the gradients");
+    }
+    Run(points, out, &gradients);
+}
+
+double NoiseProgram::GetSinglePrecisionError() const {
+    // the constant nodes are not evaluated, so their values do not depend on the precision
+    std::vector<InstructionState> states(m_instructions.size());
+    std::vector<double> errors(m_instructions.size(), 0.0);
+    for (size_t i=0; i!=m_instructions.size(); ++i) {
+        const auto& instruction = m_instructions[i];
+        const auto sources = GetSourceRanges(instruction, states);
+        states[i].range = GetRange(instruction, sources);
+        if (states[i].range.IsConst()) {
+            continue;
+        }
+
+        std::array<double, 3> sourceErrors = {};
+        for (size_t j=0; j!=instruction.sourceCount; ++j) {
+            sourceErrors[j] = errors[instruction.srcInstruction[j]];
+        }
+        switch (instruction.type) {
+            case Instruction::Type::Node:
+                errors[i] = instruction.node->OnGetSinglePrecisionError(sources.data(), sourceErrors.data());
+                break;
+            case Instruction::Type::Const:
+                break;
+            case Instruction::Type::Affine:
+                errors[i] = sourceErrors[0];
+                for (const auto& step: instruction.steps) {
+                    errors[i] *= std::fabs(step.scale);
+                }
+                break;
+        }
+        if (std::isnan(errors[i])) {
+            errors[i] = std::numeric_limits<double>::infinity();
+        }
+    }
+
+    return errors.back();
+}
+
+uint64_t NoiseProgram::GetRevision() const noexcept {
+    uint64_t result = 0;
+    for (const auto& instruction: m_instructions) {
+        if (instruction.type == Instruction::Type::Node) {
+            result = std::max(result, instruction.node->GetGeneration());
+        }
+    }
+
+    return result;
+}
+
+size_t NoiseProgram::GetHash() const {
+    // the hashes follow the values through the registers, so the hash does not depend on the allocation of the registers
+    std::vector<size_t> registerHashes(m_registerCount, 0);
+    size_t result = 0;
+    for (const auto& instruction: m_instructions) {
+        size_t hash = static_cast<size_t>(instruction.type);
+        switch (instruction.type) {
+            case Instruction::Type::Node:
+                hash = typeid(*instruction.node).hash_code();
+                instruction.node->OnHashParams(hash);
+                break;
+            case Instruction::Type::Const:
+                hash_combine(hash, GetBits(instruction.value));
+                break;
+            case Instruction::Type::Affine:
+                for (const auto& step: instruction.steps) {
+                    hash_combine(hash, GetBits(step.scale));
+                    hash_combine(hash, GetBits(step.bias));
+                }
+                break;
+        }
+        for (const auto reg: instruction.src) {
+            if (reg != NoRegister) {
+                hash_combine(hash, registerHashes[reg]);
+            }
+        }
+
+        if (instruction.dst == NoRegister) {
+            result = hash;
+        } else {
+            registerHashes[instruction.dst] = hash;
+        }
+    }
+
+    return result;
+}
+
+std::vector<uint8_t> NoiseProgram::GetKey() const {
+    ParamsWriter writer;
+    for (const auto& instruction: m_instructions) {
+        writer.Write(instruction.type);
+        switch (instruction.type) {
+            case Instruction::Type::Node: {
+                ParamsWriter params;
+                instruction.node->SaveParams(params);
+                writer.Write(NodeFactory::GetType(instruction.node));
+                writer.Write(params.GetData().size());
+                writer.WriteBytes(params.GetData());
+                break;
+            }
+            case Instruction::Type::Const:
+                writer.Write(instruction.value);
+                break;
+            case Instruction::Type::Affine:
+                writer.Write(instruction.steps.size());
+                for (const auto& step: instruction.steps) {
+                    writer.Write(step);
+                }
+                break;
+        }
+        writer.Write(instruction.sourceCount);
+        for (size_t i=0; i!=instruction.sourceCount; ++i) {
+            writer.Write(instruction.srcInstruction[i]);
+        }
+    }
+
+    return writer.GetData();
+}
+
+std::string NoiseProgram::ToString() const {
+    auto getName = [](uint16_t reg) {
+        return (reg == NoRegister) ? std::string("out") : fmt::format("r{}", reg);
+    };
+
+    std::string result;
+    for (const auto& instruction: m_instructions) {
+        std::string expression;
+        switch (instruction.type) {
+            case Instruction::Type::Node:
+                expression = instruction.node->GetName() + "(";
+                for (size_t i=0; i!=instruction.sourceCount; ++i) {
+                    expression += ((i == 0) ? "" : ", ") + getName(instruction.src[i]);
+                }
+                expression += ")";
+                break;
+            case Instruction::Type::Const:
+                expression = fmt::format("{}", instruction.value);
+                break;
+            case Instruction::Type::Affine:
+                expression = getName(instruction.src[0]);
+                for (const auto& step: instruction.steps) {
+                    expression = fmt::format("({} * {} + {})", expression, step.scale, step.bias);
+                }
+                break;
+        }
+        result += fmt::format("{} = {}\n", getName(instruction.dst), expression);
+    }
+
+    return result;
+}
+
+void NoiseProgram::AllocateRegisters() {
+    // index of the last instruction that reads the value of the instruction
+    std::vector<size_t> lastUse(m_instructions.size(), 0);
+    for (size_t i=0; i!=m_instructions.size(); ++i) {
+        for (size_t j=0; j!=m_instructions[i].sourceCount; ++j) {
+            lastUse[m_instructions[i].srcInstruction[j]] = i;
+        }
+    }
+
+    m_registerCount = 0;
+    m_selectors.assign(m_instructions.size(), {});
+    std::vector<uint16_t> freeRegisters;
+    for (size_t i=0; i!=m_instructions.size(); ++i) {
+        auto& instruction = m_instructions[i];
+        const bool isSelector = (instruction.type == Instruction::Type::Node) && instruction.node->CanSelectSource();
+        for (size_t j=0; j!=instruction.sourceCount; ++j) {
+            const auto srcIndex = instruction.srcInstruction[j];
+            instruction.src[j] = m_instructions[srcIndex].dst;
+            auto& selectors = m_selectors[srcIndex];
+            if (isSelector && (std::find(selectors.cbegin(), selectors.cend(), i) == selectors.cend())) {
+                selectors.push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        // the root writes directly to the output
+        instruction.dst = NoRegister;
+        if (i + 1 != m_instructions.size()) {
+            if (freeRegisters.empty()) {
+                if (m_registerCount == NoRegister) {
+                    throw EngineError("the noise graph is too large, the number of registers exceeds {}", NoRegister);
+                }
+                instruction.dst = m_registerCount++;
+            } else {
+                instruction.dst = freeRegisters.back();
+                freeRegisters.pop_back();
+            }
+        }
+
+        // the registers are released after the allocation of dst, so a node never writes to its own source
+        for (size_t j=0; j!=instruction.sourceCount; ++j) {
+            const size_t srcIndex = instruction.srcInstruction[j];
+            const uint16_t reg = m_instructions[srcIndex].dst;
+            if ((lastUse[srcIndex] == i) && (std::find(freeRegisters.cbegin(), freeRegisters.cend(), reg) == freeRegisters.cend())) {
+                freeRegisters.push_back(reg);
+            }
+        }
+    }
+}
+
+void NoiseProgram::Run(const NoisePoints& points, double* out, const NoiseGradients* gradients) const {
+    // the states are calculated for every call, the parameters of the nodes can be changed between the calls
+    std::vector<InstructionState> states(m_instructions.size());
+    for (size_t i=0; i!=m_instructions.size(); ++i) {
+        const auto& instruction = m_instructions[i];
+        const auto sources = GetSourceRanges(instruction, states);
+        auto& state = states[i];
+        state.range = GetRange(instruction, sources);
+        if (state.range.IsConst()) {
+            state.isConst = true;
+        } else if ((instruction.type == Instruction::Type::Node) && instruction.node->CanSelectSource()) {
+            state.passSource = instruction.node->OnSelectSource(sources.data());
+        }
+    }
+
+    // the root is the last instruction
+    states.back().useCount = 1;
+    for (size_t i=m_instructions.size(); i!=0; --i) {
+        if (states[i - 1].useCount != 0) {
+            ForEachUsedSource(m_instructions[i - 1], states[i - 1], [&states](uint32_t srcIndex) {
+                states[srcIndex].useCount++;
+            });
+        }
+    }
+
+    std::vector<double> registers(static_cast<size_t>(m_registerCount) * BlockSize);
+    auto getRegister = [&registers](uint16_t reg) -> double* {
+        return (reg == NoRegister) ? nullptr : registers.data() + static_cast<size_t>(reg) * BlockSize;
+    };
+
+    // x, y and z of one register are stored one after another
+    std::vector<double> gradientRegisters((gradients != nullptr) ? static_cast<size_t>(m_registerCount) * BlockSize * 3 : 0);
+    auto getGradients = [&gradientRegisters](uint16_t reg) -> NoiseGradients {
+        if (reg == NoRegister) {
+            return NoiseGradients();
+        }
+        double* data = gradientRegisters.data() + static_cast<size_t>(reg) * BlockSize * 3;
+        return NoiseGradients{data, data + BlockSize, data + BlockSize * 2};
+    };
+
+    // the gradients are calculated in double precision
+    const auto precision = (gradients != nullptr) ? NoisePrecision::Double : points.precision;
+    std::vector<InstructionState> blockStates;
+    std::vector<uint32_t> released;
+    for (size_t offset=0; offset < points.count; offset += BlockSize) {
+        const NoisePoints block{points.x + offset, points.y + offset, points.z + offset, std::min(BlockSize, points.count - offset), points.spacing, precision};
+        blockStates = states;
+        for (size_t i=0; i!=m_instructions.size(); ++i) {
+            const auto& instruction = m_instructions[i];
+            auto& state = blockStates[i];
+            if (state.useCount == 0) {
+                continue;
+            }
+
+            double* dst = (instruction.dst == NoRegister) ? out + offset : getRegister(instruction.dst);
+            NoiseGradients dstGradients;
+            if (gradients != nullptr) {
+                dstGradients = (instruction.dst == NoRegister) ?
+                    NoiseGradients{gradients->x + offset, gradients->y + offset, gradients->z + offset} : getGradients(instruction.dst);
+            }
+            if (state.isConst) {
+                std::fill(dst, dst + block.count, state.range.lower);
+                FillGradients(dstGradients, block.count, 0.0);
+            } else if (state.passSource != BaseNoise3DNode::NoSource) {
+                const double* src = getRegister(instruction.src[state.passSource]);
+                std::copy(src, src + block.count, dst);
+                ScaleGradients(getGradients(instruction.src[state.passSource]), dstGradients, block.count, 1.0);
+            } else if (instruction.type == Instruction::Type::Const) {
+                std::fill(dst, dst + block.count, instruction.value);
+                FillGradients(dstGradients, block.count, 0.0);
+            } else if (instruction.type == Instruction::Type::Affine) {
+                const double* src = getRegister(instruction.src[0]);
+                double scale = 1.0;
+                for (const auto& step: instruction.steps) {
+                    for (size_t j=0; j!=block.count; ++j) {
+                        dst[j] = src[j] * step.scale + step.bias;
+                    }
+                    src = dst;
+                    scale *= step.scale;
+                }
+                ScaleGradients(getGradients(instruction.src[0]), dstGradients, block.count, scale);
+            } else {
+                const std::array<const double*, 3> sources = {
+                    getRegister(instruction.src[0]), getRegister(instruction.src[1]), getRegister(instruction.src[2])};
+                if (gradients != nullptr) {
+                    const std::array<NoiseGradients, 3> sourceGradients = {
+                        getGradients(instruction.src[0]), getGradients(instruction.src[1]), getGradients(instruction.src[2])};
+                    instruction.node->OnGetGradients(block, sources.data(), sourceGradients.data(), dst, dstGradients);
+                } else {
+                    instruction.node->OnGetValues(block, sources.data(), dst);
+                }
+            }
+
+            for (const auto selectorIndex: m_selectors[i]) {
+                const auto& selector = m_instructions[selectorIndex];
+                auto& selectorState = blockStates[selectorIndex];
+                if ((selectorState.useCount == 0) || selectorState.isConst || (selectorState.passSource != BaseNoise3DNode::NoSource)) {
+                    continue;
+                }
+                // there is nothing to skip if all sources are evaluated
+                const auto& srcInstruction = selector.srcInstruction;
+                if (*std::max_element(srcInstruction.cbegin(), srcInstruction.cbegin() + selector.sourceCount) <= i) {
+                    continue;
+                }
+
+                if (!state.isBlockRange) {
+                    state.range = GetBlockRange(dst, block.count, state.range);
+                    state.isBlockRange = true;
+                }
+                const auto sources = GetSourceRanges(selector, blockStates);
+                const size_t passSource = selector.node->OnSelectSource(sources.data());
+                if (passSource == BaseNoise3DNode::NoSource) {
+                    continue;
+                }
+
+                selectorState.passSource = passSource;
+                for (size_t j=0; j!=selector.sourceCount; ++j) {
+                    if (j != passSource) {
+                        released.push_back(srcInstruction[j]);
+                    }
+                }
+                while (!released.empty()) {
+                    const auto index = released.back();
+                    released.pop_back();
+                    if (--blockStates[index].useCount == 0) {
+                        ForEachUsedSource(m_instructions[index], blockStates[index], [&released](uint32_t srcIndex) {
+                            released.push_back(srcIndex);
+                        });
+                    }
+                }
+            }
+        }
+    }
+}
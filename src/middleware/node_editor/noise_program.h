@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+struct NoiseRange;
+struct NoisePoints;
+struct NoiseGradients;
+class BaseNoise3DNode;
+// The subgraph of the root node flattened into a linear program:
+// every node of the subgraph is one instruction, the instructions are in topological order
+// and exchange values through registers of BlockSize doubles.
+// The register of a node is written once per block and read by all consumers of the node,
+// so a node shared by several paths of the graph is evaluated once, not once per path.
+// Execute runs the whole program for a block of points before going to the next block,
+// so the cost of the dispatch is paid once per node per block instead of once per node per point.
+// The instructions refer to the nodes, the parameters of the nodes are read during the execution.
+//
+// Before the execution the program is optimized for the current parameters of the nodes (see Optimize),
+// the optimized program is cached until the hash of the parameters is changed.
+//
+// The bounds of the values of the nodes (see BaseNoise3DNode::OnGetRange) are propagated through the program
+// before the execution: the nodes with the constant values are not evaluated, the nodes that pass the values
+// of one source (Select, Clamp, Min, Max) do not need the other sources. The same decision is repeated
+// for every block with the actual bounds of the values of the evaluated sources, so the unused subtrees
+// are skipped block by block.
+class NoiseProgram {
+public:
+    static constexpr const size_t BlockSize = 256;
+    static constexpr const uint16_t NoRegister = UINT16_MAX;
+
+    // value = value * scale + bias
+    struct AffineStep {
+        double scale = 1.0;
+        double bias = -0.0;
+    };
+
+    struct Instruction {
+        enum class Type : uint8_t {
+            // BaseNoise3DNode::OnGetValues of the node
+            Node,
+            // the value for all points
+            Const,
+            // the steps are applied in order to the values of the source
+            Affine,
+        };
+
+        Type type = Type::Node;
+        // Node only
+        const BaseNoise3DNode* node = nullptr;
+        // Const only
+        double value = 0;
+        // Affine only
+        std::vector<AffineStep> steps;
+
+        uint16_t dst = NoRegister;
+        uint8_t sourceCount = 0;
+        // index - user index of the input pin
+        std::array<uint16_t, 3> src = {NoRegister, NoRegister, NoRegister};
+        // index of the instruction of the source, index - user index of the input pin
+        std::array<uint32_t, 3> srcInstruction = {};
+    };
+
+public:
+    NoiseProgram() = default;
+    ~NoiseProgram() = default;
+
+    // Returns nullptr if some input pin in the subgraph is not connected
+    // Throws EngineError if the subgraph contains a cycle
+    static std::shared_ptr<const NoiseProgram> Compile(const BaseNoise3DNode* root);
+
+    // Returns the equivalent program for the current parameters of the nodes:
+    // the constants are folded, the chains of the affine nodes (ScaleBias, Invert, Add and Multiply with a constant)
+    // are merged into one instruction, the identity operations are removed and the equal subtrees are evaluated once.
+    // The values are the same up to the sign of zero
+    // Throws EngineError if the program is too large
+    std::shared_ptr<const NoiseProgram> Optimize() const;
+    // Returns the cached result of Optimize for the current parameters of the nodes, thread safe.
+    // The cache is checked by GetRevision, without the locks and the allocations
+    std::shared_ptr<const NoiseProgram> GetOptimized() const;
+
+    // Evaluates the root node for all points, out should contain points.count elements
+    // Thread safe, the registers are allocated for every call
+    void Execute(const NoisePoints& points, double* out) const;
+    // Returns true if every node evaluated by the optimized program supports the gradients (BaseNoise3DNode::CanGetGradients)
+    bool HasGradients() const;
+    // Evaluates the root node and the partial derivatives of its values for all points in NoisePrecision::Double,
+    // the arrays should contain points.count elements, see BaseNoise3DNode::OnGetGradients
+    // Throws EngineError if !HasGradients()
+    void ExecuteGradients(const NoisePoints& points, double* out, const NoiseGradients& gradients) const;
+
+    // Upper bound of the deviation of the values of the root in NoisePrecision::Single from NoisePrecision::Double
+    // for the current parameters of the nodes, see BaseNoise3DNode::OnGetSinglePrecisionError
+    double GetSinglePrecisionError() const;
+
+    // The greatest generation of the nodes (see BaseNode::GetGeneration), it is increased by any change
+    // of the parameters of the nodes, the links are fixed for the lifetime of the program
+    uint64_t GetRevision() const noexcept;
+
+    // Hash of the types and the parameters of the nodes and of the links between them,
+    // the parameters are read at the moment of the call
+    size_t GetHash() const;
+    // Full binary form of the types and the parameters of the nodes (see BaseNode::SaveParams)
+    // and of the links between them, the programs with equal keys have equal values.
+    // The parameters are read at the moment of the call
+    std::vector<uint8_t> GetKey() const;
+
+    // One instruction per line, for the debugging
+    std::string ToString() const;
+
+    const std::vector<Instruction>& GetInstructions() const noexcept { return m_instructions; }
+    uint16_t GetRegisterCount() const noexcept { return m_registerCount; }
+
+private:
+    // The last instruction is the root
+    void AllocateRegisters();
+    // Bounds of the values of the instruction for the bounds of the sources
+    static NoiseRange GetRange(const Instruction& instruction, const std::array<NoiseRange, 3>& sources);
+    // gradients - nullptr if only the values are evaluated
+    void Run(const NoisePoints& points, double* out, const NoiseGradients* gradients) const;
+
+private:
+    std::vector<Instruction> m_instructions;
+    // index - instruction, value - the instructions with BaseNoise3DNode::CanSelectSource() reading it
+    std::vector<std::vector<uint32_t>> m_selectors;
+    uint16_t m_registerCount = 0;
+    bool m_isOptimized = false;
+
+    struct OptimizedProgram {
+        // GetRevision() of the program for which the result of Optimize was built
+        uint64_t revision = 0;
+        std::shared_ptr<const NoiseProgram> program;
+    };
+    // Returns the cached result of Optimize, rebuilds it if GetRevision() is changed
+    const OptimizedProgram& GetOptimizedProgram() const;
+
+    mutable std::mutex m_optimizedMutex;
+    // all results of Optimize, they are kept until the program is destroyed, so the readers
+    // of m_optimized never see a freed result. Only a change of the parameters adds a result
+    mutable std::vector<std::unique_ptr<const OptimizedProgram>> m_optimizedPrograms;
+    // the last element of m_optimizedPrograms, read without the lock
+    mutable std::atomic<const OptimizedProgram*> m_optimized = nullptr;
+};
@@ -1,8 +1,11 @@
 #include "middleware/node_editor/noiseutils.h"
 
+#include <vector>
 #include <algorithm>
 #include <mathconsts.h>
 
+#include "engine/common/thread_pool.h"
+
 
 using namespace noise;
 using namespace noise::model;
@@ -10,6 +13,185 @@ using namespace noise::module;
 using namespace noise::utils;
 
 
+//////////////////////////////////////////////////////////////////////////////
+// NoiseMap class
+
+bool NoiseMap::Build(uint32_t step) {
+    if (m_sourceModule == NULL) {
+        throw noise::ExceptionInvalidParam ();
+    }
+
+    // the points of the previous build are reused only if they have the same kind of the result
+    // and the source module is not changed (0 - the hash is unknown)
+    const bool isGradients = m_isGradientEnabled && m_sourceModule->HasGradients();
+    const size_t sourceHash = m_sourceModule->GetHash();
+    if ((isGradients != m_hasGradients) || (sourceHash != m_builtSourceHash) || (sourceHash == 0)) {
+        m_builtStep = 0;
+    }
+
+    Points points;
+    GetBuildPoints(step, points);
+
+    // Every chunk is calculated independently, so the result is the same for any number of threads.
+    const size_t count = points.u.size();
+    std::vector<double> values(count);
+    std::vector<double> du(isGradients ? count : 0);
+    std::vector<double> dv(isGradients ? count : 0);
+    // the spacing does not depend on the step, so the progressive build gives the same values
+    NoiseSampling sampling;
+    sampling.uSpacing = m_isBandLimited ? (m_upperUBound - m_lowerUBound) / static_cast<double>(m_width) : 0;
+    sampling.vSpacing = m_isBandLimited ? (m_upperVBound - m_lowerVBound) / static_cast<double>(m_height) : 0;
+    sampling.precision = m_precision;
+    const auto chunkCount = static_cast<uint32_t>((count + ChunkSize - 1) / ChunkSize);
+    auto& pool = ThreadPool::Get();
+    const uint32_t workerCount = (m_workerCount == 0) ? pool.GetThreadCount() : m_workerCount;
+    pool.ParallelFor(0, chunkCount, 1, workerCount, [this, &points, &values, &du, &dv, count, isGradients, &sampling](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk=begin; chunk!=end; ++chunk) {
+            if ((m_cancelled != nullptr) && m_cancelled->load()) {
+                return;
+            }
+
+            const size_t offset = chunk * ChunkSize;
+            const size_t chunkCount = std::min(ChunkSize, count - offset);
+            if (isGradients) {
+                m_sourceModule->GetGradients(points.u.data() + offset, points.v.data() + offset, values.data() + offset,
+                    du.data() + offset, dv.data() + offset, chunkCount, sampling);
+            } else {
+                m_sourceModule->GetValues(points.u.data() + offset, points.v.data() + offset, values.data() + offset, chunkCount, sampling);
+            }
+        }
+    });
+
+    if ((m_cancelled != nullptr) && m_cancelled->load()) {
+        m_builtStep = 0;
+        return false;
+    }
+
+    SetBuildValues(points, values.data());
+    if (isGradients) {
+        SetBuildGradients(points, du.data(), dv.data());
+    }
+    m_builtSourceHash = sourceHash;
+
+    return true;
+}
+
+void NoiseMap::GetBuildPoints(uint32_t step, Points& points) const {
+    if ( m_upperUBound <= m_lowerUBound
+        || m_upperVBound <= m_lowerVBound
+        || m_width <= 0
+        || m_height <= 0
+        || step == 0) {
+        throw noise::ExceptionInvalidParam ();
+    }
+
+    const size_t stride = static_cast<size_t>(m_width) + 2;
+    const bool isAllocated = (m_stride == stride) && (m_values.size() == stride * (static_cast<size_t>(m_height) + 2));
+
+    // The points of the previous build are reused if they are a proper subset of the points of this build,
+    // a build with the same step evaluates all points again.
+    points.step = step;
+    points.prevStep = (isAllocated && (m_builtStep > step) && (m_builtStep % step == 0)) ? m_builtStep : 0;
+    points.x.clear();
+    points.y.clear();
+    points.u.clear();
+    points.v.clear();
+
+    double uDelta  = (m_upperUBound - m_lowerUBound) / static_cast<double>(m_width);
+    double vDelta  = (m_upperVBound - m_lowerVBound) / static_cast<double>(m_height);
+
+    const auto width = static_cast<int32_t>(m_width);
+    const auto height = static_cast<int32_t>(m_height);
+    const auto iStep = static_cast<int32_t>(step);
+    const auto iPrevStep = static_cast<int32_t>(points.prevStep);
+    // the apron is evaluated only with the step 1
+    const int32_t first = (step == 1) ? -1 : 0;
+    const int32_t xLast = (step == 1) ? width : width - 1;
+    const int32_t yLast = (step == 1) ? height : height - 1;
+    for (int32_t y=first; y<=yLast; y+=iStep) {
+        const bool isRowBuilt = (iPrevStep != 0) && (y >= 0) && (y < height) && (y % iPrevStep == 0);
+        const double v = m_lowerVBound + static_cast<double>(y) * vDelta;
+        for (int32_t x=first; x<=xLast; x+=iStep) {
+            const bool isApron = (x < 0) || (x >= width);
+            if ((!isApron) && isRowBuilt && (x % iPrevStep == 0)) {
+                continue;
+            }
+            points.x.push_back(x);
+            points.y.push_back(y);
+            points.u.push_back(m_lowerUBound + static_cast<double>(x) * uDelta);
+            points.v.push_back(v);
+        }
+    }
+}
+
+void NoiseMap::SetBuildValues(const Points& points, const double* values) {
+    if (points.prevStep == 0) {
+        m_stride = static_cast<size_t>(m_width) + 2;
+        m_values.resize(m_stride * (static_cast<size_t>(m_height) + 2));
+    }
+
+    float* pDest = m_values.data() + m_stride + 1;
+    for (size_t i=0; i!=points.x.size(); ++i) {
+        pDest[static_cast<ptrdiff_t>(points.y[i]) * static_cast<ptrdiff_t>(m_stride) + points.x[i]] = static_cast<float>(values[i]);
+    }
+
+    if (points.step != 1) {
+        FillGaps(points.step);
+    }
+    m_builtStep = points.step;
+    m_hasGradients = false;
+}
+
+void NoiseMap::SetBuildGradients(const Points& points, const double* du, const double* dv) {
+    const size_t width = m_width;
+    if (points.prevStep == 0) {
+        m_xGradients.resize(width * m_height);
+        m_yGradients.resize(width * m_height);
+    }
+
+    // the derivatives by u and v are converted to the change per point
+    const double uDelta = (m_upperUBound - m_lowerUBound) / static_cast<double>(m_width);
+    const double vDelta = (m_upperVBound - m_lowerVBound) / static_cast<double>(m_height);
+    for (size_t i=0; i!=points.x.size(); ++i) {
+        const bool isApron = (points.x[i] < 0) || (points.y[i] < 0) || (points.x[i] >= static_cast<int32_t>(m_width)) || (points.y[i] >= static_cast<int32_t>(m_height));
+        if (!isApron) {
+            const size_t index = static_cast<size_t>(points.y[i]) * width + static_cast<size_t>(points.x[i]);
+            m_xGradients[index] = static_cast<float>(du[i] * uDelta);
+            m_yGradients[index] = static_cast<float>(dv[i] * vDelta);
+        }
+    }
+
+    // same as FillGaps
+    const uint32_t step = points.step;
+    if (step != 1) {
+        for (uint32_t y=0; y!=m_height; ++y) {
+            const size_t dest = static_cast<size_t>(y) * width;
+            const size_t source = static_cast<size_t>(y - y % step) * width;
+            for (size_t x=0; x!=width; ++x) {
+                m_xGradients[dest + x] = m_xGradients[source + x - x % step];
+                m_yGradients[dest + x] = m_yGradients[source + x - x % step];
+            }
+        }
+    }
+    m_hasGradients = true;
+}
+
+void NoiseMap::FillGaps(uint32_t step) {
+    const size_t width = m_width;
+    for (uint32_t y=0; y!=m_height; ++y) {
+        float* pDest = m_values.data() + static_cast<size_t>(y + 1) * m_stride + 1;
+        const float* pSource = m_values.data() + static_cast<size_t>(y - y % step + 1) * m_stride + 1;
+        for (size_t x=0; x!=width; ++x) {
+            pDest[x] = pSource[x - x % step];
+        }
+        pDest[-1] = pDest[0];
+        pDest[width] = pDest[width - 1];
+    }
+
+    std::copy_n(m_values.data() + m_stride, m_stride, m_values.data());
+    std::copy_n(m_values.data() + static_cast<size_t>(m_height) * m_stride, m_stride, m_values.data() + static_cast<size_t>(m_height + 1) * m_stride);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // RendererImage class
 
@@ -54,18 +236,8 @@ math::Color RendererImage::CalcDestColor(const math::Color& sourceColor, double
 }
 
 double RendererImage::CalcLightIntensity(double /* center */, double left, double right, double down, double up) const {
-    // Recalculate the sine and cosine of the various light values if
-    // necessary so it does not have to be calculated each time this method is
-    // called.
-    if (m_recalcLightValues) {
-        m_cosAzimuth = cos (m_lightAzimuth * DEG_TO_RAD);
-        m_sinAzimuth = sin (m_lightAzimuth * DEG_TO_RAD);
-        m_cosElev    = cos (m_lightElev    * DEG_TO_RAD);
-        m_sinElev    = sin (m_lightElev    * DEG_TO_RAD);
-        m_recalcLightValues = false;
-    }
-
-    // Now do the lighting calculations.
+    // The sine and cosine of the various light values are calculated by
+    // CalcLightValues() before rendering.
     const double I_MAX = 1.0;
     double io = I_MAX * SQRT_2 * m_sinElev / 2.0;
     double ix = (I_MAX - io) * m_lightContrast * SQRT_2 * m_cosElev * m_cosAzimuth;
@@ -77,73 +249,113 @@ double RendererImage::CalcLightIntensity(double /* center */, double left, doubl
     return intensity;
 }
 
+void RendererImage::CalcLightValues() {
+    // Recalculate the sine and cosine of the various light values if
+    // necessary so it does not have to be calculated for each pixel.
+    if (m_recalcLightValues) {
+        m_cosAzimuth = cos (m_lightAzimuth * DEG_TO_RAD);
+        m_sinAzimuth = sin (m_lightAzimuth * DEG_TO_RAD);
+        m_cosElev    = cos (m_lightElev    * DEG_TO_RAD);
+        m_sinElev    = sin (m_lightElev    * DEG_TO_RAD);
+        m_recalcLightValues = false;
+    }
+}
+
 void RendererImage::ClearGradient() {
     m_gradient.Clear();
 }
 
 ImageView RendererImage::Render() {
-    if ( m_sourceModule == NULL
-        || m_upperUBound <= m_lowerUBound
-        || m_upperVBound <= m_lowerVBound
-        || m_destWidth <= 0
-        || m_destHeight <= 0
+    if ( m_sourceNoiseMap == NULL
+        || m_sourceNoiseMap->GetWidth() <= 0
+        || m_sourceNoiseMap->GetHeight() <= 0
         || m_gradient.Count () < 2) {
         throw noise::ExceptionInvalidParam ();
     }
 
+    const uint32_t width = m_sourceNoiseMap->GetWidth();
+    const uint32_t height = m_sourceNoiseMap->GetHeight();
     auto header = m_destImage.view.header;
-    if ((header.height != m_destHeight) || (header.width != m_destWidth)) {
-            m_destImage.Create(ImageHeader(m_destWidth, m_destHeight, PixelFormat::R8G8B8A8));
-    }
-
-    double uDelta  = (m_upperUBound - m_lowerUBound) / static_cast<double>(m_destWidth);
-    double vDelta  = (m_upperVBound - m_lowerVBound) / static_cast<double>(m_destHeight);
-    double scaledU = m_lowerUBound;
-    double scaledV = m_lowerVBound;
-
-    uint32_t* pDest = reinterpret_cast<uint32_t*>(m_destImage.view.data);
-    for (uint32_t y=0; y!=m_destHeight; ++y) {
-        scaledU = m_lowerUBound;
-        for (uint32_t x=0; x!=m_destWidth; ++x) {
-
-            double sourceValue = m_sourceModule->GetValue(scaledU, scaledV);
-            // Get the color based on the value at the current point in the noise
-            // map.
-            math::Color destColor = m_gradient.Get(sourceValue);
-
-            // If lighting is enabled, calculate the light intensity based on the
-            // rate of change at the current point in the noise map.
-            if (m_isLightEnabled) {
-                // Calculate the positions of the current point's four-neighbors.
-                int xLeftOffset = -1;
-                int xRightOffset = 1;
-                int yDownOffset = -1;
-                int yUpOffset = 1;
-
-                // Get the noise value of the current point in the source noise map
-                // and the noise values of its four-neighbors.
-                double nc = sourceValue;
-                double nl = m_sourceModule->GetValue(scaledU + xLeftOffset * uDelta, scaledV);
-                double nr = m_sourceModule->GetValue(scaledU + xRightOffset * uDelta, scaledV);
-                double nd = m_sourceModule->GetValue(scaledU, scaledV + yDownOffset * vDelta);
-                double nu = m_sourceModule->GetValue(scaledU, scaledV + yUpOffset * vDelta);
-
-                // Now we can calculate the lighting intensity.
-                double lightIntensity = CalcLightIntensity(nc, nl, nr, nd, nu);
-                lightIntensity *= m_lightBrightness;
-                *pDest = CalcDestColor(destColor, lightIntensity).value;
-            } else {
-                *pDest = destColor.value;
-            }
+    if ((header.height != height) || (header.width != width)) {
+            m_destImage.Create(ImageHeader(width, height, PixelFormat::R8G8B8A8));
+    }
+
+    if (m_isLightEnabled) {
+        CalcLightValues();
+    }
+
+    // Every row is calculated independently, so the result is the same for any number of threads.
+    auto& pool = ThreadPool::Get();
+    const uint32_t workerCount = (m_workerCount == 0) ? pool.GetThreadCount() : m_workerCount;
+    const uint32_t rowsPerTask = std::max(height / (workerCount * 4), 1u);
+    pool.ParallelFor(0, height, rowsPerTask, workerCount, [this](uint32_t yBegin, uint32_t yEnd) {
+        RenderRows(yBegin, yEnd);
+    });
+
+    return m_destImage.view;
+}
+
+void RendererImage::RenderRows(uint32_t yBegin, uint32_t yEnd) const {
+    const size_t width = m_sourceNoiseMap->GetWidth();
+    uint32_t* pDest = reinterpret_cast<uint32_t*>(m_destImage.view.data) + static_cast<size_t>(yBegin) * width;
+    for (uint32_t y=yBegin; y!=yEnd; ++y) {
+        // Get the colors based on the values of the row in the noise map.
+        const float* pSource = m_sourceNoiseMap->GetRow(static_cast<int32_t>(y));
+        m_gradient.Colorize(pSource, pDest, width);
+        if (!m_isLightEnabled) {
+            pDest += width;
+            continue;
+        }
+
+        if (m_sourceNoiseMap->HasGradients()) {
+            RenderLightFromGradients(static_cast<int32_t>(y), pSource, pDest);
+            pDest += width;
+            continue;
+        }
+
+        // If lighting is enabled, calculate the light intensity based on the
+        // rate of change at the current point in the noise map.  The
+        // four-neighbors of the points of the row are read from the apron of
+        // the noise map at the borders.
+        const float* pSourceDown = m_sourceNoiseMap->GetRow(static_cast<int32_t>(y) - 1);
+        const float* pSourceUp = m_sourceNoiseMap->GetRow(static_cast<int32_t>(y) + 1);
+        for (size_t x=0; x!=width; ++x) {
+            math::Color destColor;
+            destColor.value = *pDest;
+            double lightIntensity = CalcLightIntensity(
+                static_cast<double>(pSource[0]),
+                static_cast<double>(pSource[-1]),
+                static_cast<double>(pSource[1]),
+                static_cast<double>(*pSourceDown),
+                static_cast<double>(*pSourceUp));
+            lightIntensity *= m_lightBrightness;
+            *pDest = CalcDestColor(destColor, lightIntensity).value;
 
             // Go to the next point.
+            ++pSource;
+            ++pSourceDown;
+            ++pSourceUp;
             ++pDest;
-            scaledU += uDelta;
         }
-        scaledV += vDelta;
     }
+}
 
-    return m_destImage.view;
+void RendererImage::RenderLightFromGradients(int32_t y, const float* pSource, uint32_t* pDest) const {
+    // The four-neighbors are extrapolated from the analytic gradients of the
+    // noise map.
+    const float* pXGradient = m_sourceNoiseMap->GetXGradientRow(y);
+    const float* pYGradient = m_sourceNoiseMap->GetYGradientRow(y);
+    const size_t width = m_sourceNoiseMap->GetWidth();
+    for (size_t x=0; x!=width; ++x) {
+        const auto center = static_cast<double>(pSource[x]);
+        const auto dx = static_cast<double>(pXGradient[x]);
+        const auto dy = static_cast<double>(pYGradient[x]);
+        math::Color destColor;
+        destColor.value = pDest[x];
+        double lightIntensity = CalcLightIntensity(center, center - dx, center + dx, center - dy, center + dy);
+        lightIntensity *= m_lightBrightness;
+        pDest[x] = CalcDestColor(destColor, lightIntensity).value;
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -169,48 +381,57 @@ math::Color RendererNormalMap::CalcNormalColor(double nc, double nr, double nu,
 }
 
 ImageView RendererNormalMap::Render() {
-    if ( m_sourceModule == NULL
-        || m_upperUBound <= m_lowerUBound
-        || m_upperVBound <= m_lowerVBound
-        || m_destWidth <= 0
-        || m_destHeight <= 0) {
+    if ( m_sourceNoiseMap == NULL
+        || m_sourceNoiseMap->GetWidth() <= 0
+        || m_sourceNoiseMap->GetHeight() <= 0) {
         throw noise::ExceptionInvalidParam ();
     }
 
+    const uint32_t width = m_sourceNoiseMap->GetWidth();
+    const uint32_t height = m_sourceNoiseMap->GetHeight();
     auto header = m_destImage.view.header;
-    if ((header.height != m_destHeight) || (header.width != m_destWidth)) {
-            m_destImage.Create(ImageHeader(m_destWidth, m_destHeight, PixelFormat::R8G8B8A8));
+    if ((header.height != height) || (header.width != width)) {
+            m_destImage.Create(ImageHeader(width, height, PixelFormat::R8G8B8A8));
     }
 
-    double uDelta  = (m_upperUBound - m_lowerUBound) / static_cast<double>(m_destWidth);
-    double vDelta  = (m_upperVBound - m_lowerVBound) / static_cast<double>(m_destHeight);
-    double scaledU = m_lowerUBound;
-    double scaledV = m_lowerVBound;
-
-    uint32_t* pDest = reinterpret_cast<uint32_t*>(m_destImage.view.data);
-    for (uint32_t y=0; y!=m_destHeight; ++y) {
-        scaledU = m_lowerUBound;
-        for (uint32_t x=0; x!=m_destWidth; ++x) {
+    auto& pool = ThreadPool::Get();
+    const uint32_t workerCount = (m_workerCount == 0) ? pool.GetThreadCount() : m_workerCount;
+    const uint32_t rowsPerTask = std::max(height / (workerCount * 4), 1u);
+    pool.ParallelFor(0, height, rowsPerTask, workerCount, [this](uint32_t yBegin, uint32_t yEnd) {
+        RenderRows(yBegin, yEnd);
+    });
 
-            // Calculate the positions of the current point's right and up neighbors.
-            int xRightOffset = 1;
-            int yUpOffset = 1;
+    return m_destImage.view;
+}
 
-            // Get the noise value of the current point in the source noise map
-            // and the noise values of its right and up neighbors.
-            double nc = m_sourceModule->GetValue(scaledU, scaledV);
-            double nr = m_sourceModule->GetValue(scaledU + xRightOffset * uDelta, scaledV);
-            double nu = m_sourceModule->GetValue(scaledU, scaledV + yUpOffset * vDelta);
+void RendererNormalMap::RenderRows(uint32_t yBegin, uint32_t yEnd) const {
+    const size_t width = m_sourceNoiseMap->GetWidth();
+    uint32_t* pDest = reinterpret_cast<uint32_t*>(m_destImage.view.data) + static_cast<size_t>(yBegin) * width;
+    for (uint32_t y=yBegin; y!=yEnd; ++y) {
+        // The right and up neighbors are extrapolated from the analytic
+        // gradients if the noise map has them.
+        if (m_sourceNoiseMap->HasGradients()) {
+            const float* pSource = m_sourceNoiseMap->GetRow(static_cast<int32_t>(y));
+            const float* pXGradient = m_sourceNoiseMap->GetXGradientRow(static_cast<int32_t>(y));
+            const float* pYGradient = m_sourceNoiseMap->GetYGradientRow(static_cast<int32_t>(y));
+            for (size_t x=0; x!=width; ++x) {
+                const auto center = static_cast<double>(pSource[x]);
+                *pDest++ = CalcNormalColor(center, center + static_cast<double>(pXGradient[x]), center + static_cast<double>(pYGradient[x]), m_bumpHeight).value;
+            }
+            continue;
+        }
 
+        // The right and up neighbors of the last column and row are in the apron.
+        const float* pSource = m_sourceNoiseMap->GetRow(static_cast<int32_t>(y));
+        const float* pSourceUp = m_sourceNoiseMap->GetRow(static_cast<int32_t>(y) + 1);
+        for (size_t x=0; x!=width; ++x) {
             // Calculate the normal product.
-            *pDest = CalcNormalColor (nc, nr, nu, m_bumpHeight).value;
+            *pDest = CalcNormalColor (static_cast<double>(pSource[0]), static_cast<double>(pSource[1]), static_cast<double>(*pSourceUp), m_bumpHeight).value;
 
             // Go to the next point.
+            ++pSource;
+            ++pSourceUp;
             ++pDest;
-            scaledU += uDelta;
         }
-        scaledV += vDelta;
     }
-
-    return m_destImage.view;
 }
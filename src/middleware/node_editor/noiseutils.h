@@ -22,6 +22,9 @@
 //
 
 
+#include <atomic>
+#include <vector>
+
 #include "engine/material/image.h"
 #include "middleware/node_editor/noise_2d.h"
 #include "middleware/node_editor/node_render.h"
@@ -30,6 +33,324 @@ using namespace noise;
 
 namespace noise {
     namespace utils {
+        /// A noise map: the values of a 2D noise module on a regular grid,
+        /// stored as floats.
+        ///
+        /// The map contains one extra point around the borders (the apron),
+        /// so the renderers can read the four neighbors of every point without
+        /// evaluating the module again.  The values are calculated once by the
+        /// Build() method, after that the same map can be used by several
+        /// renderers (colors, lighting, normal map, heights).
+        ///
+        /// The point (x, y) has the coordinates
+        /// (lowerUBound + x * uDelta, lowerVBound + y * vDelta), where
+        /// uDelta = (upperUBound - lowerUBound) / width and
+        /// vDelta = (upperVBound - lowerVBound) / height, x is in [-1, width],
+        /// y is in [-1, height].
+        ///
+        /// If the gradients are enabled and the source module supports them,
+        /// the map also contains the analytic partial derivatives of the values
+        /// by x and y, the renderers use them instead of the four-neighbors.
+        class NoiseMap {
+            public:
+                /// The number of points evaluated by one task of the ThreadPool.
+                static constexpr const size_t ChunkSize = 256;
+
+                /// The points of the noise map evaluated by one build step.
+                struct Points {
+                    /// The step of the build.
+                    uint32_t step = 0;
+
+                    /// The step of the previous build whose points are reused,
+                    /// 0 - no points are reused.
+                    uint32_t prevStep = 0;
+
+                    /// The column and the row of every point.
+                    std::vector<int32_t> x;
+                    std::vector<int32_t> y;
+
+                    /// The coordinates of every point.
+                    std::vector<double> u;
+                    std::vector<double> v;
+                };
+
+            public:
+                NoiseMap() = default;
+
+                /// Evaluates the source module for the points of the noise map.
+                ///
+                /// @param step Only the points (x, y), where x and y are multiples
+                /// of step, are evaluated, the other points get the value of the
+                /// nearest evaluated point to the top-left.  1 evaluates all
+                /// points including the apron.
+                ///
+                /// @pre SetSourceModule() has been previously called.
+                /// @pre The bounds and the size of the map are specified.
+                ///
+                /// @returns false if the build was cancelled, the values of the
+                /// map are undefined in this case.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// Progressive build: if the previous build used a coarser step
+                /// that is a multiple of the step (for example 8, 4, 2, 1), the
+                /// points evaluated by it are reused.  The evaluated point has the
+                /// same value for any step, so the result of Build(1) does not
+                /// depend on the previous builds.  The points are not reused if
+                /// the hash of the source module (BaseNoise2DNode::GetHash())
+                /// changed since the previous build or after Invalidate(), a
+                /// build with the same step evaluates all its points again.
+                bool Build(uint32_t step = 1);
+
+                /// Discards the previous build, the next build evaluates all its
+                /// points.
+                void Invalidate() {
+                    m_builtStep = 0;
+                }
+
+                /// Returns the points evaluated by Build(step), in the order of
+                /// the evaluation, without evaluating them.
+                ///
+                /// @param step The step of the build.
+                /// @param points The points.
+                ///
+                /// @pre The bounds and the size of the map are specified.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The two methods GetBuildPoints() and SetBuildValues() split
+                /// Build() so the values can be calculated by the caller, the
+                /// maps of the same size and bounds with the same previous build
+                /// have the same points.
+                void GetBuildPoints(uint32_t step, Points& points) const;
+
+                /// Stores the values of the points returned by GetBuildPoints()
+                /// and completes the build as Build(points.step) does.
+                ///
+                /// @param points The points returned by GetBuildPoints().
+                /// @param values The values of the points.
+                void SetBuildValues(const Points& points, const double* values);
+
+                /// Returns the height of the noise map, without the apron.
+                uint32_t GetHeight() const {
+                    return m_height;
+                }
+
+                /// Returns the width of the noise map, without the apron.
+                uint32_t GetWidth() const {
+                    return m_width;
+                }
+
+                /// Returns the size of the values and the gradients of the noise
+                /// map, in bytes.
+                size_t GetMemorySize() const {
+                    return (m_values.size() + m_xGradients.size() + m_yGradients.size()) * sizeof(float);
+                }
+
+                /// Returns a pointer to the point (0, y) of the noise map.
+                ///
+                /// @param y The row, from -1 to height inclusive.
+                ///
+                /// The elements from -1 to width inclusive of the returned row
+                /// can be read.
+                const float* GetRow(int32_t y) const {
+                    return m_values.data() + static_cast<size_t>(y + 1) * m_stride + 1;
+                }
+
+                /// Returns the value of the point (x, y) of the noise map.
+                ///
+                /// @param x The column, from -1 to width inclusive.
+                /// @param y The row, from -1 to height inclusive.
+                float GetValue(int32_t x, int32_t y) const {
+                    return m_values[static_cast<size_t>(y + 1) * m_stride + static_cast<size_t>(x + 1)];
+                }
+
+                /// Determines if the map contains the gradients, see
+                /// EnableGradients().
+                bool HasGradients() const {
+                    return m_hasGradients;
+                }
+
+                /// Returns a pointer to the derivative of the value by x of the
+                /// point (0, y), the change of the value per point along the row.
+                ///
+                /// @param y The row, from 0 to height - 1.
+                ///
+                /// @pre HasGradients() returns true.
+                ///
+                /// The elements from 0 to width - 1 of the returned row can be
+                /// read.
+                const float* GetXGradientRow(int32_t y) const {
+                    return m_xGradients.data() + static_cast<size_t>(y) * m_width;
+                }
+
+                /// Returns a pointer to the derivative of the value by y of the
+                /// point (0, y), the change of the value per point along the
+                /// column.
+                ///
+                /// @param y The row, from 0 to height - 1.
+                ///
+                /// @pre HasGradients() returns true.
+                const float* GetYGradientRow(int32_t y) const {
+                    return m_yGradients.data() + static_cast<size_t>(y) * m_width;
+                }
+
+                void SetBounds(double lowerUBound, double upperUBound, double lowerVBound, double upperVBound) {
+                    if (lowerUBound >= upperUBound || lowerVBound >= upperVBound) {
+                        throw noise::ExceptionInvalidParam ();
+                    }
+
+                    m_lowerUBound = lowerUBound;
+                    m_upperUBound = upperUBound;
+                    m_lowerVBound = lowerVBound;
+                    m_upperVBound = upperVBound;
+                    m_builtStep = 0;
+                }
+
+                void SetSize(uint32_t width, uint32_t height) {
+                    m_width = width;
+                    m_height = height;
+                    m_builtStep = 0;
+                }
+
+                void SetSourceModule(const BaseNoise2DNode* sourceModule) {
+                    m_sourceModule = sourceModule;
+                    m_builtStep = 0;
+                }
+
+                /// Sets the flag that cancels the build.
+                ///
+                /// @param cancelled The flag, checked before every row, nullptr -
+                /// the build can not be cancelled.
+                void SetCancelFlag(const std::atomic<bool>* cancelled) {
+                    m_cancelled = cancelled;
+                }
+
+                /// Enables or disables the culling of the octaves above the
+                /// Nyquist limit of the map.
+                ///
+                /// @param enable A flag that enables or disables the culling.
+                ///
+                /// If the culling is enabled, the fractal generators skip the
+                /// octaves that are too fine for the distance between the points
+                /// of the map and fade out the last kept octave (see
+                /// NoisePoints::spacing), the map is cheaper and has less
+                /// aliasing.  Disabled by default, the values are exact.
+                void EnableBandLimit(bool enable = true) {
+                    m_isBandLimited = enable;
+                    m_builtStep = 0;
+                }
+                /// Determines if the culling of the octaves is enabled.
+                bool IsBandLimited() const {
+                    return m_isBandLimited;
+                }
+                /// Enables or disables the analytic gradients.
+                ///
+                /// @param enable A flag that enables or disables the gradients.
+                ///
+                /// If the gradients are enabled and the source module supports
+                /// them (BaseNoise2DNode::HasGradients()), Build() evaluates the
+                /// values together with their exact partial derivatives in double
+                /// precision (slower than the values alone, the precision set by
+                /// SetPrecision() is not used), otherwise only the values are
+                /// evaluated.  Disabled by default.
+                void EnableGradients(bool enable = true) {
+                    m_isGradientEnabled = enable;
+                    m_builtStep = 0;
+                }
+                /// Sets the precision of the fractal generators.
+                ///
+                /// @param precision The precision, NoisePrecision::Double by
+                /// default.
+                ///
+                /// NoisePrecision::Single is about twice faster, the deviation of
+                /// the values is bounded by
+                /// BaseNoise3DNode::GetSinglePrecisionError().
+                void SetPrecision(NoisePrecision precision) {
+                    m_precision = precision;
+                    m_builtStep = 0;
+                }
+                /// Sets the number of threads used to build the noise map.
+                ///
+                /// @param workerCount The number of threads, 0 means all threads
+                /// of the ThreadPool, 1 builds on the calling thread.
+                void SetWorkerCount(uint32_t workerCount) {
+                    m_workerCount = workerCount;
+                }
+
+            private:
+
+                /// Copies the evaluated points to the points between them and to
+                /// the apron.
+                void FillGaps(uint32_t step);
+
+                /// Stores the derivatives of the points returned by
+                /// GetBuildPoints(), after SetBuildValues().
+                void SetBuildGradients(const Points& points, const double* du, const double* dv);
+
+                /// Lower x boundary of the planar noise map, in units.
+                /// Southern boundary of the spherical noise map, in degrees.
+                /// Lower angle boundary of the cylindrical noise map, in degrees.
+                double m_lowerUBound = 0;
+
+                /// Lower z boundary of the planar noise map, in units.
+                /// Western boundary of the spherical noise map, in degrees.
+                /// Lower height boundary of the cylindrical noise map, in units.
+                double m_lowerVBound = 0;
+
+                /// Upper x boundary of the planar noise map, in units.
+                /// Eastern boundary of the spherical noise map, in degrees.
+                /// Upper angle boundary of the cylindrical noise map, in degrees.
+                double m_upperUBound = 0;
+
+                /// Upper z boundary of the planar noise map, in units.
+                /// Northern boundary of the spherical noise map, in degrees.
+                /// Upper height boundary of the cylindrical noise map, in units.
+                double m_upperVBound = 0;
+
+                /// Height of the noise map, in points.
+                uint32_t m_height = 0;
+
+                /// Width of the noise map, in points.
+                uint32_t m_width = 0;
+
+                /// The distance between the rows of m_values, width + 2.
+                size_t m_stride = 0;
+
+                /// The values of the points, (width + 2) * (height + 2) elements.
+                std::vector<float> m_values;
+
+                /// The derivatives of the values by x and y per point, width *
+                /// height elements without the apron.
+                std::vector<float> m_xGradients;
+                std::vector<float> m_yGradients;
+
+                /// Determines if the last build evaluated the gradients.
+                bool m_hasGradients = false;
+
+                /// The step of the last successful build, 0 - the map is not built.
+                uint32_t m_builtStep = 0;
+
+                /// The hash of the source module at the last successful build.
+                size_t m_builtSourceHash = 0;
+
+                /// A pointer to the source module.
+                const BaseNoise2DNode* m_sourceModule = nullptr;
+
+                /// A pointer to the flag that cancels the build.
+                const std::atomic<bool>* m_cancelled = nullptr;
+
+                /// The number of threads used to build the noise map, 0 - all threads.
+                uint32_t m_workerCount = 0;
+                /// Determines if the octaves above the Nyquist limit are culled.
+                bool m_isBandLimited = false;
+                /// The precision of the fractal generators.
+                NoisePrecision m_precision = NoisePrecision::Double;
+                /// Determines if the gradients are evaluated when the source
+                /// module supports them.
+                bool m_isGradientEnabled = false;
+        };
+
         class RendererImage {
         public:
                 RendererImage();
@@ -157,6 +478,14 @@ namespace noise {
                     return m_lightIntensity;
                 }
 
+                /// Returns the number of threads used to render the image.
+                ///
+                /// @returns The number of threads, 0 means all threads of the
+                /// ThreadPool.
+                uint32_t GetWorkerCount() const {
+                    return m_workerCount;
+                }
+
                 /// Determines if the light source is enabled.
                 ///
                 /// @returns
@@ -184,22 +513,6 @@ namespace noise {
                 /// irretrievably blended into the background image.
                 ImageView Render();
 
-                void SetBounds(double lowerUBound, double upperUBound, double lowerVBound, double upperVBound) {
-                    if (lowerUBound >= upperUBound || lowerVBound >= upperVBound) {
-                        throw noise::ExceptionInvalidParam ();
-                    }
-
-                    m_lowerUBound = lowerUBound;
-                    m_upperUBound = upperUBound;
-                    m_lowerVBound = lowerVBound;
-                    m_upperVBound = upperVBound;
-                }
-
-                void SetDestSize(uint32_t destWidth, uint32_t destHeight) {
-                    m_destWidth = destWidth;
-                    m_destHeight = destHeight;
-                }
-
                 /// Sets the azimuth of the light source, in degrees.
                 ///
                 /// @param lightAzimuth The azimuth of the light source.
@@ -300,8 +613,26 @@ namespace noise {
                     m_recalcLightValues = true;
                 }
 
-                void SetSourceModule(const BaseNoise2DNode* sourceModule) {
-                    m_sourceModule = sourceModule;
+                /// Sets the source noise map.
+                ///
+                /// @param sourceNoiseMap The source noise map.
+                ///
+                /// The destination image has the same size as the noise map.
+                /// The noise map must exist throughout the lifetime of this
+                /// object unless another noise map replaces that noise map.
+                void SetSourceNoiseMap(const NoiseMap& sourceNoiseMap) {
+                    m_sourceNoiseMap = &sourceNoiseMap;
+                }
+
+                /// Sets the number of threads used to render the image.
+                ///
+                /// @param workerCount The number of threads, 0 means all threads
+                /// of the ThreadPool, 1 renders on the calling thread.
+                ///
+                /// The destination image is split into bands of rows, the result
+                /// does not depend on the number of threads.
+                void SetWorkerCount(uint32_t workerCount) {
+                    m_workerCount = workerCount;
                 }
 
             private:
@@ -329,11 +660,26 @@ namespace noise {
                 /// These values come directly from the noise map.
                 double CalcLightIntensity(double center, double left, double right, double down, double up) const;
 
+                /// Recalculates the sine and cosine of the light values if the light
+                /// parameters have changed.
+                ///
+                /// Called once before the rows are rendered, so the
+                /// CalcLightIntensity() method does not modify the object and can
+                /// be called from several threads.
+                void CalcLightValues();
+
+                /// Renders the rows [yBegin, yEnd) of the destination image.
+                void RenderRows(uint32_t yBegin, uint32_t yEnd) const;
+
+                /// Applies the light to the row y of the destination image
+                /// using the gradients of the noise map.
+                void RenderLightFromGradients(int32_t y, const float* pSource, uint32_t* pDest) const;
+
                 /// The cosine of the azimuth of the light source.
-                mutable double m_cosAzimuth;
+                double m_cosAzimuth = 0;
 
                 /// The cosine of the elevation of the light source.
-                mutable double m_cosElev;
+                double m_cosElev = 0;
 
                 /// The color gradient used to specify the image colors.
                 GradientColor m_gradient;
@@ -359,50 +705,27 @@ namespace noise {
                 /// The intensity of the light source.
                 double m_lightIntensity = 1.0;
 
-                /// Lower x boundary of the planar noise map, in units.
-                /// Southern boundary of the spherical noise map, in degrees.
-                /// Lower angle boundary of the cylindrical noise map, in degrees.
-                double m_lowerUBound = 0;
-
-                /// Lower z boundary of the planar noise map, in units.
-                /// Western boundary of the spherical noise map, in degrees.
-                /// Lower height boundary of the cylindrical noise map, in units.
-                double m_lowerVBound = 0;
-
-                /// Upper x boundary of the planar noise map, in units.
-                /// Eastern boundary of the spherical noise map, in degrees.
-                /// Upper angle boundary of the cylindrical noise map, in degrees.
-                double m_upperUBound = 0;
-
-                /// Upper z boundary of the planar noise map, in units.
-                /// Northern boundary of the spherical noise map, in degrees.
-                /// Upper height boundary of the cylindrical noise map, in units.
-                double m_upperVBound = 0;
-
-                /// Height of the destination noise map, in points.
-                uint32_t m_destHeight = 0;
-
-                /// Width of the destination noise map, in points.
-                uint32_t m_destWidth = 0;
-
                 Image m_destImage;
 
                 /// A pointer to the source noise map.
-                const BaseNoise2DNode* m_sourceModule = nullptr;
+                const NoiseMap* m_sourceNoiseMap = nullptr;
 
-                /// Used by the CalcLightIntensity() method to recalculate the light
+                /// Used by the CalcLightValues() method to recalculate the light
                 /// values only if the light parameters change.
                 ///
                 /// When the light parameters change, this value is set to True.  When
-                /// the CalcLightIntensity() method is called, this value is set to
+                /// the CalcLightValues() method is called, this value is set to
                 /// false.
-                mutable bool m_recalcLightValues = true;
+                bool m_recalcLightValues = true;
 
                 /// The sine of the azimuth of the light source.
-                mutable double m_sinAzimuth;
+                double m_sinAzimuth = 0;
 
                 /// The sine of the elevation of the light source.
-                mutable double m_sinElev;
+                double m_sinElev = 0;
+
+                /// The number of threads used to render the image, 0 - all threads.
+                uint32_t m_workerCount = 0;
         };
 
         /// Renders a normal map from a noise map.
@@ -473,24 +796,23 @@ namespace noise {
                     m_bumpHeight = bumpHeight;
                 }
 
-                void SetBounds(double lowerUBound, double upperUBound, double lowerVBound, double upperVBound) {
-                    if (lowerUBound >= upperUBound || lowerVBound >= upperVBound) {
-                        throw noise::ExceptionInvalidParam ();
-                    }
-
-                    m_lowerUBound = lowerUBound;
-                    m_upperUBound = upperUBound;
-                    m_lowerVBound = lowerVBound;
-                    m_upperVBound = upperVBound;
-                }
-
-                void SetDestSize(uint32_t destWidth, uint32_t destHeight) {
-                    m_destWidth = destWidth;
-                    m_destHeight = destHeight;
+                /// Sets the source noise map.
+                ///
+                /// @param sourceNoiseMap The source noise map.
+                ///
+                /// The destination image has the same size as the noise map.
+                /// The noise map must exist throughout the lifetime of this
+                /// object unless another noise map replaces that noise map.
+                void SetSourceNoiseMap(const NoiseMap& sourceNoiseMap) {
+                    m_sourceNoiseMap = &sourceNoiseMap;
                 }
 
-                void SetSourceModule(const BaseNoise2DNode& sourceModule) {
-                    m_sourceModule = &sourceModule;
+                /// Sets the number of threads used to render the normal map.
+                ///
+                /// @param workerCount The number of threads, 0 means all threads
+                /// of the ThreadPool, 1 renders on the calling thread.
+                void SetWorkerCount(uint32_t workerCount) {
+                    m_workerCount = workerCount;
                 }
 
             private:
@@ -518,39 +840,19 @@ namespace noise {
                 /// the application.
                 math::Color CalcNormalColor (double nc, double nr, double nu, double bumpHeight) const;
 
+                /// Renders the rows [yBegin, yEnd) of the normal map.
+                void RenderRows(uint32_t yBegin, uint32_t yEnd) const;
+
                 /// The bump height for the normal map.
                 double m_bumpHeight = 1.0;
 
                 Image m_destImage;
 
-                /// Lower x boundary of the planar noise map, in units.
-                /// Southern boundary of the spherical noise map, in degrees.
-                /// Lower angle boundary of the cylindrical noise map, in degrees.
-                double m_lowerUBound = 0;
-
-                /// Lower z boundary of the planar noise map, in units.
-                /// Western boundary of the spherical noise map, in degrees.
-                /// Lower height boundary of the cylindrical noise map, in units.
-                double m_lowerVBound = 0;
-
-                /// Upper x boundary of the planar noise map, in units.
-                /// Eastern boundary of the spherical noise map, in degrees.
-                /// Upper angle boundary of the cylindrical noise map, in degrees.
-                double m_upperUBound = 0;
-
-                /// Upper z boundary of the planar noise map, in units.
-                /// Northern boundary of the spherical noise map, in degrees.
-                /// Upper height boundary of the cylindrical noise map, in units.
-                double m_upperVBound = 0;
-
-                /// Height of the destination noise map, in points.
-                uint32_t m_destHeight = 0;
-
-                /// Width of the destination noise map, in points.
-                uint32_t m_destWidth = 0;
-
                 /// A pointer to the source noise map.
-                const BaseNoise2DNode* m_sourceModule = nullptr;
+                const NoiseMap* m_sourceNoiseMap = nullptr;
+
+                /// The number of threads used to render the normal map, 0 - all threads.
+                uint32_t m_workerCount = 0;
         };
     }
 }
@@ -1,69 +1,275 @@
 #include "middleware/node_editor/preview_node.h"
 
+#include <cstring>
+#include <algorithm>
 #include <imgui.h>
 
 #include "engine/gui/widgets.h"
 #include "engine/common/exception.h"
-#include "engine/material/texture_manager.h"
+#include "engine/common/thread_pool.h"
 #include "middleware/node_editor/noise_2d.h"
-#include "middleware/node_editor/noise_3d.h"
 #include "middleware/node_editor/noiseutils.h"
+#include "middleware/node_editor/graph_file.h"
+#include "middleware/node_editor/noise_map_cache.h"
 
 
-PreviewNode::PreviewNode(const std::string& name)
-    : BaseNode(name) {
+// Rendering of one preview in the thread pool,
+// the job owns the noise map and the images, so a cancelled job does not touch the buffers of the next one.
+// The job evaluates its own copy of the subgraph (see NodeFactory::CloneSubgraph) made when the job is created,
+// so the editor can change the parameters and the links of the nodes while the job is running.
+// The preview is rendered progressively: the first pass evaluates about 16x16 points,
+// every next pass halves the step of the noise map and reuses the points of the previous pass,
+// the last pass evaluates all points. The octaves above the Nyquist limit of the preview are culled,
+// the fractal generators are evaluated in single precision. After every pass the image is published to the result,
+// which is uploaded to the texture on the main thread.
+// If the noise map is found in NoiseMapCache, only the image is rendered,
+// the noise map built by the last pass is added to the cache.
+class PreviewJob : Noncopyable {
+public:
+    static constexpr const uint32_t FirstPassSize = 16;
+
+public:
+    PreviewJob() = delete;
+    PreviewJob(const BaseNoise2DNode* sourceModule, uint32_t size);
+    // Only renders the noise map built by somebody else
+    PreviewJob(const std::shared_ptr<const noise::utils::NoiseMap>& noiseMap);
+    ~PreviewJob() = default;
+
+    // Called in the thread pool
+    void Run();
+
+    void Cancel() noexcept { m_cancelled = true; }
+    void Wait() { m_result->Wait(); }
+    bool IsFinished() const noexcept { return m_result->IsFinished(); }
+    std::shared_ptr<PreviewResult> GetResult() const noexcept { return m_result; }
+
+private:
+    std::atomic<bool> m_cancelled = false;
+    std::shared_ptr<PreviewResult> m_result = std::make_shared<PreviewResult>();
+
+    uint32_t m_firstStep = 1;
+    // invalid - the noise map can not be cached
+    NoiseMapKey m_cacheKey;
+    std::shared_ptr<const noise::utils::NoiseMap> m_cachedNoiseMap;
+    // the copy of the source node with its subgraph, the noise map is built from it
+    std::shared_ptr<const BaseNoise2DNode> m_sourceModule;
+    std::shared_ptr<noise::utils::NoiseMap> m_noiseMap;
+    noise::utils::RendererImage m_renderer;
+};
+
+PreviewJob::PreviewJob(const BaseNoise2DNode* sourceModule, uint32_t size)
+    : m_cacheKey(NoiseMapCache::GetKey(sourceModule,
+        PreviewNode::LowerUBound, PreviewNode::UpperUBound, PreviewNode::LowerVBound, PreviewNode::UpperVBound, size, size,
+        NoisePrecision::Single, true)) {
 
+    if (m_cacheKey.IsValid()) {
+        m_cachedNoiseMap = NoiseMapCache::Get().Find(m_cacheKey);
+    }
+    if (m_cachedNoiseMap) {
+        m_renderer.SetSourceNoiseMap(*m_cachedNoiseMap);
+        return;
+    }
+
+    m_sourceModule = std::dynamic_pointer_cast<const BaseNoise2DNode>(NodeFactory::CloneSubgraph(sourceModule));
+    m_noiseMap = std::make_shared<noise::utils::NoiseMap>();
+    m_noiseMap->SetSourceModule(m_sourceModule.get());
+    m_noiseMap->SetSize(size, size);
+    m_noiseMap->SetBounds(PreviewNode::LowerUBound, PreviewNode::UpperUBound, PreviewNode::LowerVBound, PreviewNode::UpperVBound);
+    m_noiseMap->SetCancelFlag(&m_cancelled);
+    m_noiseMap->EnableBandLimit();
+    m_noiseMap->SetPrecision(NoisePrecision::Single);
+    m_renderer.SetSourceNoiseMap(*m_noiseMap);
+
+    while (size / (m_firstStep * 2) >= FirstPassSize) {
+        m_firstStep *= 2;
+    }
 }
 
-PreviewNode::~PreviewNode() {
-    if (m_shapePreview != nullptr) {
-        delete m_shapePreview;
-        m_shapePreview = nullptr;
+PreviewJob::PreviewJob(const std::shared_ptr<const noise::utils::NoiseMap>& noiseMap)
+    : m_cachedNoiseMap(noiseMap) {
+
+    m_renderer.SetSourceNoiseMap(*m_cachedNoiseMap);
+}
+
+void PreviewJob::Run() {
+    try {
+        if (m_cachedNoiseMap) {
+            if (!m_cancelled.load()) {
+                m_result->Publish(m_renderer.Render());
+            }
+        } else {
+            bool isBuilt = false;
+            for (uint32_t step=m_firstStep; step!=0; step/=2) {
+                if (m_cancelled.load() || (!m_noiseMap->Build(step))) {
+                    break;
+                }
+                m_result->Publish(m_renderer.Render());
+                isBuilt = (step == 1);
+            }
+
+            if (isBuilt && m_cacheKey.IsValid()) {
+                // the flag belongs to this job, the cached map is never built again
+                m_noiseMap->SetCancelFlag(nullptr);
+                NoiseMapCache::Get().Insert(m_cacheKey, m_noiseMap);
+            }
+        }
+    } catch(...) {
+        m_result->SetError(std::current_exception());
     }
-    if (m_renderedPreview != nullptr) {
-        delete m_renderedPreview;
-        m_renderedPreview = nullptr;
+
+    m_result->Finish();
+}
+
+void PreviewResult::Publish(const ImageView& view) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_published.view.header != view.header) {
+        m_published.Create(view.header);
     }
+    std::memcpy(m_published.view.data, view.data, view.header.GetSize());
+    m_publishedVersion++;
+}
+
+void PreviewResult::SetError(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error = error;
 }
 
-void PreviewNode::UpdatePreview(const ImageView& view) {
-    if (view.header.width != m_previewSize) {
-        throw EngineError("the width={} of the image for preview should be equal previewSize={}", view.header.width, m_previewSize);
+void PreviewResult::Finish() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_finished = true;
+    m_condition.notify_all();
+}
+
+void PreviewResult::Wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return m_finished.load(); });
+}
+
+void PreviewResult::Upload(PreviewTexture& texture) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_error) {
+        std::rethrow_exception(m_error);
     }
 
-    if (view.header.height != m_previewSize) {
-        throw EngineError("the height={} of the image for preview should be equal previewSize={}", view.header.height, m_previewSize);
+    if (m_publishedVersion != m_uploadedVersion) {
+        texture.Update(m_published.view);
+        m_uploadedVersion = m_publishedVersion;
     }
+}
 
-    m_texturePreview.UpdateOrCreate(view);
+static PreviewNode::TextureFactory& GetTextureFactory() {
+    static PreviewNode::TextureFactory factory;
+    return factory;
 }
 
-void PreviewNode::UpdatePreview(const BaseNoise2DNode* sourceModule) {
-    if (m_renderedPreview == nullptr) {
-        m_renderedPreview = new noise::utils::RendererImage();
-        m_renderedPreview->SetSourceModule(sourceModule);
-        m_renderedPreview->SetDestSize(m_previewSize, m_previewSize);
-        m_renderedPreview->SetBounds(2.0, 6.0, 1.0, 5.0);
+PreviewNode::PreviewNode(const std::string& name)
+    : BaseNode(name) {
+
+}
+
+PreviewNode::~PreviewNode() {
+    CancelBackgroundWork();
+    for (const auto& job: m_cancelledJobs) {
+        job->Wait();
     }
+    if (m_previewJob) {
+        m_previewJob->Wait();
+    }
+}
+
+void PreviewNode::UpdatePreview(const BaseNoise2DNode* sourceModule, uint32_t size) {
+    CancelPreviewJob();
+
+    auto job = std::make_shared<PreviewJob>(sourceModule, size);
+    ThreadPool::Get().Submit([job]() { job->Run(); });
+    m_previewJob = job;
+    m_previewResult = job->GetResult();
+}
 
-    UpdatePreview(m_renderedPreview->Render());
+void PreviewNode::UpdatePreview(const BaseNoise2DNode* sourceModule) {
+    UpdatePreview(sourceModule, m_previewSize);
 }
 
-void PreviewNode::UpdatePreview(BaseNoise3DNode* sourceModule) {
-    if (m_shapePreview == nullptr) {
-        m_shapePreview = new PlaneNode();
-        auto dstPin = BasePin(PinType::Noise3D, 0);
-        m_shapePreview->SetSourceNode(sourceModule, &dstPin);
+void PreviewNode::UpdatePreview(const std::shared_ptr<const noise::utils::NoiseMap>& noiseMap) {
+    if (!noiseMap) {
+        throw EngineError("the noise map of the preview is empty");
     }
+    CancelPreviewJob();
+
+    auto job = std::make_shared<PreviewJob>(noiseMap);
+    ThreadPool::Get().Submit([job]() { job->Run(); });
+    m_previewJob = job;
+    m_previewResult = job->GetResult();
+}
 
-    UpdatePreview(m_shapePreview);
+void PreviewNode::SetPreviewResult(const std::shared_ptr<PreviewResult>& result) {
+    CancelPreviewJob();
+    m_previewResult = result;
+}
+
+void PreviewNode::SetTextureFactory(const TextureFactory& factory) {
+    GetTextureFactory() = factory;
 }
 
 void PreviewNode::DrawPreview() {
+    if (!m_texturePreview) {
+        const auto& factory = GetTextureFactory();
+        if (!factory) {
+            return;
+        }
+        m_texturePreview = factory();
+    }
+
+    if (m_previewResult) {
+        // the last pass is published before the rendering is finished
+        const bool isFinished = m_previewResult->IsFinished();
+        auto result = m_previewResult;
+        if (isFinished) {
+            m_previewResult.reset();
+            m_previewJob.reset();
+        }
+        result->Upload(*m_texturePreview);
+    }
+
     ImGui::SameLine();
-    gui::Image(m_texturePreview.GetTexture(), math::Size(m_previewSize, m_previewSize), math::Pointf(0,1), math::Pointf(1,0));
+    gui::Image(m_texturePreview->GetTexture(), math::Size(m_previewSize, m_previewSize), math::Pointf(0,1), math::Pointf(1,0));
+}
+
+void PreviewNode::CancelBackgroundWork() {
+    if (m_previewJob) {
+        m_previewJob->Cancel();
+    }
+}
+
+void PreviewNode::WaitBackgroundWork() {
+    for (const auto& job: m_cancelledJobs) {
+        job->Wait();
+    }
+    m_cancelledJobs.clear();
+
+    if (!m_previewJob) {
+        return;
+    }
+
+    m_previewJob->Wait();
+    // the preview was not rendered, it will be started again at the next update
+    m_previewJob.reset();
+    m_previewResult.reset();
+    SetNeedUpdate();
+}
+
+void PreviewNode::CancelPreviewJob() {
+    // the finished jobs are forgotten, the running ones are waited for by WaitBackgroundWork
+    m_cancelledJobs.erase(std::remove_if(m_cancelledJobs.begin(), m_cancelledJobs.end(), [](const auto& job) {
+        return job->IsFinished();
+    }), m_cancelledJobs.end());
+
+    if (m_previewJob) {
+        m_previewJob->Cancel();
+        m_cancelledJobs.push_back(std::move(m_previewJob));
+    }
 }
 
 std::shared_ptr<Texture> PreviewNode::GetView() {
-    return m_texturePreview.GetTexture();
+    return m_texturePreview ? m_texturePreview->GetTexture() : nullptr;
 }
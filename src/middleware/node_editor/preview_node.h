@@ -1,35 +1,113 @@
 #pragma once
 
+#include <mutex>
+#include <atomic>
 #include <memory>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
 
-#include "engine/material/texture_manager.h"
+#include "engine/material/image.h"
 #include "middleware/node_editor/base_editor_node.h"
 
 
 namespace noise {
     namespace utils {
-        class RendererImage;
+        class NoiseMap;
     }
 }
+class Texture;
+// The texture of the preview, implemented by the UI (see NodeEditor),
+// so the nodes can be evaluated without the graphics API
+class PreviewTexture {
+public:
+    virtual ~PreviewTexture() = default;
+
+    virtual void Update(const ImageView& view) = 0;
+    virtual std::shared_ptr<Texture> GetTexture() = 0;
+};
+
+// The image of the preview rendered in the background:
+// the renderer publishes every pass, the main thread uploads the last published pass to the texture
+class PreviewResult : Noncopyable {
+public:
+    PreviewResult() = default;
+    ~PreviewResult() = default;
+
+    // Called by the renderer
+    void Publish(const ImageView& view);
+    void SetError(std::exception_ptr error);
+    void Finish();
+
+    bool IsFinished() const noexcept { return m_finished.load(); }
+    void Wait();
+
+    // Called on the main thread, uploads the last published pass if it is not uploaded yet
+    // Rethrows the exception of the rendering
+    void Upload(PreviewTexture& texture);
+
+private:
+    std::atomic<bool> m_finished = false;
+    // guards m_error, m_published and m_publishedVersion
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    std::exception_ptr m_error = nullptr;
+    Image m_published;
+    uint32_t m_publishedVersion = 0;
+    // main thread only
+    uint32_t m_uploadedVersion = 0;
+};
+
+class PreviewJob;
 class BaseNoise2DNode;
-class BaseNoise3DNode;
 class PreviewNode : public BaseNode {
+public:
+    using TextureFactory = std::function<std::shared_ptr<PreviewTexture> ()>;
+
+    // Bounds of the noise maps of the previews
+    static constexpr const double LowerUBound = 2.0;
+    static constexpr const double UpperUBound = 6.0;
+    static constexpr const double LowerVBound = 1.0;
+    static constexpr const double UpperVBound = 5.0;
+
 protected:
     PreviewNode(const std::string& name);
     ~PreviewNode() override;
 
-    void UpdatePreview(const ImageView& view);
+    // Starts rendering of the preview in the background, the previous rendering is cancelled,
+    // the texture is updated by DrawPreview after the rendering is finished
+    void UpdatePreview(const BaseNoise2DNode* sourceModule, uint32_t size);
     void UpdatePreview(const BaseNoise2DNode* sourceModule);
-    void UpdatePreview(BaseNoise3DNode* sourceModule);
 
     void DrawPreview() final;
 
 public:
+    void CancelBackgroundWork() final;
+    void WaitBackgroundWork() final;
+
+    // Starts rendering of the preview from the noise map built by somebody else (see NodeScheduler),
+    // the previous rendering is cancelled
+    void UpdatePreview(const std::shared_ptr<const noise::utils::NoiseMap>& noiseMap);
+    // The preview rendered by somebody else (see NodeScheduler), the previous rendering is cancelled
+    void SetPreviewResult(const std::shared_ptr<PreviewResult>& result);
+
+    // The previews are not drawn until the factory is set
+    static void SetTextureFactory(const TextureFactory& factory);
+
+    uint32_t GetPreviewSize() const noexcept { return m_previewSize; }
+    // Returns nullptr if the preview was not drawn
     std::shared_ptr<Texture> GetView();
 
+private:
+    void CancelPreviewJob();
+
 private:
     uint32_t m_previewSize = 128;
-    DynamicTexture m_texturePreview;
-    noise::utils::RendererImage* m_renderedPreview = nullptr;
-    BaseNoise2DNode* m_shapePreview = nullptr;
+    std::shared_ptr<PreviewTexture> m_texturePreview;
+    std::shared_ptr<PreviewJob> m_previewJob;
+    // the cancelled jobs that can still be running
+    std::vector<std::shared_ptr<PreviewJob>> m_cancelledJobs;
+    std::shared_ptr<PreviewResult> m_previewResult;
 };
@@ -0,0 +1,761 @@
+#include <cmath>
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <charconv>
+#include <functional>
+#include <algorithm>
+#include <stb_image_write.h>
+#include <spdlog/spdlog.h>
+
+#include "engine/common/exception.h"
+#include "middleware/node_editor/noise_2d.h"
+#include "middleware/node_editor/noise_3d.h"
+#include "middleware/node_editor/noise_program.h"
+#include "middleware/node_editor/noiseutils.h"
+#include "middleware/node_editor/node_render.h"
+#include "middleware/node_editor/graph_file.h"
+#include "middleware/node_editor/heightmap_export.h"
+
+
+// Headless baking of the saved node graphs: the graph is evaluated without a window and the ImGui context,
+// the noise maps are built and rendered on all cores of the thread pool.
+struct Options {
+    std::string graphPath;
+    std::string outputPrefix;
+    // -1 - all render nodes or all 2D nodes if there are no render nodes
+    int64_t node = -1;
+    uint32_t width = 1024;
+    uint32_t height = 1024;
+    double lowerUBound = PreviewNode::LowerUBound;
+    double upperUBound = PreviewNode::UpperUBound;
+    double lowerVBound = PreviewNode::LowerVBound;
+    double upperVBound = PreviewNode::UpperVBound;
+    bool writeHeight = true;
+    bool writeColor = true;
+    bool writeNormal = true;
+    // the height is exported tile by tile to the raw file, the color and the normal outputs are not written
+    bool isRaw = false;
+    HeightmapFileHeader::Format rawFormat = HeightmapFileHeader::Format::R16;
+    uint32_t tileSize = HeightmapExport::DefaultTileSize;
+    // print the optimized program of the noise node of every output
+    bool dumpProgram = false;
+    // cull the octaves above the Nyquist limit of the output, see NoiseMap::EnableBandLimit
+    bool isBandLimited = false;
+    // precision of the fractal generators, see NoiseMap::SetPrecision
+    NoisePrecision precision = NoisePrecision::Double;
+    // compare the single precision values of every noise node with the double precision values
+    bool checkPrecision = false;
+    // light and normal maps from the analytic gradients, see NoiseMap::EnableGradients
+    bool isGradients = false;
+    // 0 - all threads of the thread pool
+    uint32_t threadCount = 0;
+};
+
+static void PrintUsage() {
+    std::fprintf(stderr,
+        "Usage: noise_bake <graph file> <output prefix> [options]\n"
+        "       noise_bake --self-test\n"
+        "Options:\n"
+        "  --node <index>              index of the shape or render node, by default all render nodes\n"
+        "                              (all shape nodes if the graph has no render nodes)\n"
+        "  --size <width> <height>     size of the outputs, 1024 1024 by default\n"
+        "  --bounds <lu> <uu> <lv> <uv> bounds of the noise map, the bounds of the previews by default\n"
+        "  --outputs <list>            comma separated list of height, color, normal, all by default\n"
+        "  --threads <count>           number of the worker threads, all cores by default\n"
+        "  --raw <r16|r32f>            export only the height tile by tile to the raw file, for outputs of any size\n"
+        "  --tile <size>               size of the tiles of the raw export, 256 by default\n"
+        "  --dump-program              print the optimized program of the noise node of every output\n"
+        "  --band-limit                skip the octaves too fine for the size of the outputs, faster but not exact\n"
+        "  --precision <single|double> precision of the fractal generators, double by default\n"
+        "  --check-precision           check that the single precision values of every noise node on the output grid\n"
+        "                              are within the error bound of the node\n"
+        "  --gradients                 light and normal maps from the analytic gradients of the noise\n"
+        "Outputs: <prefix>_<node>_height.pgm (16 bit), <prefix>_<node>_color.png, <prefix>_<node>_normal.png,\n"
+        "         <prefix>_<node>_height.r16 or <prefix>_<node>_height.r32f in the raw mode\n"
+        "--self-test checks the documented error bounds of the noise nodes, the optimized programs and the gradients\n"
+        "            on random points\n");
+}
+
+static Options ParseOptions(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (args.size() < 2) {
+        throw EngineError("the graph file and the output prefix are expected");
+    }
+
+    Options options;
+    options.graphPath = args[0];
+    options.outputPrefix = args[1];
+
+    size_t i = 2;
+    auto next = [&args, &i](const std::string& name) -> const std::string& {
+        if (i >= args.size()) {
+            throw EngineError("the value of the option '{}' is expected", name);
+        }
+        return args[i++];
+    };
+    // only the digits, std::stoul accepts the sign and wraps the negative values
+    auto toUInt = [](const std::string& value) -> uint32_t {
+        uint32_t result = 0;
+        const char* end = value.data() + value.size();
+        const auto [ptr, error] = std::from_chars(value.data(), end, result);
+        if ((error != std::errc()) || (ptr != end) || (result == 0)) {
+            throw EngineError("wrong value '{}' of the option", value);
+        }
+        return result;
+    };
+    // the whole string, std::stod ignores the trailing characters and accepts nan and inf
+    auto toDouble = [](const std::string& value) -> double {
+        double result = 0;
+        const char* end = value.data() + value.size();
+        const auto [ptr, error] = std::from_chars(value.data(), end, result);
+        if ((error != std::errc()) || (ptr != end) || (!std::isfinite(result))) {
+            throw EngineError("wrong value '{}' of the option", value);
+        }
+        return result;
+    };
+
+    while (i < args.size()) {
+        const auto name = args[i++];
+        if (name == "--node") {
+            const auto& value = next(name);
+            uint32_t node = 0;
+            const char* end = value.data() + value.size();
+            const auto [ptr, error] = std::from_chars(value.data(), end, node);
+            if ((error != std::errc()) || (ptr != end)) {
+                throw EngineError("wrong index '{}' of the node", value);
+            }
+            options.node = node;
+        } else if (name == "--size") {
+            options.width = toUInt(next(name));
+            options.height = toUInt(next(name));
+        } else if (name == "--bounds") {
+            options.lowerUBound = toDouble(next(name));
+            options.upperUBound = toDouble(next(name));
+            options.lowerVBound = toDouble(next(name));
+            options.upperVBound = toDouble(next(name));
+        } else if (name == "--outputs") {
+            const auto& list = next(name);
+            options.writeHeight = false;
+            options.writeColor = false;
+            options.writeNormal = false;
+            for (size_t begin=0; begin<=list.size();) {
+                const size_t end = std::min(list.find(',', begin), list.size());
+                const auto output = list.substr(begin, end - begin);
+                if (output == "height") {
+                    options.writeHeight = true;
+                } else if (output == "color") {
+                    options.writeColor = true;
+                } else if (output == "normal") {
+                    options.writeNormal = true;
+                } else {
+                    throw EngineError("unknown output '{}'", output);
+                }
+                begin = end + 1;
+            }
+        } else if (name == "--raw") {
+            const auto& format = next(name);
+            if (format == "r16") {
+                options.rawFormat = HeightmapFileHeader::Format::R16;
+            } else if (format == "r32f") {
+                options.rawFormat = HeightmapFileHeader::Format::R32F;
+            } else {
+                throw EngineError("unknown raw format '{}'", format);
+            }
+            options.isRaw = true;
+        } else if (name == "--tile") {
+            options.tileSize = toUInt(next(name));
+        } else if (name == "--dump-program") {
+            options.dumpProgram = true;
+        } else if (name == "--band-limit") {
+            options.isBandLimited = true;
+        } else if (name == "--precision") {
+            const auto& precision = next(name);
+            if (precision == "single") {
+                options.precision = NoisePrecision::Single;
+            } else if (precision == "double") {
+                options.precision = NoisePrecision::Double;
+            } else {
+                throw EngineError("unknown precision '{}'", precision);
+            }
+        } else if (name == "--check-precision") {
+            options.checkPrecision = true;
+        } else if (name == "--gradients") {
+            options.isGradients = true;
+        } else if (name == "--threads") {
+            options.threadCount = toUInt(next(name));
+        } else {
+            throw EngineError("unknown option '{}'", name);
+        }
+    }
+
+    return options;
+}
+
+static void WriteHeight(const std::string& path, const noise::utils::NoiseMap& noiseMap) {
+    const auto width = static_cast<int32_t>(noiseMap.GetWidth());
+    const auto height = static_cast<int32_t>(noiseMap.GetHeight());
+
+    // binary PGM with the big-endian 16 bit samples, the rows are from the top to the bottom
+    std::vector<uint8_t> data(static_cast<size_t>(width) * static_cast<size_t>(height) * 2);
+    uint8_t* out = data.data();
+    for (int32_t y=height - 1; y>=0; --y) {
+        const float* row = noiseMap.GetRow(y);
+        for (int32_t x=0; x!=width; ++x) {
+            // std::clamp passes NaN through and its cast to uint16_t is undefined
+            const float value = std::isnan(row[x]) ? 0.0f : std::clamp((row[x] + 1.0f) * 0.5f, 0.0f, 1.0f);
+            const auto sample = static_cast<uint16_t>(value * 65535.0f + 0.5f);
+            *out++ = static_cast<uint8_t>(sample >> 8);
+            *out++ = static_cast<uint8_t>(sample & 0xFF);
+        }
+    }
+
+    std::ofstream ofs(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    ofs << "P5\n" << width << " " << height << "\n65535\n";
+    ofs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!ofs) {
+        throw EngineError("couldn't write file '{}'", path);
+    }
+}
+
+static void WritePng(const std::string& path, const ImageView& view) {
+    if (view.header.format != PixelFormat::R8G8B8A8) {
+        throw EngineError("unsupported pixel format {} of the image '{}'", ToStr(view.header.format), path);
+    }
+
+    // the rows of the rendered image are from the bottom to the top
+    const auto stride = static_cast<int>(view.header.width * 4);
+    const auto* lastRow = static_cast<const uint8_t*>(view.data) + static_cast<size_t>(view.header.height - 1) * static_cast<size_t>(stride);
+    stbi_flip_vertically_on_write(0);
+    if (stbi_write_png(path.c_str(), static_cast<int>(view.header.width), static_cast<int>(view.header.height), 4, lastRow, -stride) == 0) {
+        throw EngineError("couldn't write file '{}'", path);
+    }
+}
+
+static void Bake(const Options& options, const BaseNoise2DNode* node, size_t index) {
+    if (node->GetHash() == 0) {
+        throw EngineError("the node {} has not connected inputs", index);
+    }
+
+    const auto prefix = fmt::format("{}_{}", options.outputPrefix, index);
+    if (options.isRaw) {
+        HeightmapExport heightmap;
+        heightmap.SetSourceModule(node);
+        heightmap.SetSize(options.width, options.height);
+        heightmap.SetBounds(options.lowerUBound, options.upperUBound, options.lowerVBound, options.upperVBound);
+        heightmap.SetFormat(options.rawFormat);
+        heightmap.SetTileSize(options.tileSize);
+        heightmap.SetWorkerCount(options.threadCount);
+        heightmap.SetPrecision(options.precision);
+        const bool isR16 = (options.rawFormat == HeightmapFileHeader::Format::R16);
+        heightmap.Export(prefix + (isR16 ? "_height.r16" : "_height.r32f"));
+        spdlog::info("node {} is exported to '{}_*'", index, prefix);
+        return;
+    }
+
+    noise::utils::NoiseMap noiseMap;
+    noiseMap.SetSourceModule(node);
+    noiseMap.SetSize(options.width, options.height);
+    noiseMap.SetBounds(options.lowerUBound, options.upperUBound, options.lowerVBound, options.upperVBound);
+    noiseMap.SetWorkerCount(options.threadCount);
+    noiseMap.EnableBandLimit(options.isBandLimited);
+    noiseMap.SetPrecision(options.precision);
+    if (options.isGradients) {
+        if (node->HasGradients()) {
+            noiseMap.EnableGradients();
+        } else {
+            spdlog::warn("node {} ('{}') has nodes without the analytic gradients, the finite differences are used", index, node->GetName());
+        }
+    }
+    noiseMap.Build();
+
+    if (options.writeHeight) {
+        WriteHeight(prefix + "_height.pgm", noiseMap);
+    }
+
+    if (options.writeColor) {
+        noise::utils::RendererImage renderer;
+        renderer.SetSourceNoiseMap(noiseMap);
+        renderer.SetWorkerCount(options.threadCount);
+        renderer.BuildTerrainGradient();
+        renderer.EnableLight();
+        WritePng(prefix + "_color.png", renderer.Render());
+    }
+
+    if (options.writeNormal) {
+        noise::utils::RendererNormalMap renderer;
+        renderer.SetSourceNoiseMap(noiseMap);
+        renderer.SetWorkerCount(options.threadCount);
+        WritePng(prefix + "_normal.png", renderer.Render());
+    }
+
+    spdlog::info("node {} is baked to '{}_*'", index, prefix);
+}
+
+// Evaluates the node on the grid of the outputs (the plane mapping) in both precisions,
+// the deviation must not exceed BaseNoise3DNode::GetSinglePrecisionError
+static void CheckPrecision(const Options& options, const BaseNoise3DNode* node, size_t index) {
+    const double bound = node->GetSinglePrecisionError();
+    const size_t count = static_cast<size_t>(options.width) * static_cast<size_t>(options.height);
+    std::vector<double> x(count);
+    std::vector<double> y(count, 0);
+    std::vector<double> z(count);
+    const double uDelta = (options.upperUBound - options.lowerUBound) / static_cast<double>(options.width);
+    const double vDelta = (options.upperVBound - options.lowerVBound) / static_cast<double>(options.height);
+    for (uint32_t row=0; row!=options.height; ++row) {
+        for (uint32_t column=0; column!=options.width; ++column) {
+            const size_t i = static_cast<size_t>(row) * options.width + column;
+            x[i] = options.lowerUBound + uDelta * static_cast<double>(column);
+            z[i] = options.lowerVBound + vDelta * static_cast<double>(row);
+        }
+    }
+
+    std::vector<double> doubleValues(count);
+    std::vector<double> singleValues(count);
+    node->GetValues(NoisePoints{x.data(), y.data(), z.data(), count, 0, NoisePrecision::Double}, doubleValues.data());
+    node->GetValues(NoisePoints{x.data(), y.data(), z.data(), count, 0, NoisePrecision::Single}, singleValues.data());
+
+    double deviation = 0;
+    for (size_t i=0; i!=count; ++i) {
+        deviation = std::max(deviation, std::abs(singleValues[i] - doubleValues[i]));
+    }
+    spdlog::info("node {} ('{}'): single precision deviation {:.3e}, bound {:.3e}", index, node->GetName(), deviation, bound);
+    if (deviation > bound) {
+        throw EngineError("the single precision deviation {} of the node {} exceeds the bound {}", deviation, index, bound);
+    }
+}
+
+// Creates the node with the parameters in the order of T::SaveParams
+template <typename T, typename... Params> static std::shared_ptr<T> MakeNode(const Params&... params) {
+    ParamsWriter writer;
+    (writer.Write(params), ...);
+    ParamsReader reader(writer.GetData().data(), writer.GetData().size());
+    auto node = std::make_shared<T>();
+    node->LoadParams(reader);
+    node->OnGraphChanged();
+
+    return node;
+}
+
+// srcNode -> dstNode (the input pin with the user index)
+static void Link(BaseNode* srcNode, BaseNode* dstNode, uint32_t index) {
+    dstNode->SetSourceNode(srcNode, dstNode->GetInPin(index));
+    srcNode->AddDestNode(dstNode, srcNode->GetOutPin(0));
+}
+
+// Random points with the coordinates up to 10^3 and a few up to 10^6
+static void MakeRandomPoints(size_t count, std::vector<double>& x, std::vector<double>& y, std::vector<double>& z) {
+    std::mt19937_64 generator(42);
+    std::uniform_real_distribution<double> near(-1e3, 1e3);
+    std::uniform_real_distribution<double> far(-1e6, 1e6);
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    for (size_t i=0; i!=count; ++i) {
+        auto& distribution = (i % 16 == 0) ? far : near;
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+        z[i] = distribution(generator);
+    }
+}
+
+// The vectorized kernels of Perlin, Billow and RidgedMulti should be equal to libnoise
+// up to the documented tolerance 1e-12 * octaveCount (see kernel::Perlin), kernel::Voronoi exactly
+static void CheckKernels(const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& z) {
+    const size_t count = x.size();
+    const NoisePoints points{x.data(), y.data(), z.data(), count, 0, NoisePrecision::Double};
+    std::vector<double> values(count);
+    auto check = [&points, &values](const BaseNoise3DNode& node, int octaveCount) {
+        node.GetValues(points, values.data());
+        double deviation = 0;
+        for (size_t i=0; i!=points.count; ++i) {
+            deviation = std::max(deviation, std::abs(values[i] - node.GetModule().GetValue(points.x[i], points.y[i], points.z[i])));
+        }
+        const double bound = 1e-12 * static_cast<double>(octaveCount);
+        if (!(deviation <= bound)) {
+            throw EngineError("the deviation {} of the kernel of the node '{}' from libnoise exceeds the bound {}, octave count = {}",
+                deviation, node.GetName(), bound, octaveCount);
+        }
+    };
+
+    for (const auto quality: {noise::QUALITY_FAST, noise::QUALITY_STD, noise::QUALITY_BEST}) {
+        for (const int seed: {0, 1234567}) {
+            for (const int octaveCount: {1, 6, noise::module::PERLIN_MAX_OCTAVE}) {
+                check(*MakeNode<PerlinNode>(quality, 1.3, 2.1, octaveCount, 0.55, seed), octaveCount);
+            }
+            for (const int octaveCount: {1, 6, noise::module::BILLOW_MAX_OCTAVE}) {
+                check(*MakeNode<BillowNode>(quality, 0.7, 1.9, octaveCount, 0.5, seed), octaveCount);
+            }
+            for (const int octaveCount: {1, 6, noise::module::RIDGED_MAX_OCTAVE}) {
+                check(*MakeNode<RidgedMultiNode>(quality, 1.1, 2.2, octaveCount, seed), octaveCount);
+            }
+        }
+    }
+
+    // the rows of the noise map (y = 0, the chunks are compact, the seed points of the box of the chunk are cached)
+    // and the scattered points (the seed points are calculated per point), kernel::Voronoi should be equal to libnoise
+    const size_t rowCount = 16;
+    const size_t rowSize = 256;
+    std::vector<double> rowX(rowCount * rowSize);
+    std::vector<double> rowY(rowCount * rowSize, 0);
+    std::vector<double> rowZ(rowCount * rowSize);
+    for (size_t row=0; row!=rowCount; ++row) {
+        for (size_t column=0; column!=rowSize; ++column) {
+            rowX[row * rowSize + column] = -10.0 + 20.0 * static_cast<double>(column) / static_cast<double>(rowSize);
+            rowZ[row * rowSize + column] = -5.0 + 0.37 * static_cast<double>(row);
+        }
+    }
+    const NoisePoints rows{rowX.data(), rowY.data(), rowZ.data(), rowX.size(), 0, NoisePrecision::Double};
+    for (const uint8_t enableDistance: {uint8_t(0), uint8_t(1)}) {
+        for (const int seed: {0, 7, -1234567}) {
+            for (const double frequency: {0.5, 1.5, 4.0}) {
+                for (const double displacement: {0.0, 1.0, -2.5}) {
+                    const auto node = MakeNode<VoronoiNode>(displacement, enableDistance, frequency, seed);
+                    for (const auto* voronoiPoints: {&rows, &points}) {
+                        std::vector<double> voronoiValues(voronoiPoints->count);
+                        node->GetValues(*voronoiPoints, voronoiValues.data());
+                        for (size_t i=0; i!=voronoiPoints->count; ++i) {
+                            const double expected = node->GetModule().GetValue(voronoiPoints->x[i], voronoiPoints->y[i], voronoiPoints->z[i]);
+                            if (!std::equal_to<double>()(voronoiValues[i], expected)) {
+                                throw EngineError("the Voronoi kernel value {} differs from the libnoise value {}, seed = {}, frequency = {}, "
+                                    "displacement = {}, distance = {}", voronoiValues[i], expected, seed, frequency, displacement, enableDistance);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    spdlog::info("the kernels are within the tolerance of libnoise");
+}
+
+// Creates the node of the type with the default parameters and a Perlin node on every input pin,
+// returns nullptr if the type is not a noise node. The sources should outlive the node linked to them
+static std::shared_ptr<BaseNoise3DNode> MakeNodeGraph(uint32_t type, std::vector<std::shared_ptr<BaseNode>>& sources) {
+    auto node = std::dynamic_pointer_cast<BaseNoise3DNode>(NodeFactory::Create(type));
+    if (!node) {
+        return nullptr;
+    }
+    for (size_t i=0; i!=node->GetSourceCount(); ++i) {
+        auto source = MakeNode<PerlinNode>(noise::QUALITY_STD, 1.0 + 0.5 * static_cast<double>(i), 2.0, 6, 0.5, static_cast<int>(i));
+        Link(source.get(), node.get(), static_cast<uint32_t>(i));
+        sources.push_back(std::move(source));
+    }
+    node->OnGraphChanged();
+
+    return node;
+}
+
+// Builds one graph per type of the noise nodes (see MakeNodeGraph). The deviation of its values
+// in NoisePrecision::Single from NoisePrecision::Double must not exceed BaseNoise3DNode::GetSinglePrecisionError
+static void CheckSinglePrecision(const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& z) {
+    const size_t count = x.size();
+    std::vector<double> doubleValues(count);
+    std::vector<double> singleValues(count);
+    for (uint32_t type=0; type!=NodeFactory::GetTypeCount(); ++type) {
+        std::vector<std::shared_ptr<BaseNode>> sources;
+        const auto node = MakeNodeGraph(type, sources);
+        if (!node) {
+            continue;
+        }
+
+        const double bound = node->GetSinglePrecisionError();
+        node->GetValues(NoisePoints{x.data(), y.data(), z.data(), count, 0, NoisePrecision::Double}, doubleValues.data());
+        node->GetValues(NoisePoints{x.data(), y.data(), z.data(), count, 0, NoisePrecision::Single}, singleValues.data());
+        double deviation = 0;
+        for (size_t i=0; i!=count; ++i) {
+            deviation = std::max(deviation, std::abs(singleValues[i] - doubleValues[i]));
+        }
+        spdlog::info("node '{}': single precision deviation {:.3e}, bound {:.3e}", node->GetName(), deviation, bound);
+        if (!(deviation <= bound)) {
+            throw EngineError("the single precision deviation {} of the node '{}' exceeds the bound {}", deviation, node->GetName(), bound);
+        }
+    }
+    spdlog::info("the single precision deviations are within the bounds");
+}
+
+// The analytic partial derivatives should be equal to the centred finite differences of the values with the step
+// GradientStep: |analytic - difference| <= GradientTolerance * (1 + |analytic|). The points closer than the step
+// to a point where the values are not differentiable are skipped, the one-sided differences disagree there
+// by more than GradientKinkTolerance * (1 + |analytic|), at most GradientMaxSkipped of the points can be skipped.
+// The points with the values that are not finite (Power of a negative base) are skipped too
+constexpr const double GradientStep = 1e-6;
+constexpr const double GradientTolerance = 1e-5;
+constexpr const double GradientKinkTolerance = 1e-2;
+constexpr const double GradientMaxSkipped = 0.05;
+
+// coords[axis] - the coordinates of the points, gradients[axis] - the analytic partial derivatives by the axis,
+// getValues(coords, out) evaluates the values
+template <size_t N, typename GetValues> static void CheckFiniteDifferences(const std::string& name,
+    const std::array<std::vector<double>, N>& coords, const std::array<std::vector<double>, N>& gradients, const GetValues& getValues) {
+
+    const size_t count = coords[0].size();
+    std::vector<double> values(count);
+    std::vector<double> upper(count);
+    std::vector<double> lower(count);
+    getValues(coords, values.data());
+
+    size_t skipped = 0;
+    for (size_t axis=0; axis!=N; ++axis) {
+        auto upperCoords = coords;
+        auto lowerCoords = coords;
+        for (size_t i=0; i!=count; ++i) {
+            upperCoords[axis][i] += GradientStep;
+            lowerCoords[axis][i] -= GradientStep;
+        }
+        getValues(upperCoords, upper.data());
+        getValues(lowerCoords, lower.data());
+
+        for (size_t i=0; i!=count; ++i) {
+            const double analytic = gradients[axis][i];
+            if (!(std::isfinite(values[i]) && std::isfinite(upper[i]) && std::isfinite(lower[i]))) {
+                continue;
+            }
+            // the steps are not exact in floating point, the differences of the coordinates are
+            const double upperStep = upperCoords[axis][i] - coords[axis][i];
+            const double lowerStep = coords[axis][i] - lowerCoords[axis][i];
+            const double right = (upper[i] - values[i]) / upperStep;
+            const double left = (values[i] - lower[i]) / lowerStep;
+            const double scale = 1.0 + std::abs(analytic);
+            if (std::abs(right - left) > GradientKinkTolerance * scale) {
+                ++skipped;
+                continue;
+            }
+            const double central = (upper[i] - lower[i]) / (upperStep + lowerStep);
+            if (!(std::abs(analytic - central) <= GradientTolerance * scale)) {
+                throw EngineError("the derivative {} of the node '{}' by the axis {} differs from the finite difference {} at the point {}",
+                    analytic, name, axis, central, i);
+            }
+        }
+    }
+
+    if (static_cast<double>(skipped) > GradientMaxSkipped * static_cast<double>(count * N)) {
+        throw EngineError("the derivatives of the node '{}' are not differentiable at {} of {} points", name, skipped, count * N);
+    }
+    spdlog::info("node '{}': the derivatives are equal to the finite differences, {} points are skipped", name, skipped);
+}
+
+// Every type of the noise nodes with the gradients (see MakeNodeGraph) and the chain rule of Plane, Sphere and Cylinder
+static void CheckGradients() {
+    const size_t count = 1024;
+    std::mt19937_64 generator(42);
+    std::uniform_real_distribution<double> distribution(-100.0, 100.0);
+    std::array<std::vector<double>, 3> coords;
+    for (auto& axis: coords) {
+        axis.resize(count);
+        for (auto& value: axis) {
+            value = distribution(generator);
+        }
+    }
+    // the angles of the sphere and the cylinder are in degrees
+    std::uniform_real_distribution<double> angles(-80.0, 80.0);
+    std::array<std::vector<double>, 2> uv;
+    for (auto& axis: uv) {
+        axis.resize(count);
+        for (auto& value: axis) {
+            value = angles(generator);
+        }
+    }
+
+    for (uint32_t type=0; type!=NodeFactory::GetTypeCount(); ++type) {
+        std::vector<std::shared_ptr<BaseNode>> sources;
+        const auto node = MakeNodeGraph(type, sources);
+        if ((!node) || (!node->HasGradients())) {
+            continue;
+        }
+
+        std::vector<double> values(count);
+        std::array<std::vector<double>, 3> gradients = {std::vector<double>(count), std::vector<double>(count), std::vector<double>(count)};
+        const NoisePoints points{coords[0].data(), coords[1].data(), coords[2].data(), count, 0, NoisePrecision::Double};
+        node->GetGradients(points, values.data(), NoiseGradients{gradients[0].data(), gradients[1].data(), gradients[2].data()});
+        CheckFiniteDifferences(node->GetName(), coords, gradients, [&node, count](const std::array<std::vector<double>, 3>& xyz, double* out) {
+            node->GetValues(NoisePoints{xyz[0].data(), xyz[1].data(), xyz[2].data(), count, 0, NoisePrecision::Double}, out);
+        });
+    }
+
+    const auto source = MakeNode<PerlinNode>(noise::QUALITY_STD, 1.5, 2.0, 6, 0.5, 0);
+    const std::vector<std::shared_ptr<BaseNoise2DNode>> shapes = {
+        std::make_shared<PlaneNode>(), std::make_shared<SphereNode>(), std::make_shared<CylinderNode>()};
+    for (const auto& shape: shapes) {
+        Link(source.get(), shape.get(), 0);
+        shape->OnGraphChanged();
+
+        std::vector<double> values(count);
+        std::array<std::vector<double>, 2> gradients = {std::vector<double>(count), std::vector<double>(count)};
+        shape->GetGradients(uv[0].data(), uv[1].data(), values.data(), gradients[0].data(), gradients[1].data(), count, NoiseSampling());
+        CheckFiniteDifferences(shape->GetName(), uv, gradients, [&shape, count](const std::array<std::vector<double>, 2>& points, double* out) {
+            shape->GetValues(points[0].data(), points[1].data(), out, count, NoiseSampling());
+        });
+    }
+    spdlog::info("the derivatives are within the tolerance of the finite differences");
+}
+
+// The graph with every case of NoiseProgram::Optimize: the chains of the affine nodes, the constants folding,
+// the multiplication by 1, the equal subtrees and the saturated Clamp and Select. The leaves are the generators
+// equal to libnoise bitwise, so the optimized values should be equal to the chain of the libnoise modules
+// up to the sign of zero
+static void CheckOptimization(const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& z) {
+    std::vector<std::shared_ptr<BaseNoise3DNode>> nodes;
+    auto add = [&nodes](std::shared_ptr<BaseNoise3DNode> node, std::initializer_list<BaseNoise3DNode*> sources) -> BaseNoise3DNode* {
+        uint32_t index = 0;
+        for (auto* source: sources) {
+            Link(source, node.get(), index++);
+        }
+        nodes.push_back(std::move(node));
+        return nodes.back().get();
+    };
+
+    auto* voronoi = add(MakeNode<VoronoiNode>(1.0, uint8_t(1), 1.5, 7), {});
+    auto* spheres = add(MakeNode<SpheresNode>(2.0), {});
+    // ScaleBias -> ScaleBias and Invert -> Invert
+    auto* scaleBias = add(MakeNode<ScaleBiasNode>(0.25, 0.5), {voronoi});
+    auto* scaleBiasChain = add(MakeNode<ScaleBiasNode>(-0.125, 3.0), {scaleBias});
+    auto* invert = add(MakeNode<InvertNode>(), {spheres});
+    auto* invertChain = add(MakeNode<InvertNode>(), {invert});
+    // Add(Const, Const) and Multiply by the constant 1
+    auto* constSum = add(MakeNode<AddNode>(), {add(MakeNode<ConstNode>(0.25), {}), add(MakeNode<ConstNode>(-0.75), {})});
+    auto* multiplyOne = add(MakeNode<MultiplyNode>(), {invertChain, add(MakeNode<ConstNode>(1.0), {})});
+    // the equal subtrees
+    auto* duplicate = add(MakeNode<ScaleBiasNode>(0.25, 0.5), {voronoi});
+    auto* duplicateSum = add(MakeNode<AddNode>(), {scaleBias, duplicate});
+    // the bounds contain the range of the source, the Spheres values are within [-1, 1]
+    auto* clamp = add(MakeNode<ClampNode>(-3.0, 3.0), {spheres});
+    auto* select = add(MakeNode<SelectNode>(0.5, -3.0, 3.0), {scaleBiasChain, clamp, spheres});
+
+    auto* sum = add(MakeNode<AddNode>(), {scaleBiasChain, constSum});
+    auto* product = add(MakeNode<MultiplyNode>(), {multiplyOne, duplicateSum});
+    auto* root = add(MakeNode<AddNode>(), {add(MakeNode<AddNode>(), {sum, product}), select});
+    for (const auto& node: nodes) {
+        node->OnGraphChanged();
+    }
+
+    const size_t count = x.size();
+    const NoisePoints points{x.data(), y.data(), z.data(), count, 0, NoisePrecision::Double};
+    std::vector<double> values(count);
+    for (const auto* node: {scaleBiasChain, invertChain, constSum, multiplyOne, duplicateSum, clamp, select, root}) {
+        node->GetValues(points, values.data());
+        for (size_t i=0; i!=count; ++i) {
+            // -0.0 is equal to 0.0
+            const double expected = node->GetModule().GetValue(x[i], y[i], z[i]);
+            if (!std::equal_to<double>()(values[i], expected)) {
+                throw EngineError("the optimized value {} of the node '{}' differs from the libnoise value {} at ({}, {}, {})",
+                    values[i], node->GetName(), expected, x[i], y[i], z[i]);
+            }
+        }
+    }
+
+    const auto& program = *root->GetProgram();
+    const size_t optimizedSize = program.GetOptimized()->GetInstructions().size();
+    if (optimizedSize >= program.GetInstructions().size()) {
+        throw EngineError("the program of {} instructions is not reduced by the optimization", program.GetInstructions().size());
+    }
+    spdlog::info("the optimized program of {} instructions ({} before the optimization) is equal to libnoise",
+        optimizedSize, program.GetInstructions().size());
+}
+
+// Checks the documented error bounds, throws EngineError if some bound is exceeded
+static void SelfTest() {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> z;
+    MakeRandomPoints(4096, x, y, z);
+
+    CheckKernels(x, y, z);
+    CheckSinglePrecision(x, y, z);
+    CheckOptimization(x, y, z);
+    CheckGradients();
+}
+
+static bool run(int argc, char* argv[]) {
+    try {
+        if ((argc == 2) && (std::string(argv[1]) == "--self-test")) {
+            SelfTest();
+            spdlog::info("self-test passed");
+            return true;
+        }
+
+        const auto options = ParseOptions(argc, argv);
+
+        auto graph = GraphFile::Read(options.graphPath);
+        for (const auto& [srcPin, dstPin] : graph.links) {
+            dstPin->GetNode()->SetSourceNode(srcPin->GetNode(), dstPin);
+            srcPin->GetNode()->AddDestNode(dstPin->GetNode(), srcPin);
+        }
+        for (const auto& node: graph.nodes) {
+            node->OnGraphChanged();
+        }
+
+        if (options.checkPrecision) {
+            for (size_t i=0; i!=graph.nodes.size(); ++i) {
+                const auto* noiseNode = dynamic_cast<const BaseNoise3DNode*>(graph.nodes[i].get());
+                if ((noiseNode != nullptr) && noiseNode->GetProgram()) {
+                    CheckPrecision(options, noiseNode, i);
+                }
+            }
+        }
+
+        // the shape node of every output
+        std::vector<std::pair<size_t, const BaseNoise2DNode*>> outputs;
+        auto findSource = [&graph](const BaseNode* node) -> const BaseNode* {
+            for (const auto& [srcPin, dstPin] : graph.links) {
+                if (dstPin->GetNode() == node) {
+                    return srcPin->GetNode();
+                }
+            }
+            return nullptr;
+        };
+        for (size_t i=0; i!=graph.nodes.size(); ++i) {
+            if ((options.node >= 0) && (static_cast<size_t>(options.node) != i)) {
+                continue;
+            }
+
+            const auto* node = graph.nodes[i].get();
+            if (const auto* shapeNode = dynamic_cast<const BaseNoise2DNode*>(node); shapeNode != nullptr) {
+                outputs.emplace_back(i, shapeNode);
+            } else if (dynamic_cast<const RenderNode*>(node) != nullptr) {
+                const auto* shapeNode = dynamic_cast<const BaseNoise2DNode*>(findSource(node));
+                if (shapeNode == nullptr) {
+                    throw EngineError("the render node {} has no source", i);
+                }
+                outputs.emplace_back(i, shapeNode);
+            } else if (options.node >= 0) {
+                throw EngineError("the node {} is neither a shape nor a render node", i);
+            }
+        }
+        if (options.node >= 0 && outputs.empty()) {
+            throw EngineError("the node {} is not found, the graph has {} nodes", options.node, graph.nodes.size());
+        }
+
+        // by default only the render nodes are baked if they exist
+        const bool hasRenderNodes = std::any_of(outputs.cbegin(), outputs.cend(), [&graph](const auto& it) {
+            return dynamic_cast<const RenderNode*>(graph.nodes[it.first].get()) != nullptr;
+        });
+        for (const auto& [index, shapeNode] : outputs) {
+            const bool isRenderNode = (dynamic_cast<const RenderNode*>(graph.nodes[index].get()) != nullptr);
+            if ((options.node < 0) && hasRenderNodes && (!isRenderNode)) {
+                continue;
+            }
+            if (options.dumpProgram) {
+                const auto* noiseNode = dynamic_cast<const BaseNoise3DNode*>(findSource(shapeNode));
+                if ((noiseNode != nullptr) && noiseNode->GetProgram()) {
+                    spdlog::info("optimized program of the node {}:\n{}", index, noiseNode->GetProgram()->GetOptimized()->ToString());
+                }
+            }
+            Bake(options, shapeNode, index);
+        }
+    } catch(const std::exception& e) {
+        spdlog::error("{}", e.what());
+        PrintUsage();
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    return run(argc, argv) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,3 @@
+// The implementation of stb_image_write is compiled with the relaxed warnings, see STB_ERROR_SOURCE_FILES
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>